@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// ==========================================
+// ACTUATOR EVENTS
+// ==========================================
+// One event per relay transition, stamped with the microsecond it happened
+// and why. Sent live on greenhouse/<id>/events as JSON; while offline they go
+// into the offline log next to telemetry as a small binary frame payload:
+//
+//   'A' 'E' <act u8> <on u8> <reason u8> <ts_src u8> <boot_id u32> <seq u32>
+//   <t_us u64> <held_ms u32> <timestamp u32> <ts_err i32>        (all LE)
+//
+// (boot_id, seq) identifies an event; t_us is time since boot, so on-time is
+// exact even for pulses far shorter than the telemetry period.
+
+#define EVENT_MAGIC_0 'A'
+#define EVENT_MAGIC_1 'E'
+#define EVENT_RECORD_SIZE 34
+#define EVENT_JSON_MAX 224
+
+enum ActuatorReason : uint8_t
+{
+    AR_THRESHOLD, // Automatic control crossed a setpoint
+    AR_MANUAL,    // Dashboard / manual mode
+    AR_SAFETY,    // Forced off: empty tank, pulse limit, reconfiguration
+    AR_RULE,      // User rule override
+    AR_COUNT
+};
+
+const char *const ACTUATOR_REASON_NAMES[AR_COUNT] = {"threshold", "manual", "safety", "rule"};
+
+struct ActuatorEvent
+{
+    uint8_t act;
+    bool on;
+    uint8_t reason;
+    uint8_t tsSrc; // As telemetry ts_src: 0 none, 1 estimated, 2 NTP, 3 rebased
+    uint32_t bootId;
+    uint32_t seq;
+    uint64_t tUs;    // Time since boot
+    uint32_t heldMs; // How long the previous state lasted
+    uint32_t timestamp;
+    int32_t tsErr;
+};
+
+inline bool isEventRecord(const uint8_t *rec, size_t len)
+{
+    return len == EVENT_RECORD_SIZE && rec[0] == EVENT_MAGIC_0 && rec[1] == EVENT_MAGIC_1;
+}
+
+inline size_t encodeEvent(const ActuatorEvent &e, uint8_t *out)
+{
+    out[0] = EVENT_MAGIC_0;
+    out[1] = EVENT_MAGIC_1;
+    out[2] = e.act;
+    out[3] = e.on;
+    out[4] = e.reason;
+    out[5] = e.tsSrc;
+    memcpy(out + 6, &e.bootId, 4);
+    memcpy(out + 10, &e.seq, 4);
+    memcpy(out + 14, &e.tUs, 8);
+    memcpy(out + 22, &e.heldMs, 4);
+    memcpy(out + 26, &e.timestamp, 4);
+    memcpy(out + 30, &e.tsErr, 4);
+    return EVENT_RECORD_SIZE;
+}
+
+inline void decodeEvent(const uint8_t *rec, ActuatorEvent &e)
+{
+    e.act = rec[2];
+    e.on = rec[3];
+    e.reason = rec[4];
+    e.tsSrc = rec[5];
+    memcpy(&e.bootId, rec + 6, 4);
+    memcpy(&e.seq, rec + 10, 4);
+    memcpy(&e.tUs, rec + 14, 8);
+    memcpy(&e.heldMs, rec + 22, 4);
+    memcpy(&e.timestamp, rec + 26, 4);
+    memcpy(&e.tsErr, rec + 30, 4);
+}
+
+// `names` maps act to its name. Returns the length, 0 if it did not fit.
+inline size_t writeEventJson(const ActuatorEvent &e, const char *const *names, char *out, size_t size)
+{
+    int n = snprintf(out, size,
+                     "{\"boot_id\": %lu, \"seq\": %lu, \"act\": \"%s\", \"on\": %d, \"reason\": \"%s\", "
+                     "\"t_us\": %llu, \"held_ms\": %lu, \"timestamp\": %lu, \"ts_src\": %d, \"ts_err\": %ld}",
+                     (unsigned long)e.bootId, (unsigned long)e.seq, names[e.act], e.on,
+                     e.reason < AR_COUNT ? ACTUATOR_REASON_NAMES[e.reason] : "unknown", (unsigned long long)e.tUs,
+                     (unsigned long)e.heldMs, (unsigned long)e.timestamp, e.tsSrc, (long)e.tsErr);
+    return n > 0 && (size_t)n < size ? n : 0;
+}
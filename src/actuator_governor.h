@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+// ==========================================
+// ACTUATOR GOVERNOR
+// ==========================================
+// Sits between the control decisions and the relay driver and protects the
+// relays and loads from short cycling:
+//
+//   band       hysteresis: once on, stay on until the reading is `band` back
+//              inside the setpoint (applied by the control logic)
+//   minOnMs    a relay that switched on stays on at least this long
+//   minOffMs   ... and off at least this long (also after boot, so a reboot
+//              loop cannot cycle the relays)
+//   maxCycles  switch-ons allowed in any rolling hour (0 = no limit)
+//
+// Only automatic decisions (thresholds, rules) are governed. Manual commands
+// and safety shut-offs act at once, but still count towards the timers.
+
+#define GOVERNOR_MAX_CYCLES 60 // Upper bound for maxCycles (size of the start history)
+
+struct GovernorLimits
+{
+    float band;
+    uint32_t minOnMs;
+    uint32_t minOffMs;
+    uint16_t maxCycles; // Per hour
+};
+
+class ActuatorGovernor
+{
+public:
+    // True if switching to `on` at `nowMs` respects the limits
+    bool mayChange(bool on, uint32_t nowMs, const GovernorLimits &lim) const
+    {
+        uint32_t held = nowMs - changedAt;
+        if (on)
+            return held >= lim.minOffMs && (lim.maxCycles == 0 || startsInLastHour(nowMs) < lim.maxCycles);
+        return held >= lim.minOnMs;
+    }
+
+    // Every transition, governed or not
+    void noteChange(bool on, uint32_t nowMs)
+    {
+        changedAt = nowMs;
+        if (on)
+        {
+            starts[next] = nowMs;
+            next = (next + 1) % GOVERNOR_MAX_CYCLES;
+            if (used < GOVERNOR_MAX_CYCLES)
+                used++;
+        }
+    }
+
+    uint16_t startsInLastHour(uint32_t nowMs) const
+    {
+        uint16_t n = 0;
+        for (uint16_t i = 0; i < used; i++)
+        {
+            if (nowMs - starts[i] < 3600000UL)
+                n++;
+        }
+        return n;
+    }
+
+private:
+    uint32_t changedAt = 0; // Boot counts as a switch-off
+    uint32_t starts[GOVERNOR_MAX_CYCLES];
+    uint16_t next = 0;
+    uint16_t used = 0;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// ==========================================
+// ADAPTIVE SAMPLING RATE
+// ==========================================
+// Chooses the next sampling period for one sensor channel from how fast the
+// signal is moving. Each sample updates an exponentially weighted mean and
+// variance; the rate of change is measured between consecutive samples.
+//
+//   rate > limit  or  stddev > limit   -> halve the period (down to minMs)
+//   both below half their limit        -> stretch by 25%  (up to maxMs)
+//
+// Fast attack, slow release: a door opening is caught within one or two
+// samples, while a quiet night drifts out to the maximum period.
+
+#define ADAPTIVE_ALPHA 0.2f // EWMA weight of the newest sample
+
+struct ChannelLimits
+{
+    uint32_t minMs; // Fastest period
+    uint32_t maxMs; // Slowest period
+    float rate;     // Change per second that counts as "moving"
+    float stdDev;   // Noise level that counts as "moving"
+};
+
+class AdaptiveRate
+{
+public:
+    uint32_t periodMs = 0; // Current period (0 = not started)
+
+    void reset(const ChannelLimits &lim)
+    {
+        periodMs = lim.minMs;
+        primed = false;
+    }
+
+    // Feeds a new sample taken at `nowMs`; returns the period until the next one
+    uint32_t update(float value, uint32_t nowMs, const ChannelLimits &lim)
+    {
+        if (periodMs == 0)
+            reset(lim);
+        if (value != value)
+            return periodMs; // Ignore NaN (failed read)
+        if (!primed)
+        {
+            mean = last = value;
+            var = 0;
+            lastAt = nowMs;
+            primed = true;
+            return periodMs;
+        }
+
+        float dt = (nowMs - lastAt) / 1000.0f;
+        float rate = dt > 0 ? fabsf(value - last) / dt : 0;
+        float diff = value - mean;
+        mean += ADAPTIVE_ALPHA * diff;
+        var = (1 - ADAPTIVE_ALPHA) * (var + ADAPTIVE_ALPHA * diff * diff);
+        float sd = sqrtf(var);
+        last = value;
+        lastAt = nowMs;
+
+        if (rate > lim.rate || sd > lim.stdDev)
+            periodMs /= 2;
+        else if (rate < lim.rate / 2 && sd < lim.stdDev / 2)
+            periodMs += periodMs / 4;
+
+        if (periodMs < lim.minMs)
+            periodMs = lim.minMs;
+        if (periodMs > lim.maxMs)
+            periodMs = lim.maxMs;
+        return periodMs;
+    }
+
+private:
+    bool primed = false;
+    float last = 0;
+    float mean = 0;
+    float var = 0;
+    uint32_t lastAt = 0;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// ==========================================
+// CLIMATE ARBITER
+// ==========================================
+// Decides the heater and fan together. With independent thresholds a cold,
+// humid night runs both at once and the fan exhausts the heat being paid for.
+// The arbiter never asks for both and picks the cheapest strategy that
+// reaches the targets:
+//
+//   idle       nothing to do
+//   vent       fan only: too hot, or humid while warm enough to lose some heat
+//   heat       heater only: too cold, air dry enough
+//   heat_dry   heater only: cold and humid, but warming to the setpoint alone
+//              brings RH under the target (same dew point, warmer air)
+//   heat_vent  cold and humid: heat HEAT_VENT_RISE_C above the minimum, then
+//              vent with the heater off until back at the minimum, repeat
+//
+// RH at another temperature is worked out from the dew point (Magnus-Tetens),
+// which stays put while the air is only heated.
+
+#define HEAT_VENT_RISE_C 2.0f // Heat this far above tempMin before each vent burst
+
+enum ClimateStrategy : uint8_t
+{
+    CS_IDLE,
+    CS_VENT,
+    CS_HEAT,
+    CS_HEAT_DRY,
+    CS_HEAT_VENT,
+    CS_MANUAL, // Not chosen by the arbiter; energy used in manual mode
+    CS_COUNT
+};
+
+const char *const CLIMATE_STRATEGY_NAMES[CS_COUNT] = {"idle", "vent", "heat", "heat_dry", "heat_vent", "manual"};
+
+inline float saturationVaporPressureKPa(float tempC)
+{
+    return 0.6108f * expf(17.27f * tempC / (tempC + 237.3f));
+}
+
+// Vapour-pressure deficit: how much more water the air could hold
+inline float vpdKPa(float tempC, float rh)
+{
+    return saturationVaporPressureKPa(tempC) * (1.0f - rh / 100.0f);
+}
+
+inline float dewPointC(float tempC, float rh)
+{
+    float g = logf(fmaxf(rh, 0.1f) / 100.0f) + 17.27f * tempC / (tempC + 237.3f);
+    return 237.3f * g / (17.27f - g);
+}
+
+// RH the same air would have at `tempC`
+inline float rhAtC(float dewC, float tempC)
+{
+    return 100.0f * saturationVaporPressureKPa(dewC) / saturationVaporPressureKPa(tempC);
+}
+
+struct ClimateInputs
+{
+    float temp, hum;
+    float tempMin, tempMax, humMax;
+    float fanBand, heaterBand; // Hysteresis from the actuator governor
+    bool fanOn, heaterOn;
+};
+
+struct ClimateDecision
+{
+    uint8_t strategy;
+    bool fan;
+    bool heater;
+};
+
+class ClimateArbiter
+{
+public:
+    ClimateDecision decide(const ClimateInputs &in)
+    {
+        // A running output holds until its reading is back inside the band
+        bool cold = in.temp < in.tempMin + (in.heaterOn ? in.heaterBand : 0);
+        bool hot = in.temp > in.tempMax - (in.fanOn ? in.fanBand : 0);
+        bool drying = last == CS_VENT || last == CS_HEAT_DRY || last == CS_HEAT_VENT;
+        bool humid = in.hum > in.humMax - (drying ? in.fanBand : 0);
+
+        ClimateDecision d = {CS_IDLE, false, false};
+        if (hot)
+        {
+            d = {CS_VENT, true, false};
+        }
+        else if (humid && (cold || last == CS_HEAT_VENT))
+        {
+            float heatTo = in.tempMin + in.heaterBand;
+            if (last != CS_HEAT_VENT && rhAtC(dewPointC(in.temp, in.hum), heatTo) < in.humMax)
+            {
+                d = {CS_HEAT_DRY, false, true};
+            }
+            else
+            {
+                if (last != CS_HEAT_VENT)
+                    venting = false;
+                if (venting && in.temp <= in.tempMin)
+                    venting = false;
+                else if (!venting && in.temp >= in.tempMin + HEAT_VENT_RISE_C)
+                    venting = true;
+                d = {CS_HEAT_VENT, venting, !venting};
+            }
+        }
+        else if (cold)
+        {
+            d = {CS_HEAT, false, true};
+        }
+        else if (humid)
+        {
+            d = {CS_VENT, true, false};
+        }
+        last = d.strategy;
+        return d;
+    }
+
+private:
+    uint8_t last = CS_IDLE;
+    bool venting = false; // heat_vent phase
+};
@@ -9,11 +9,29 @@
 #include <Adafruit_AHTX0.h>
 #include <ScioSense_ENS160.h>
 #include <WiFiManager.h>
+#include <ESPAsyncWebServer.h>
 #include <Preferences.h>
 #include <LittleFS.h>
 #include <HTTPUpdate.h>
 #include <Update.h> // Required for Rollback
+#include <mbedtls/base64.h>
+#include <esp_heap_caps.h>
+#include <esp_pm.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
 #include "secrets.h"
+#include "setpoint_schedule.h"
+#include "rule_vm.h"
+#include "sensor_drivers.h"
+#include "telemetry_schema.h"
+#include "spsc_ring.h"
+#include "record_log.h"
+#include "adaptive_rate.h"
+#include "task_supervisor.h"
+#include "prom_writer.h"
+#include "actuator_events.h"
+#include "actuator_governor.h"
+#include "climate_arbiter.h"
 
 // ==========================================
 // 1. CONFIGURATION & PINOUT
@@ -31,6 +49,19 @@ int SOIL_WET = 70;                        // Pump OFF above this %
 int TANK_EMPTY_DIST = 25;                 // Distance when tank is empty (cm)
 int TANK_FULL_DIST = 5;                   // Distance when tank is full (cm)
 
+// --- IRRIGATION (Pulse & Soak) ---
+bool PULSE_SOAK_MODE = true;              // false = legacy continuous watering
+int PULSE_ON_SEC = 20;                    // Pump run time per pulse (s)
+int SOAK_SEC = 120;                       // Soak pause between pulses (s)
+int PUMP_FLOW_MLPM = 1500;                // Pump flow rate (ml/min), used for water estimates
+
+// --- CLIMATE ENERGY (rated loads, for kWh estimates) ---
+int FAN_WATTS = 40;
+int HEATER_WATTS = 500; // Halogen lamp
+
+// --- CLOCK ---
+int TZ_OFFSET_MIN = 330; // Local time offset from UTC in minutes (Sri Lanka: +5:30)
+
 // --- SENSOR CALIBRATION (ESP32 is 12-bit: 0-4095) ---
 int AIR_VAL = 4095;
 int WATER_VAL = 1670;
@@ -43,6 +74,108 @@ int WATER_VAL = 1670;
 #define PIN_ECHO 34     // Ultrasonic Echo
 #define PIN_SOIL 32     // Soil Moisture Analog
 #define PIN_RESET_BTN 4 // Boot Button (Hold 5s to reset WiFi)
+#define PIN_SDA 21      // I2C (sensors + LCD)
+#define PIN_SCL 22
+
+// --- BUILD OPTIONS ---
+#ifndef SENSOR_ASYNC
+#define SENSOR_ASYNC 1 // 0 = legacy blocking library reads (to compare acquisition times)
+#endif
+
+#ifndef STACK_PROFILING
+#define STACK_PROFILING 0 // 1 = oversized stacks + periodic high-water-mark report
+#endif
+
+// --- TASK STACKS (bytes, statically reserved) ---
+// NOT YET MEASURED: the default sizes are the old heap-allocated guesses
+// (4 KB sensors/control/UI, 10 KB AWS) plus estimates for the sampler and
+// supervisor. To budget them: build with STACK_PROFILING=1, drive worst-case
+// load (OTA plus a full-size rules command, offline upload, WiFi portal) and
+// copy the "recommended" sizes (peak + 25%) from the serial report here.
+// Until then, watch stack_free in telemetry.
+#if STACK_PROFILING
+#define STACK_SENSORS 8192
+#define STACK_CONTROL 8192
+#define STACK_UI 8192
+#define STACK_AWS 16384
+#define STACK_SAMPLER 8192
+#define STACK_SUPERVISOR 8192
+#else
+#define STACK_SENSORS 4096
+#define STACK_CONTROL 4096
+#define STACK_UI 4096
+#define STACK_AWS 10240
+#define STACK_SAMPLER 3072
+#define STACK_SUPERVISOR 3072
+#endif
+#ifndef POWER_SAVE
+#define POWER_SAVE 1 // 0 = fixed 240 MHz, WiFi always awake (bench testing)
+#endif
+
+// --- POWER MODEL (mA @ 3.3 V, ESP32 datasheet typicals; calibrate with a meter) ---
+#define PM_MA_240 50          // CPU active at 240 MHz
+#define PM_MA_80 25           // CPU active at 80 MHz
+#define PM_MA_IDLE_80 15      // Idle at 80 MHz without light sleep
+#define PM_MA_LIGHT_SLEEP 1   // Light sleep
+#define PM_MA_WIFI_MODEM 20   // WiFi connected, modem sleep (average over DTIM)
+#define PM_MA_WIFI_ACTIVE 100 // WiFi connected, radio always on
+#define PM_WAKE_ACTIVE_US 500 // CPU time per task wake-up (scheduler + loop body)
+
+#define STACK_CANARY_BYTES 32   // Bottom of each stack that must keep the fill pattern
+#define STACK_FILL_BYTE 0xA5    // FreeRTOS stack fill (tskSTACK_FILL_BYTE)
+
+// --- TIMING ---
+#define SOIL_FAST_MS 200        // Soil sampling period while the pump runs
+#define ENS_RETRY_MS 250        // ENS160 had no new sample yet: poll again after this
+#define SENSOR_MAX_SLEEP_MS 1000 // Sensor task heartbeat, even when every channel is slow
+#define SPLASH_MS 2000          // Device ID on the LCD at boot (does not hold up other tasks)
+#define NTP_WAIT_MS 10000       // After WiFi comes up, wait this long for NTP before trying TLS anyway
+#define WIFI_FAST_TIMEOUT_MS 1500 // Direct connect to the cached AP (no scan, no DHCP)
+#define WIFI_SCAN_TIMEOUT_MS 8000 // Full connect: scan + association + DHCP
+#define WIFI_RETRY_MIN_MS 1000    // Pause between reconnect rounds, doubling up to the max
+#define WIFI_RETRY_MAX_MS 30000
+#define LAN_RETRY_MS 5000         // Between LAN broker connect attempts
+#define WEB_PORT 8080             // LAN web server (80 belongs to the WiFiManager portal)
+#define WS_PUSH_MS 1000           // Live snapshot rate to WebSocket clients
+#define WS_MAX_CLIENTS 4          // Each client costs a few KB of heap
+#define WS_SNAPSHOT_MAX 512
+#define METRICS_BUF_SIZE 8192     // Rendered /metrics page (reused every scrape); ~7.3 KB with every value at full width
+#define CONTROL_PERIOD_MS 1000  // Control loop period
+#define CONTROL_FAST_MS 250     // Control loop period during an irrigation cycle
+#define CMD_QUEUE_LEN 8         // Manual commands waiting for the control task / their ack
+#define EVENT_QUEUE_LEN 16      // Actuator transitions waiting for the connectivity task
+#define MAX_PULSES_PER_CYCLE 15 // Safety: abort a cycle if soil never reaches SOIL_WET
+#define MAX_ZONES 4             // Irrigation zones (soil channel + valve each)
+#define MQTT_BUFFER_SIZE 6144   // Largest MQTT packet (commands carry rule bytecode)
+#define JSON_DOC_SIZE 4096      // Parsed command tree: a full shadow reset is ~180 nodes of 16 B
+#ifndef TELEMETRY_PERIOD_MS
+#define TELEMETRY_PERIOD_MS 5000 // Build with a small value to simulate weeks of logging quickly
+#endif
+#ifndef TELEMETRY_BENCH
+#define TELEMETRY_BENCH 0 // 1 = print schema writer vs snprintf timing every record
+#endif
+#define TELEMETRY_QUEUE_LEN 16 // Records buffered between sampler and uplink (power of two)
+#ifndef TELEMETRY_BINARY
+#define TELEMETRY_BINARY 0 // 1 = publish compact binary records (the offline log is always binary)
+#endif
+#define RAM_BUFFER_BYTES 16384  // Offline records buffered in RAM before a flash write
+#define OFFLINE_BATCH_RECORDS 20 // Backlog records uploaded per connectivity loop...
+#define OFFLINE_BATCH_MS 250      // ...or fewer once this much time has passed
+
+// --- SUPERVISOR ---
+#define SUPERVISOR_PERIOD_MS 1000 // Heartbeat check interval
+#define I2C_RESET_WAIT_MS 3500    // Bus mutex wait before a reset (longer than one Wire timeout)
+#define RECOVERY_WAIT_MS 5000     // Time each recovery step gets before escalating
+#define TASK_STOP_WAIT_MS 2000    // Time a task gets to reach its safe point for a restart
+#define WDT_TIMEOUT_S 60          // Hardware watchdog: backstop if the supervisor itself hangs
+#define ALERT_QUEUE_LEN 8         // Recovery alerts waiting for MQTT
+#define LOG_LINE_MAX 1024       // Longest offline log record (JSON lines from older firmware included)
+static_assert(TELEMETRY_BINARY_MAX <= LOG_LINE_MAX, "Binary telemetry records must fit the offline upload buffer");
+static_assert(TELEMETRY_JSON_MAX + 64 <= MQTT_BUFFER_SIZE, "Telemetry JSON plus topic must fit one MQTT packet");
+#define EPOCH_VALID 1600000000UL // time() above this means NTP has synced
+#define EPOCH_SAVE_MS 3600000UL  // Persist wall time hourly (fallback clock after power cut)
+#define BOOT_HISTORY 8           // Boots remembered for timestamp repair
+#define CLOCK_DRIFT_PPM 50       // Crystal tolerance used in the timestamp error bound
 
 // ==========================================
 // 2. OBJECTS & VARIABLES
@@ -51,8 +184,29 @@ int WATER_VAL = 1670;
 LiquidCrystal_I2C lcd(0x27, 20, 4);
 Adafruit_AHTX0 aht;
 ScioSense_ENS160 ens160(ENS160_I2CADDR_1);
+AsyncAHT21 ahtDrv(Wire);
+AsyncENS160 ensDrv(Wire, ENS160_I2CADDR_1);
+SemaphoreHandle_t i2cMutex; // Sensors and LCD share the bus across tasks
+
+// Power management: PM locks keep clocks up only while a peripheral needs
+// them; the time each is held feeds the current estimate.
+struct PmLock
+{
+    esp_pm_lock_handle_t handle; // NULL when power management is unavailable
+    uint32_t since;
+    volatile uint32_t heldUs;     // Cumulative, wraps
+    volatile TaskHandle_t holder; // Released on the holder's behalf if it is restarted
+};
+
+PmLock pmI2c, pmAdc, pmTls;
+uint8_t pmMode = 0; // 0 = off, 1 = frequency scaling, 2 = + automatic light sleep
+std::atomic<uint32_t> wakeCount{0}; // Task wake-ups (each one ends a sleep period)
 WiFiClientSecure net;
 PubSubClient client(net);
+WiFiClient lanNet;              // Plain TCP to the site broker
+PubSubClient lanClient(lanNet);
+AsyncWebServer webServer(WEB_PORT); // Live data for LAN dashboards
+AsyncWebSocket ws("/ws");
 
 // --- SHARED DATA (Thread Safe-ish via Volatile) ---
 volatile float currentTemp = 0.0;
@@ -60,9 +214,20 @@ volatile float currentHum = 0.0;
 volatile int eco2 = 400;
 volatile int tvoc = 0;
 volatile int soilMoisture = 0;
+volatile uint32_t ahtAcqUs = 0; // I2C/CPU time of the last AHT21 acquisition
+volatile uint32_t ensAcqUs = 0; // I2C/CPU time of the last ENS160 acquisition
+
+// Sampler (core 1) -> connectivity task (core 0)
+SpscRing<TelemetrySample, TELEMETRY_QUEUE_LEN> telemetryQueue;
+
+// --- HEAP HEALTH ---
+// The largest free block is what TLS needs; if it shrinks over time while
+// free heap stays constant, the heap is fragmenting.
+uint32_t heapLargestMin = UINT32_MAX; // Lowest largest-free-block seen since boot
 
 // --- STATE VARIABLES ---
 char deviceId[20]; // Unique Device ID derived from MAC
+static_assert(sizeof(deviceId) <= TELEMETRY_STR_MAX + 1, "Device id must fit the telemetry size bound");
 volatile bool pumpStatus = false;
 volatile bool fanStatus = false;
 volatile bool heaterStatus = false;
@@ -74,63 +239,560 @@ volatile bool stopPortalRequest = false;
 volatile bool btnRequest = false;
 bool hasOfflineData = true; // Check on boot
 
+// --- BOOT TIMING ---
+// ms since start-up at which each phase was first reached (0 = not yet).
+// Hardware is initialised inside the tasks that use it, so phases overlap.
+enum BootPhase
+{
+    BP_TASKS,   // setup() done, all tasks created
+    BP_LCD,     // LCD initialised
+    BP_SENSORS, // First soil and air readings
+    BP_CONTROL, // First control tick acting on real readings
+    BP_WIFI,
+    BP_NTP,
+    BP_MQTT,
+    BP_PUBLISH, // First live record published
+    BP_COUNT
+};
+const char *const BOOT_PHASE_NAMES[BP_COUNT] = {"tasks", "lcd", "sensors", "control", "wifi", "ntp", "mqtt", "publish"};
+volatile uint32_t bootMs[BP_COUNT];
+static_assert(BP_COUNT == TELEMETRY_BOOT_PHASES, "telemetry boot_ms must have one slot per phase");
+volatile bool sensorsReady = false; // Control keeps the relays off until this is set
+volatile bool sensorInitOk = true;  // AHT21 and ENS160 both answered at boot
+
+void markBoot(BootPhase phase)
+{
+    if (bootMs[phase] == 0)
+        bootMs[phase] = millis() ? millis() : 1;
+}
+
+void printBootReport()
+{
+    Serial.print("Boot Timing (ms):");
+    for (int i = 0; i < BP_COUNT; i++)
+        Serial.printf(" %s=%lu", BOOT_PHASE_NAMES[i], (unsigned long)bootMs[i]);
+    Serial.println();
+}
+
+// --- WIFI FAST RECONNECT ---
+// Last good AP and DHCP lease. Connecting straight to a known BSSID and
+// channel with the previous address skips the scan and DHCP. Kept in RTC
+// memory (survives resets) and NVS (survives power cuts). The cached address
+// only bridges the connect: DHCP is restarted as soon as the link is up.
+#define WIFI_CACHE_MAGIC 0x57434331 // "WCC1"
+
+struct WifiCache
+{
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip, gateway, subnet, dns;
+};
+
+RTC_DATA_ATTR WifiCache wifiCache;
+volatile uint32_t wifiBeginAt = 0;  // millis() when the current connect attempt started
+volatile uint32_t wifiAssocAt = 0;  // millis() when it associated
+volatile uint16_t wifiAssocMs = 0;  // Last connect: start -> associated (includes any scan)
+volatile uint16_t wifiDhcpMs = 0;   // Last connect: associated -> IP
+volatile bool wifiFastUsed = false; // Last connect went straight to the cached AP
+volatile bool wifiDhcpPending = false; // DHCP restarted after a cached connect
+volatile bool wifiLeaseRenewed = false; // ...and has bound; the cache needs saving
+
+// --- LAN BROKER ---
+// Optional MQTT broker on the site network (e.g. mosquitto on the site
+// server). It gets live telemetry and accepts commands on the same topics as
+// AWS, so local dashboards keep working while the internet uplink is down.
+// Records still go to the offline log for AWS while it is unreachable.
+enum LanMode : uint8_t
+{
+    LAN_OFF,
+    LAN_FALLBACK, // Connect after AWS has been unreachable for failoverMs
+    LAN_ALWAYS    // Mirror everything to the LAN broker as well
+};
+const char *const LAN_MODE_NAMES[] = {"off", "fallback", "always"};
+
+struct LanBrokerConfig
+{
+    char host[64]; // Hostname or IP
+    uint16_t port;
+    uint8_t mode;
+    uint32_t failoverMs;
+    char user[32]; // Empty = anonymous
+    char pass[32];
+};
+
+LanBrokerConfig lanCfg = {"", 1883, LAN_OFF, 30000, "", ""}; // Owned by the connectivity task
+volatile bool lanConnected = false;
+
+// --- LAN WEB SERVER ---
+volatile bool webServerStarted = false;
+uint32_t wsHeapBase = 0;              // Free heap last seen with no clients
+volatile uint16_t wsClientBytes = 0;  // Approximate heap per connected client
+volatile uint32_t wsRejected = 0;     // Connections refused at the client cap
+
+// --- METRICS ---
+// Counters for /metrics. Written by one task each; readers tolerate a stale value.
+enum Actuator
+{
+    ACT_PUMP,
+    ACT_FAN,
+    ACT_HEATER,
+    ACT_COUNT
+};
+const char *const ACTUATOR_NAMES[ACT_COUNT] = {"pump", "fan", "heater"};
+volatile uint32_t actuatorOnS[ACT_COUNT] = {0}; // Seconds on since boot (from transitions)
+volatile uint32_t mqttConnects = 0;
+volatile uint32_t mqttConnectFails = 0;
+volatile uint32_t mqttPublishes = 0;
+volatile uint32_t mqttPublishFails = 0;
+volatile uint32_t mqttReceived = 0;
+volatile uint32_t eventCorrupt = 0; // Events skipped because they would not encode
+volatile uint32_t offlinePendingBytes = 0; // Offline log not yet uploaded (RAM buffer + file)
+volatile uint32_t fsUsedBytes = 0;
+volatile uint32_t fsTotalBytes = 0;
+volatile uint32_t metricsRenderUs = 0; // Time taken by the last /metrics render
+volatile uint32_t metricsOverflows = 0; // Scrapes that did not fit METRICS_BUF_SIZE
+
+// --- ACTUATOR GOVERNOR ---
+// Hysteresis band (in the controlled variable's units), minimum on/off time
+// and switch-ons per hour for each relay. Configurable via "governor".
+GovernorLimits govLimits[ACT_COUNT] = {
+    {0, 10000, 5000, 0},      // Pump: soil dry/wet is its band, pulse & soak sets the rhythm
+    {0.5f, 30000, 30000, 12}, // Fan (°C and %RH)
+    {0.5f, 60000, 60000, 6},  // Heater (°C)
+};
+portMUX_TYPE governorMux = portMUX_INITIALIZER_UNLOCKED; // Guards govLimits
+volatile uint32_t actuatorSwitches[ACT_COUNT] = {0};      // Lifetime relay switch counts (NVS, saved hourly)
+static_assert(ACT_COUNT == TELEMETRY_ACTUATORS, "telemetry switches must have one slot per actuator");
+
+// --- CLIMATE ARBITRATION ---
+ClimateArbiter climateArbiter;                // Control task only
+volatile uint8_t climateStrategy = CS_IDLE;   // Strategy in force since the last control tick
+volatile float climateWh[CS_COUNT] = {0};     // Estimated heater + fan energy per strategy since boot
+static_assert(CS_COUNT == TELEMETRY_STRATEGIES, "telemetry energy_wh must have one slot per strategy");
+
+// --- DEVICE SHADOW ---
+uint32_t shadowVersion = 0;               // Last desired version applied (NVS "shadow_ver")
+volatile bool shadowReportPending = false; // Publish the reported state on the next loop
+// Keys of the desired version being applied that failed validation, as a JSON
+// string list. The version is acknowledged only once none were rejected.
+char shadowRejected[256];
+uint32_t shadowRejectedVersion = 0;
+bool shadowMidVersion = false; // Earlier parts of this version came with "more"
+bool shadowApplying = false; // messageHandler is applying a desired document
+char shadowError[32];        // Last desired document that could not be parsed
+
 // --- MANUAL MODE VARIABLES ---
 volatile bool manualMode = false;   // false = Auto, true = Manual
 volatile bool manualPump = false;   // Manual pump state
 volatile bool manualFan = false;    // Manual fan state
 volatile bool manualHeater = false; // Manual heater state
 
+// Manual commands wake the control task directly; it acks each one once the
+// relays have switched. `id` comes from the backend (empty if none was sent).
+struct CommandAck
+{
+    char id[24];
+    uint32_t rxUs;      // micros() when the message arrived
+    uint32_t latencyUs; // Arrival to relay switched
+    bool pump, fan, heater, manual;
+};
+SpscRing<CommandAck, CMD_QUEUE_LEN> commandQueue; // Connectivity task -> control task
+SpscRing<CommandAck, CMD_QUEUE_LEN> ackQueue;     // Control task -> connectivity task
+
 // --- WATER TANK LEVEL ---
 volatile int waterTankLevel = 0; // Tank level percentage (0-100%)
 
+// --- IRRIGATION ZONES (struct-of-arrays) ---
+// Each zone has its own soil channel and valve; all valves share one pump.
+// Zone 0 defaults to the original PIN_SOIL with no valve (pump only).
+enum IrrigationPhase : uint8_t
+{
+    IRR_IDLE,    // Waiting for soil to dry out
+    IRR_PENDING, // Needs water, waiting for a free valve slot
+    IRR_PULSE,   // Valve open, pump running
+    IRR_SOAK     // Valve closed, water diffusing
+};
+
+struct ZoneConfig
+{
+    uint8_t count;
+    int8_t soilPin[MAX_ZONES];  // ADC1 pin (32-39)
+    int8_t valvePin[MAX_ZONES]; // Valve relay pin, -1 = watered by the pump alone
+    uint8_t dry[MAX_ZONES];     // Per-zone dry/wet %, both 0 = follow global setpoints
+    uint8_t wet[MAX_ZONES];
+};
+
+ZoneConfig zoneCfg = {1, {PIN_SOIL}, {-1}, {0}, {0}};
+
+// Valve relays: GPIOs that are free on the DevKit V1 and safe to drive from
+// boot (not flash 6-11, UART0 1/3, strapping 0/2/5/12/15 or input-only 34-39)
+const int8_t VALVE_PINS_ALLOWED[] = {13, 16, 17, 18, 19, 23, 25, 32, 33};
+
+bool valvePinAllowed(int pin)
+{
+    for (int8_t p : VALVE_PINS_ALLOWED)
+        if (p == pin)
+            return true;
+    return false;
+}
+
+// Checked on every update and on the copy loaded from NVS
+bool zoneConfigValid(const ZoneConfig &cfg)
+{
+    if (cfg.count < 1 || cfg.count > MAX_ZONES)
+        return false;
+    for (int i = 0; i < cfg.count; i++)
+    {
+        // Soil must be on ADC1 (ADC2 is unusable while WiFi runs)
+        if (cfg.soilPin[i] < 32 || cfg.soilPin[i] > 39 || cfg.soilPin[i] == PIN_ECHO)
+            return false;
+        if (cfg.valvePin[i] != -1 && !valvePinAllowed(cfg.valvePin[i]))
+            return false;
+        // Thresholds come as a pair (both 0 = follow the global setpoints)
+        if ((cfg.dry[i] == 0) != (cfg.wet[i] == 0) || cfg.wet[i] > 100 || (cfg.wet[i] && cfg.dry[i] >= cfg.wet[i]))
+            return false;
+        // Each valve needs its own pin, and none may drive a soil sensor input
+        for (int j = 0; j < cfg.count; j++)
+        {
+            if (cfg.valvePin[i] != -1 &&
+                (cfg.valvePin[i] == cfg.soilPin[j] || (j != i && cfg.valvePin[i] == cfg.valvePin[j])))
+                return false;
+        }
+    }
+    return true;
+}
+ZoneConfig pendingZoneCfg;             // Written by messageHandler, applied by the control task
+volatile bool zoneCfgPending = false;
+portMUX_TYPE zoneMux = portMUX_INITIALIZER_UNLOCKED; // Guards pendingZoneCfg, and zoneCfg while it is replaced
+
+// zoneCfg is owned by the control task; every other task reads a copy
+ZoneConfig zoneConfigSnapshot()
+{
+    portENTER_CRITICAL(&zoneMux);
+    ZoneConfig cfg = zoneCfg;
+    portEXIT_CRITICAL(&zoneMux);
+    return cfg;
+}
+int MAX_ACTIVE_VALVES = 1; // Zones allowed to take water at the same time
+
+volatile int zoneMoisture[MAX_ZONES];
+volatile IrrigationPhase zonePhase[MAX_ZONES];
+volatile bool zoneValveOn[MAX_ZONES];
+unsigned long zonePhaseStart[MAX_ZONES];
+uint8_t zoneCyclePulses[MAX_ZONES];
+float zoneCycleWaterMl[MAX_ZONES];
+volatile float zoneLastWaterMl[MAX_ZONES];  // Water used by the last completed cycle
+volatile float zoneTotalWaterMl[MAX_ZONES]; // Water used since boot
+volatile uint8_t zoneLastPulses[MAX_ZONES]; // Pulses used by the last completed cycle
+
+// --- ADAPTIVE SAMPLING ---
+// Each channel samples fast while its signal moves and stretches its period
+// while it is stable (see adaptive_rate.h). Limits are set over MQTT.
+enum SampleChannel
+{
+    CH_TEMP,
+    CH_HUM,
+    CH_CO2,
+    CH_SOIL,
+    CH_COUNT
+};
+const char *const SAMPLE_CHANNEL_KEYS[CH_COUNT] = {"temp", "hum", "co2", "soil"};
+
+ChannelLimits sampleLimits[CH_COUNT] = {
+    {500, 30000, 0.02f, 0.15f}, // Temperature (°C/s, °C)
+    {500, 30000, 0.10f, 0.5f},  // Humidity (%/s, %)
+    {1000, 60000, 5.0f, 20.0f}, // eCO2 (ppm/s, ppm); ENS160 updates at 1 Hz
+    {1000, 60000, 0.2f, 1.0f},  // Soil moisture, every zone (%/s, %)
+};
+portMUX_TYPE samplingMux = portMUX_INITIALIZER_UNLOCKED; // Guards sampleLimits
+volatile uint32_t samplePeriodMs[CH_COUNT];               // Effective period per channel (telemetry)
+static_assert(CH_COUNT == TELEMETRY_CHANNELS, "telemetry sample_ms must have one slot per channel");
+
+// --- SETPOINT SCHEDULE ---
+SetpointSchedule schedule;      // Time-of-day targets (empty = use fixed thresholds)
+SemaphoreHandle_t scheduleMutex; // Guards `schedule` between MQTT callback and control task
+Setpoints activeSp;              // Targets applied by the last control tick
+volatile int activeSegment = -1; // Schedule segment in use (-1 = fixed thresholds)
+volatile int activeStage = -1;   // Growth stage in use (-1 = none)
+volatile uint8_t clockSource = 0; // 0 = no clock, 1 = estimated (NVS + uptime), 2 = NTP
+uint32_t lastKnownEpoch = 0;      // Last wall time persisted to NVS
+unsigned long lastKnownEpochAt = 0; // millis() when lastKnownEpoch was loaded
+
+// Records store boot_id + mono_ms (ms since that boot). Each boot's wall-clock
+// start is learned at its first NTP sync; boots that never synced are bounded
+// by their neighbours, so records can be rebased before upload.
+struct BootInfo
+{
+    uint32_t bootId;
+    uint32_t lastMonoMs; // Uptime of the last record flushed to flash
+    uint32_t startEpoch; // Wall time at mono 0 (0 = never synced)
+};
+
+struct BootHistory
+{
+    uint8_t count;
+    BootInfo boots[BOOT_HISTORY]; // Oldest first; the last entry is this boot
+};
+
+BootHistory bootHistory;
+uint32_t bootId = 0;
+uint32_t recordSeq = 0; // Per-boot record counter: (boot_id, seq) is unique and ordered per device
+
+// --- USER RULES ---
+RuleVM ruleVM;                    // Bytecode rules compiled by the backend
+SemaphoreHandle_t rulesMutex;     // Guards `ruleVM` between MQTT callback and control task
+volatile uint32_t ruleEvalUs = 0; // Time taken by the last rule evaluation
+
 // --- TASK HANDLES ---
 void TaskReadSensors(void *pvParameters);
 void TaskControlSystem(void *pvParameters);
 void TaskConnectivity(void *pvParameters);
 void TaskInterface(void *pvParameters);
+void TaskSampler(void *pvParameters);
+void TaskSupervisor(void *pvParameters);
+
+// Tasks are created from static memory: no heap allocation at boot, and the
+// stacks can be inspected for high-water marks and canaries at runtime.
+enum TaskId
+{
+    TASK_SENSORS,
+    TASK_CONTROL,
+    TASK_UI,
+    TASK_AWS,
+    TASK_SAMPLER,
+    TASK_SUPERVISOR,
+    TASK_COUNT
+};
+static_assert(TASK_COUNT == TELEMETRY_TASKS, "telemetry stack_free must have one slot per task");
+
+struct TaskSlot
+{
+    const char *name;
+    uint32_t stackSize;
+    StackType_t *stack;
+    StaticTask_t tcb;
+    TaskHandle_t handle;
+    uint32_t minFree; // Lowest free stack seen (bytes)
+    bool canaryOk;
+    volatile uint32_t heartbeat; // Bumped once per loop, checked by the supervisor
+    volatile bool stopRequest;   // Set by restartTask, honoured at the task's safe point
+    volatile bool parked;        // The task has stopped at its safe point
+    TaskFunction_t fn;           // Kept so the supervisor can restart the task
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+StackType_t stackSensors[STACK_SENSORS];
+StackType_t stackControl[STACK_CONTROL];
+StackType_t stackUi[STACK_UI];
+StackType_t stackAws[STACK_AWS];
+StackType_t stackSampler[STACK_SAMPLER];
+StackType_t stackSupervisor[STACK_SUPERVISOR];
+
+TaskSlot tasks[TASK_COUNT] = {
+    {"Sensors", STACK_SENSORS, stackSensors},
+    {"Control", STACK_CONTROL, stackControl},
+    {"UI", STACK_UI, stackUi},
+    {"AWS", STACK_AWS, stackAws},
+    {"Sampler", STACK_SAMPLER, stackSampler},
+    {"Supervisor", STACK_SUPERVISOR, stackSupervisor},
+};
+
+inline void heartbeat(TaskId id) { tasks[id].heartbeat++; }
+
+portMUX_TYPE taskStopMux = portMUX_INITIALIZER_UNLOCKED; // Guards stopRequest/parked
+
+// Called at the top of every task loop, where the task holds no mutex, file,
+// NVS handle or socket. A task being restarted suspends itself here and the
+// supervisor deletes it (see restartTask).
+inline void taskSafePoint(TaskId id)
+{
+    portENTER_CRITICAL(&taskStopMux);
+    bool stop = tasks[id].stopRequest;
+    tasks[id].parked = stop;
+    portEXIT_CRITICAL(&taskStopMux);
+    if (stop)
+        vTaskSuspend(NULL);
+}
+
+// --- SUPERVISOR STATE ---
+// Stall limit per task and the recovery steps worth trying before a reboot
+TaskWatch taskWatch[TASK_COUNT] = {
+    {5000, RS_MASK(RS_I2C_RESET) | RS_MASK(RS_TASK_RESTART)},     // Sensors
+    {5000, RS_MASK(RS_TASK_RESTART)},                             // Control
+    {5000, RS_MASK(RS_I2C_RESET) | RS_MASK(RS_TASK_RESTART)},     // UI
+    {30000, RS_MASK(RS_MQTT_RESTART) | RS_MASK(RS_TASK_RESTART)}, // AWS (TLS connect can take a while)
+    {3 * TELEMETRY_PERIOD_MS + 1000, RS_MASK(RS_TASK_RESTART)},   // Sampler
+    {0, 0},                                                       // Supervisor (hardware watchdog)
+};
+
+struct SupervisorAlert
+{
+    uint8_t task;
+    uint8_t step;
+    bool recovered; // Task is beating again after `step`
+    bool ok;        // Step could be carried out
+    uint32_t stalledMs;
+};
+
+SpscRing<SupervisorAlert, ALERT_QUEUE_LEN> alertQueue; // Supervisor -> connectivity task
+volatile bool mqttRestartRequest = false;
+volatile uint16_t recoveryCount = 0; // Recovery steps taken since boot
+
+// --- SCHEDULE HELPERS ---
+// "start" may be minutes since midnight (360) or a "HH:MM" string ("06:00")
+int parseMinuteOfDay(JsonVariantConst v)
+{
+    if (v.is<const char *>())
+    {
+        int h = 0, m = 0;
+        if (sscanf(v.as<const char *>(), "%d:%d", &h, &m) != 2)
+            return -1;
+        return (h >= 0 && h < 24 && m >= 0 && m < 60) ? h * 60 + m : -1;
+    }
+    int val = v | -1;
+    return (val >= 0 && val < SCHED_MINUTES_PER_DAY) ? val : -1;
+}
+
+// Builds a schedule from a JSON command. Missing targets in a segment default
+// to the fixed thresholds. Returns false if the table is invalid.
+bool parseSchedule(JsonObjectConst obj, SetpointSchedule &out)
+{
+    out.clear();
+    SetpointScheduleData &d = out.data;
+    d.rampMin = obj["ramp"] | 30;
+
+    JsonArrayConst segs = obj["segments"];
+    for (JsonObjectConst seg : segs)
+    {
+        if (d.segmentCount >= SCHED_MAX_SEGMENTS)
+            return false;
+        int start = parseMinuteOfDay(seg["start"]);
+        if (start < 0)
+            return false;
+        SetpointSegment &s = d.segments[d.segmentCount++];
+        s.startMin = start;
+        s.sp.tempMin = seg["temp_min"] | TEMP_MIN_NIGHT;
+        s.sp.tempMax = seg["temp_max"] | TEMP_MAX_DAY;
+        s.sp.humMax = seg["hum_max"] | HUM_MAX;
+        s.sp.soilDry = seg["soil_dry"] | (float)SOIL_DRY;
+        s.sp.soilWet = seg["soil_wet"] | (float)SOIL_WET;
+        if (s.sp.tempMin >= s.sp.tempMax || s.sp.soilDry >= s.sp.soilWet)
+            return false;
+    }
+
+    JsonArrayConst stages = obj["stages"];
+    for (JsonObjectConst st : stages)
+    {
+        if (d.stageCount >= SCHED_MAX_STAGES)
+            return false;
+        GrowthStage &g = d.stages[d.stageCount++];
+        g.days = st["days"] | 7;
+        g.tempOffset = st["temp_offset"] | 0.0f;
+        g.humOffset = st["hum_offset"] | 0.0f;
+        g.soilOffset = st["soil_offset"] | 0.0f;
+    }
+    d.stageStart = obj["stage_start"] | 0UL;
+
+    return out.rebuild();
+}
 
 // --- AWS CALLBACK ---
+// A config key whose value failed validation. Within a desired document it is
+// reported back with the shadow instead of being acknowledged.
+void rejectKey(const char *key)
+{
+    Serial.printf("Config Rejected: %s\n", key);
+    if (!shadowApplying)
+        return;
+    char quoted[24];
+    snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+    size_t n = strlen(shadowRejected);
+    if (strstr(shadowRejected, quoted) || n + strlen(quoted) + 2 > sizeof(shadowRejected))
+        return;
+    snprintf(shadowRejected + n, sizeof(shadowRejected) - n, n ? ",%s" : "%s", quoted);
+}
+
 void messageHandler(char *topic, byte *payload, unsigned int length)
 {
+    uint32_t rxUs = micros();
+
     // 1. Debug: Print the raw payload
-    // FIX: Use Heap instead of Stack to prevent overflow with large payloads
-    if (length > 10240)
-    { // Limit to 10KB
-        Serial.println("Payload too large!");
-        return;
-    }
-    char *jsonStr = (char *)malloc(length + 1);
-    if (!jsonStr)
+    // Fixed buffer (no heap churn); PubSubClient never delivers more than its
+    // own buffer size. Only the connectivity task calls this handler.
+    static char jsonStr[MQTT_BUFFER_SIZE + 1];
+    if (length >= sizeof(jsonStr))
     {
-        Serial.println("Malloc failed");
+        Serial.println("Payload too large!");
         return;
     }
     memcpy(jsonStr, payload, length);
     jsonStr[length] = '\0';
+    mqttReceived++;
 
     Serial.print("AWS CMD Topic: ");
     Serial.println(topic);
     Serial.print("AWS CMD Payload: ");
-    Serial.println(jsonStr);
+    Serial.println(jsonStr); // Printed before parsing: zero-copy parsing modifies the buffer
 
-    StaticJsonDocument<1024> doc; // Increased size
-    DeserializationError error = deserializeJson(doc, (const char *)jsonStr);
+    // Zero-copy parse: strings (e.g. rule bytecode) stay in jsonStr, so the
+    // document only holds the tree. Sized for a full shadow reset (every key,
+    // schedule with all segments and stages, all zones). Static to keep it
+    // off the connectivity task's stack.
+    static StaticJsonDocument<JSON_DOC_SIZE> doc;
+    DeserializationError error = deserializeJson(doc, jsonStr);
+    bool shadow = strstr(topic, "/shadow/desired") != NULL;
 
     if (error)
     {
         Serial.print("deserializeJson() failed: ");
         Serial.println(error.c_str());
-        free(jsonStr); // FIX: Free memory
+        if (shadow)
+        {
+            // Reported, so the backend sees why the version is not acknowledged
+            snprintf(shadowError, sizeof(shadowError), "%s", error.c_str());
+            shadowReportPending = true;
+        }
         return;
     }
 
+    // Device shadow: {"version": N, "state": {<config keys>}} on .../shadow/desired.
+    // Versions only move forward, so a replayed delta is not applied twice.
+    // "reset" marks a full document from a backend whose versions restarted.
+    // A version too large for one message (rule bytecode) comes in parts, all
+    // but the last marked "more". It is acknowledged after the last part, and
+    // only if no key of it was rejected; otherwise the rejected keys are
+    // reported and the version stays where it was.
+    uint32_t version = 0;
+    bool more = false;
+    if (shadow)
+    {
+        version = doc["version"] | 0;
+        more = doc["more"] | false;
+        if (version <= shadowVersion && !(doc["reset"] | false))
+        {
+            Serial.printf("Shadow v%lu Already Applied\n", (unsigned long)version);
+            shadowReportPending = true;
+            return;
+        }
+        if (version != shadowRejectedVersion || !shadowMidVersion)
+        {
+            shadowRejectedVersion = version;
+            shadowRejected[0] = '\0';
+        }
+        shadowError[0] = '\0';
+        shadowApplying = true;
+    }
+    JsonObject settings = shadow ? doc["state"] : doc.as<JsonObject>();
+
     // 2. Configuration Updates
     bool configChanged = false;
 
     // Support both "temp_min" and "min_temp" keys
-    if (doc.containsKey("temp_min") || doc.containsKey("min_temp"))
+    if (settings.containsKey("temp_min") || settings.containsKey("min_temp"))
     {
-        float val = doc.containsKey("temp_min") ? doc["temp_min"] : doc["min_temp"];
+        float val = settings.containsKey("temp_min") ? settings["temp_min"] : settings["min_temp"];
         if (val >= 0 && val <= 100)
         {
             // FIX: Flash Wear-Out Protection (Only write if changed)
@@ -141,11 +803,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putFloat("temp_min", TEMP_MIN_NIGHT);
             }
         }
+        else
+            rejectKey("temp_min");
     }
 
-    if (doc.containsKey("temp_max") || doc.containsKey("max_temp"))
+    if (settings.containsKey("temp_max") || settings.containsKey("max_temp"))
     {
-        float val = doc.containsKey("temp_max") ? doc["temp_max"] : doc["max_temp"];
+        float val = settings.containsKey("temp_max") ? settings["temp_max"] : settings["max_temp"];
         if (val >= 0 && val <= 100)
         {
             if (abs(TEMP_MAX_DAY - val) > 0.1)
@@ -155,11 +819,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putFloat("temp_max", TEMP_MAX_DAY);
             }
         }
+        else
+            rejectKey("temp_max");
     }
 
-    if (doc.containsKey("hum_max") || doc.containsKey("max_hum"))
+    if (settings.containsKey("hum_max") || settings.containsKey("max_hum"))
     {
-        float val = doc.containsKey("hum_max") ? doc["hum_max"] : doc["max_hum"];
+        float val = settings.containsKey("hum_max") ? settings["hum_max"] : settings["max_hum"];
         if (val >= 0 && val <= 100)
         {
             if (abs(HUM_MAX - val) > 0.1)
@@ -169,11 +835,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putFloat("hum_max", HUM_MAX);
             }
         }
+        else
+            rejectKey("hum_max");
     }
 
-    if (doc.containsKey("soil_dry"))
+    if (settings.containsKey("soil_dry"))
     {
-        int val = doc["soil_dry"];
+        int val = settings["soil_dry"];
         if (val >= 0 && val <= 100)
         {
             if (SOIL_DRY != val)
@@ -183,10 +851,12 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putInt("soil_dry", SOIL_DRY);
             }
         }
+        else
+            rejectKey("soil_dry");
     }
-    if (doc.containsKey("soil_wet"))
+    if (settings.containsKey("soil_wet"))
     {
-        int val = doc["soil_wet"];
+        int val = settings["soil_wet"];
         if (val >= 0 && val <= 100)
         {
             if (SOIL_WET != val)
@@ -196,11 +866,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putInt("soil_wet", SOIL_WET);
             }
         }
+        else
+            rejectKey("soil_wet");
     }
 
-    if (doc.containsKey("tank_empty_dist"))
+    if (settings.containsKey("tank_empty_dist"))
     {
-        int val = doc["tank_empty_dist"];
+        int val = settings["tank_empty_dist"];
         if (val > 0 && val < 1000)
         {
             if (TANK_EMPTY_DIST != val)
@@ -210,11 +882,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putInt("tank_empty", TANK_EMPTY_DIST);
             }
         }
+        else
+            rejectKey("tank_empty_dist");
     }
 
-    if (doc.containsKey("tank_full_dist"))
+    if (settings.containsKey("tank_full_dist"))
     {
-        int val = doc["tank_full_dist"];
+        int val = settings["tank_full_dist"];
         if (val > 0 && val < 1000)
         {
             if (TANK_FULL_DIST != val)
@@ -224,11 +898,13 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
                 preferences.putInt("tank_full", TANK_FULL_DIST);
             }
         }
+        else
+            rejectKey("tank_full_dist");
     }
 
-    if (doc.containsKey("cal_air"))
+    if (settings.containsKey("cal_air"))
     {
-        int val = doc["cal_air"];
+        int val = settings["cal_air"];
         if (AIR_VAL != val)
         {
             AIR_VAL = val;
@@ -236,9 +912,9 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
             preferences.putInt("cal_air", AIR_VAL);
         }
     }
-    if (doc.containsKey("cal_water"))
+    if (settings.containsKey("cal_water"))
     {
-        int val = doc["cal_water"];
+        int val = settings["cal_water"];
         if (WATER_VAL != val)
         {
             WATER_VAL = val;
@@ -247,104 +923,651 @@ void messageHandler(char *topic, byte *payload, unsigned int length)
         }
     }
 
-    if (configChanged)
+    if (settings.containsKey("irrigation_mode"))
     {
-        Serial.println("Configuration Updated & Saved!");
+        const char *val = settings["irrigation_mode"];
+        if (val)
+        {
+            bool pulse = (strcmp(val, "pulse") == 0);
+            if (PULSE_SOAK_MODE != pulse)
+            {
+                PULSE_SOAK_MODE = pulse;
+                configChanged = true;
+                preferences.putBool("irr_pulse", PULSE_SOAK_MODE);
+            }
+        }
+        else
+            rejectKey("irrigation_mode");
     }
 
-    // 3. Control Commands (Manual Mode)
-    if (doc.containsKey("mode"))
+    if (settings.containsKey("pulse_on"))
     {
-        String m = doc["mode"];
-        if (m == "MANUAL" || m == "manual" || m == "1")
+        int val = settings["pulse_on"];
+        if (val > 0 && val <= 600)
         {
-            manualMode = true;
+            if (PULSE_ON_SEC != val)
+            {
+                PULSE_ON_SEC = val;
+                configChanged = true;
+                preferences.putInt("pulse_on", PULSE_ON_SEC);
+            }
         }
-        else if (m == "AUTO" || m == "auto" || m == "0")
+        else
+            rejectKey("pulse_on");
+    }
+
+    if (settings.containsKey("soak_time"))
+    {
+        int val = settings["soak_time"];
+        if (val >= 0 && val <= 3600)
         {
-            manualMode = false;
-            manualPump = false;
-            manualFan = false;
-            manualHeater = false;
+            if (SOAK_SEC != val)
+            {
+                SOAK_SEC = val;
+                configChanged = true;
+                preferences.putInt("soak_sec", SOAK_SEC);
+            }
         }
-        Serial.print("Mode set to: ");
-        Serial.println(manualMode ? "MANUAL" : "AUTO");
+        else
+            rejectKey("soak_time");
     }
 
-    if (doc.containsKey("pump"))
+    if (settings.containsKey("pump_flow"))
     {
-        if (manualMode)
+        int val = settings["pump_flow"];
+        if (val > 0 && val <= 100000)
         {
-            int val = doc["pump"]; // 0 or 1
-            manualPump = (val == 1);
-            Serial.print("Manual Pump: ");
-            Serial.println(manualPump ? "ON" : "OFF");
+            if (PUMP_FLOW_MLPM != val)
+            {
+                PUMP_FLOW_MLPM = val;
+                configChanged = true;
+                preferences.putInt("pump_flow", PUMP_FLOW_MLPM);
+            }
         }
+        else
+            rejectKey("pump_flow");
     }
-    if (doc.containsKey("fan"))
+
+    if (settings.containsKey("fan_w"))
     {
-        if (manualMode)
+        int val = settings["fan_w"];
+        if (val >= 0 && val <= 5000)
         {
-            int val = doc["fan"];
-            manualFan = (val == 1);
-            Serial.print("Manual Fan: ");
-            Serial.println(manualFan ? "ON" : "OFF");
+            if (FAN_WATTS != val)
+            {
+                FAN_WATTS = val;
+                configChanged = true;
+                preferences.putInt("fan_w", FAN_WATTS);
+            }
         }
+        else
+            rejectKey("fan_w");
     }
-    if (doc.containsKey("heater"))
+
+    if (settings.containsKey("heater_w"))
     {
-        if (manualMode)
+        int val = settings["heater_w"];
+        if (val >= 0 && val <= 5000)
         {
-            int val = doc["heater"];
-            manualHeater = (val == 1);
-            Serial.print("Manual Heater: ");
-            Serial.println(manualHeater ? "ON" : "OFF");
+            if (HEATER_WATTS != val)
+            {
+                HEATER_WATTS = val;
+                configChanged = true;
+                preferences.putInt("heater_w", HEATER_WATTS);
+            }
         }
+        else
+            rejectKey("heater_w");
     }
 
-    // Check for OTA Update
-    if (doc.containsKey("update_url"))
+    if (settings.containsKey("tz_offset"))
     {
-        const char *url = doc["update_url"];
-        Serial.println("OTA Update Requested...");
-        Serial.println(url);
+        int val = settings["tz_offset"];
+        if (val >= -720 && val <= 840)
+        {
+            if (TZ_OFFSET_MIN != val)
+            {
+                TZ_OFFSET_MIN = val;
+                configChanged = true;
+                preferences.putInt("tz_offset", TZ_OFFSET_MIN);
+            }
+        }
+        else
+            rejectKey("tz_offset");
+    }
 
-        // Disable WDT for this task during update (prevent timeout)
-        esp_task_wdt_delete(NULL);
+    if (settings.containsKey("schedule"))
+    {
+        // Built off to the side (1.7 KB), then swapped in under the mutex
+        static SetpointSchedule incoming;
+        JsonObjectConst sch = settings["schedule"];
+        if (sch.isNull() || parseSchedule(sch, incoming))
+        {
+            if (sch.isNull())
+                incoming.clear();
+            if (sch["stage_start"] == "now")
+                incoming.data.stageStart = (uint32_t)time(nullptr);
+            xSemaphoreTake(scheduleMutex, portMAX_DELAY);
+            schedule = incoming;
+            xSemaphoreGive(scheduleMutex);
+            preferences.putBytes("schedule", &incoming.data, sizeof(incoming.data));
+            configChanged = true;
+            Serial.printf("Schedule Loaded: %d segments, %d stages\n", incoming.data.segmentCount, incoming.data.stageCount);
+        }
+        else
+        {
+            Serial.println("Schedule Rejected (invalid table)");
+            rejectKey("schedule");
+        }
+    }
 
-        // Use a separate client for OTA to avoid messing up AWS certs
-        WiFiClientSecure otaClient;
-        otaClient.setInsecure(); // Allow any HTTPS server (GitHub, S3, etc.)
+    if (settings.containsKey("zones"))
+    {
+        JsonArrayConst zones = settings["zones"];
+        ZoneConfig cfg = {};
+        bool ok = zones.size() >= 1 && zones.size() <= MAX_ZONES;
+        for (JsonObjectConst z : zones)
+        {
+            if (!ok)
+                break;
+            int i = cfg.count++;
+            int soilPin = z["soil_pin"] | -1;
+            int valvePin = z["valve_pin"] | -1;
+            int dry = z["dry"] | 0;
+            int wet = z["wet"] | 0;
+            // Range-check before narrowing into the config
+            if (soilPin < 0 || soilPin > 39 || valvePin < -1 || valvePin > 39 || dry < 0 || dry > 100 || wet < 0 ||
+                wet > 100)
+            {
+                ok = false;
+                break;
+            }
+            cfg.soilPin[i] = soilPin;
+            cfg.valvePin[i] = valvePin;
+            cfg.dry[i] = dry;
+            cfg.wet[i] = wet;
+        }
+        if (ok && zoneConfigValid(cfg))
+        {
+            portENTER_CRITICAL(&zoneMux);
+            pendingZoneCfg = cfg;
+            zoneCfgPending = true;
+            portEXIT_CRITICAL(&zoneMux);
+            preferences.putBytes("zones", &cfg, sizeof(cfg));
+            configChanged = true;
+            Serial.printf("Zones Configured: %d\n", cfg.count);
+        }
+        else
+        {
+            Serial.println("Zones Rejected (invalid pins or thresholds)");
+            rejectKey("zones");
+        }
+    }
 
-        // Configure to follow redirects (Important for GitHub)
-        httpUpdate.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+    if (settings.containsKey("max_valves"))
+    {
+        int val = settings["max_valves"];
+        if (val >= 1 && val <= MAX_ZONES)
+        {
+            if (MAX_ACTIVE_VALVES != val)
+            {
+                MAX_ACTIVE_VALVES = val;
+                configChanged = true;
+                preferences.putInt("max_valves", MAX_ACTIVE_VALVES);
+            }
+        }
+        else
+            rejectKey("max_valves");
+    }
 
-        t_httpUpdate_return ret = httpUpdate.update(otaClient, url);
+    if (settings.containsKey("sampling"))
+    {
+        // {"temp": {"min": 500, "max": 30000, "rate": 0.02, "std": 0.15}, ...}
+        // Missing channels and fields keep their current values.
+        JsonObjectConst sm = settings["sampling"];
+        ChannelLimits lim[CH_COUNT];
+        portENTER_CRITICAL(&samplingMux);
+        memcpy(lim, sampleLimits, sizeof(lim));
+        portEXIT_CRITICAL(&samplingMux);
 
-        switch (ret)
+        bool ok = true;
+        for (int ch = 0; ch < CH_COUNT; ch++)
         {
-        case HTTP_UPDATE_FAILED:
-            Serial.printf("HTTP_UPDATE_FAILED Error (%d): %s\n", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
-            // Re-enable WDT for this task
-            esp_task_wdt_add(NULL);
-            break;
-        case HTTP_UPDATE_NO_UPDATES:
-            Serial.println("HTTP_UPDATE_NO_UPDATES");
-            break;
-        case HTTP_UPDATE_OK:
-            Serial.println("HTTP_UPDATE_OK");
-            break;
+            JsonObjectConst c = sm[SAMPLE_CHANNEL_KEYS[ch]];
+            if (c.isNull())
+                continue;
+            lim[ch].minMs = c["min"] | lim[ch].minMs;
+            lim[ch].maxMs = c["max"] | lim[ch].maxMs;
+            lim[ch].rate = c["rate"] | lim[ch].rate;
+            lim[ch].stdDev = c["std"] | lim[ch].stdDev;
+            if (lim[ch].minMs < 100 || lim[ch].maxMs < lim[ch].minMs || lim[ch].maxMs > 3600000 ||
+                !(lim[ch].rate > 0) || !(lim[ch].stdDev > 0))
+                ok = false;
+        }
+        if (ok && memcmp(lim, sampleLimits, sizeof(lim)) != 0)
+        {
+            portENTER_CRITICAL(&samplingMux);
+            memcpy(sampleLimits, lim, sizeof(lim));
+            portEXIT_CRITICAL(&samplingMux);
+            preferences.putBytes("sampling", lim, sizeof(lim));
+            configChanged = true;
+            Serial.println("Sampling Limits Updated");
+        }
+        else if (!ok)
+        {
+            Serial.println("Sampling Rejected (need 100 <= min <= max <= 3600000, rate > 0, std > 0)");
+            rejectKey("sampling");
         }
     }
 
-    free(jsonStr); // FIX: Free memory
-}
+    if (settings.containsKey("governor"))
+    {
+        // {"fan": {"band": 0.5, "min_on": 30, "min_off": 30, "max_cycles": 12}, ...} (seconds);
+        // missing actuators and fields keep their current values
+        JsonObjectConst gv = settings["governor"];
+        GovernorLimits lim[ACT_COUNT];
+        portENTER_CRITICAL(&governorMux);
+        memcpy(lim, govLimits, sizeof(lim));
+        portEXIT_CRITICAL(&governorMux);
 
-// --- INTERRUPT SERVICE ROUTINE (ISR) ---
-void IRAM_ATTR isrResetButton()
-{
-    static unsigned long last_interrupt_time = 0;
-    unsigned long interrupt_time = millis();
+        bool ok = true;
+        for (int a = 0; a < ACT_COUNT; a++)
+        {
+            JsonObjectConst g = gv[ACTUATOR_NAMES[a]];
+            if (g.isNull())
+                continue;
+            float band = g["band"] | lim[a].band;
+            long minOn = g["min_on"] | (long)(lim[a].minOnMs / 1000);
+            long minOff = g["min_off"] | (long)(lim[a].minOffMs / 1000);
+            int maxCycles = g["max_cycles"] | (int)lim[a].maxCycles;
+            if (!(band >= 0 && band <= 10) || minOn < 0 || minOn > 3600 || minOff < 0 || minOff > 3600 ||
+                maxCycles < 0 || maxCycles > GOVERNOR_MAX_CYCLES)
+            {
+                ok = false;
+                continue;
+            }
+            lim[a].band = band;
+            lim[a].minOnMs = minOn * 1000;
+            lim[a].minOffMs = minOff * 1000;
+            lim[a].maxCycles = maxCycles;
+        }
+        if (ok && memcmp(lim, govLimits, sizeof(lim)) != 0)
+        {
+            portENTER_CRITICAL(&governorMux);
+            memcpy(govLimits, lim, sizeof(lim));
+            portEXIT_CRITICAL(&governorMux);
+            preferences.putBytes("governor", lim, sizeof(lim));
+            configChanged = true;
+            Serial.println("Governor Limits Updated");
+        }
+        else if (!ok)
+        {
+            Serial.println("Governor Rejected (need band 0-10, min_on/min_off 0-3600 s, max_cycles 0-60)");
+            rejectKey("governor");
+        }
+    }
+
+    if (settings.containsKey("lan_broker"))
+    {
+        // {"host": "192.168.1.10", "port": 1883, "mode": "fallback", "failover_ms": 30000,
+        //  "user": "", "pass": ""}; missing fields keep their current values
+        JsonObjectConst lb = settings["lan_broker"];
+        LanBrokerConfig cfg = lanCfg;
+        const char *host = lb["host"] | cfg.host;
+        const char *user = lb["user"] | cfg.user;
+        const char *pass = lb["pass"] | cfg.pass;
+        const char *mode = lb["mode"] | LAN_MODE_NAMES[cfg.mode];
+        int port = lb["port"] | (int)cfg.port;
+        cfg.failoverMs = lb["failover_ms"] | cfg.failoverMs;
+
+        bool ok = strlen(host) < sizeof(cfg.host) && strlen(user) < sizeof(cfg.user) &&
+                  strlen(pass) < sizeof(cfg.pass) && port >= 1 && port <= 65535 && cfg.failoverMs <= 3600000;
+        int m = -1;
+        for (int i = 0; i <= LAN_ALWAYS; i++)
+        {
+            if (strcmp(mode, LAN_MODE_NAMES[i]) == 0)
+                m = i;
+        }
+        if (m < 0 || (m != LAN_OFF && host[0] == 0))
+            ok = false;
+        if (ok)
+        {
+            memmove(cfg.host, host, strlen(host) + 1);
+            memmove(cfg.user, user, strlen(user) + 1);
+            memmove(cfg.pass, pass, strlen(pass) + 1);
+            cfg.port = port;
+            cfg.mode = m;
+        }
+        if (ok && memcmp(&cfg, &lanCfg, sizeof(cfg)) != 0)
+        {
+            lanCfg = cfg;
+            lanClient.disconnect(); // Reconnect with the new settings
+            preferences.putBytes("lan_broker", &lanCfg, sizeof(lanCfg));
+            configChanged = true;
+            Serial.printf("LAN Broker: %s %s:%u\n", LAN_MODE_NAMES[lanCfg.mode], lanCfg.host, lanCfg.port);
+        }
+        else if (!ok)
+        {
+            Serial.println("LAN Broker Rejected (need host, port 1-65535, mode off|fallback|always)");
+            rejectKey("lan_broker");
+        }
+    }
+
+    if (settings.containsKey("rules"))
+    {
+        // Base64 bytecode from the backend rule compiler (null = remove all rules)
+        static uint8_t program[RULE_MAX_CODE];
+        const char *b64 = settings["rules"];
+        size_t len = 0;
+        bool ok = true;
+        if (b64)
+            ok = mbedtls_base64_decode(program, sizeof(program), &len, (const unsigned char *)b64, strlen(b64)) == 0;
+
+        xSemaphoreTake(rulesMutex, portMAX_DELAY);
+        if (!b64)
+            ruleVM.clear();
+        else if (ok)
+            ok = ruleVM.load(program, len);
+        xSemaphoreGive(rulesMutex);
+
+        if (ok)
+        {
+            if (b64)
+                preferences.putBytes("rules", program, len);
+            else
+                preferences.remove("rules");
+            configChanged = true;
+            Serial.printf("Rules Loaded: %d rules, %d bytes\n", ruleVM.ruleCount(), (int)len);
+        }
+        else
+        {
+            Serial.println("Rules Rejected (invalid bytecode)");
+            rejectKey("rules");
+        }
+    }
+
+    if (configChanged)
+    {
+        Serial.println("Configuration Updated & Saved!");
+        shadowReportPending = true;
+    }
+    if (shadow)
+    {
+        // Control commands only come on the command topic
+        shadowApplying = false;
+        shadowMidVersion = more;
+        if (more)
+            return;
+        if (shadowRejected[0])
+        {
+            Serial.printf("Shadow v%lu Not Applied, Rejected: %s\n", (unsigned long)version, shadowRejected);
+        }
+        else
+        {
+            shadowVersion = version;
+            preferences.putULong("shadow_ver", shadowVersion);
+            Serial.printf("Shadow v%lu Applied\n", (unsigned long)shadowVersion);
+        }
+        shadowReportPending = true;
+        return;
+    }
+
+    // 3. Control Commands (Manual Mode)
+    if (doc.containsKey("mode"))
+    {
+        // Accept "MANUAL"/"AUTO" strings or 1/0
+        const char *m = doc["mode"].is<const char *>() ? doc["mode"].as<const char *>() : (doc["mode"].as<int>() ? "1" : "0");
+        if (strcasecmp(m, "MANUAL") == 0 || strcmp(m, "1") == 0)
+        {
+            manualMode = true;
+        }
+        else if (strcasecmp(m, "AUTO") == 0 || strcmp(m, "0") == 0)
+        {
+            manualMode = false;
+            manualPump = false;
+            manualFan = false;
+            manualHeater = false;
+        }
+        Serial.print("Mode set to: ");
+        Serial.println(manualMode ? "MANUAL" : "AUTO");
+    }
+
+    if (doc.containsKey("pump"))
+    {
+        if (manualMode)
+        {
+            int val = doc["pump"]; // 0 or 1
+            manualPump = (val == 1);
+            Serial.print("Manual Pump: ");
+            Serial.println(manualPump ? "ON" : "OFF");
+        }
+    }
+    if (doc.containsKey("fan"))
+    {
+        if (manualMode)
+        {
+            int val = doc["fan"];
+            manualFan = (val == 1);
+            Serial.print("Manual Fan: ");
+            Serial.println(manualFan ? "ON" : "OFF");
+        }
+    }
+    if (doc.containsKey("heater"))
+    {
+        if (manualMode)
+        {
+            int val = doc["heater"];
+            manualHeater = (val == 1);
+            Serial.print("Manual Heater: ");
+            Serial.println(manualHeater ? "ON" : "OFF");
+        }
+    }
+
+    // Switch now rather than at the next control tick; the ack follows
+    if (doc.containsKey("mode") || doc.containsKey("pump") || doc.containsKey("fan") || doc.containsKey("heater"))
+    {
+        // The id is echoed into JSON: keep it to plain token characters
+        CommandAck cmd = {};
+        const char *id = doc["id"] | "";
+        size_t n = 0;
+        for (; *id && n < sizeof(cmd.id) - 1; id++)
+        {
+            if (isalnum((unsigned char)*id) || *id == '-' || *id == '_')
+                cmd.id[n++] = *id;
+        }
+        cmd.rxUs = rxUs;
+        if (commandQueue.push(cmd) && tasks[TASK_CONTROL].handle)
+            xTaskNotifyGive(tasks[TASK_CONTROL].handle);
+    }
+
+    // Check for OTA Update
+    if (doc.containsKey("update_url"))
+    {
+        const char *url = doc["update_url"];
+        Serial.println("OTA Update Requested...");
+        Serial.println(url);
+
+        // Stay on the watchdog: every downloaded chunk counts as a heartbeat
+        httpUpdate.onProgress([](int cur, int total)
+                              {
+                                  esp_task_wdt_reset();
+                                  heartbeat(TASK_AWS);
+                              });
+
+        // Use a separate client for OTA to avoid messing up AWS certs
+        WiFiClientSecure otaClient;
+        otaClient.setInsecure(); // Allow any HTTPS server (GitHub, S3, etc.)
+
+        // Configure to follow redirects (Important for GitHub)
+        httpUpdate.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+
+        t_httpUpdate_return ret = httpUpdate.update(otaClient, url);
+
+        switch (ret)
+        {
+        case HTTP_UPDATE_FAILED:
+            Serial.printf("HTTP_UPDATE_FAILED Error (%d): %s\n", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
+            break;
+        case HTTP_UPDATE_NO_UPDATES:
+            Serial.println("HTTP_UPDATE_NO_UPDATES");
+            break;
+        case HTTP_UPDATE_OK:
+            Serial.println("HTTP_UPDATE_OK");
+            break;
+        }
+    }
+}
+
+// --- TASK MANAGEMENT ---
+TaskHandle_t startTask(TaskId id, TaskFunction_t fn, UBaseType_t priority, BaseType_t core)
+{
+    TaskSlot &t = tasks[id];
+    t.minFree = t.stackSize;
+    t.canaryOk = true;
+    t.fn = fn;
+    t.priority = priority;
+    t.core = core;
+    t.stopRequest = false;
+    t.parked = false;
+    t.handle = xTaskCreateStaticPinnedToCore(fn, t.name, t.stackSize, NULL, priority, t.stack, &t.tcb, core);
+    return t.handle;
+}
+
+// Refreshes high-water marks and checks the canary at the far end of each
+// stack (stacks grow down, so stack[0] is the last byte a task can reach).
+// Returns false if any canary was overwritten.
+bool updateStackStats()
+{
+    bool allOk = true;
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        TaskSlot &t = tasks[i];
+        if (!t.handle)
+            continue;
+        uint32_t freeBytes = uxTaskGetStackHighWaterMark(t.handle);
+        if (freeBytes < t.minFree)
+            t.minFree = freeBytes;
+        for (int b = 0; b < STACK_CANARY_BYTES; b++)
+        {
+            if (t.stack[b] != STACK_FILL_BYTE)
+            {
+                t.canaryOk = false;
+                break;
+            }
+        }
+        allOk &= t.canaryOk;
+    }
+    return allOk;
+}
+
+#if STACK_PROFILING
+// Peak usage plus 25% margin, rounded up to 256 B
+void printStackReport()
+{
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        TaskSlot &t = tasks[i];
+        uint32_t peak = t.stackSize - t.minFree;
+        uint32_t recommended = ((peak * 5 / 4) + 255) & ~255u;
+        Serial.printf("Stack %-8s peak %5lu / %5lu B, recommended %5lu B%s\n", t.name, (unsigned long)peak,
+                      (unsigned long)t.stackSize, (unsigned long)recommended, t.canaryOk ? "" : " CANARY HIT");
+    }
+}
+#endif
+
+// --- POWER MANAGEMENT ---
+// 240 MHz only while a PM lock is held (TLS), 80 MHz otherwise, and light
+// sleep whenever every task is blocked. Light sleep needs tickless idle in the
+// SDK config; without it esp_pm_configure() rejects the request and we keep
+// frequency scaling alone.
+void powerInit()
+{
+#if POWER_SAVE
+    esp_pm_config_esp32_t pm = {240, 80, true};
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err == ESP_OK)
+        pmMode = 2;
+    else
+    {
+        pm.light_sleep_enable = false;
+        err = esp_pm_configure(&pm);
+        pmMode = (err == ESP_OK) ? 1 : 0;
+    }
+    if (pmMode)
+    {
+        // I2C and ADC timing depend on the APB clock; TLS wants full speed
+        esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "i2c", &pmI2c.handle);
+        esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "adc", &pmAdc.handle);
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "tls", &pmTls.handle);
+    }
+    Serial.printf("Power Management: %s\n", pmMode == 2 ? "DFS + Light Sleep" : pmMode == 1 ? "DFS" : "Off");
+#endif
+}
+
+void pmAcquire(PmLock &l)
+{
+    if (l.handle)
+        esp_pm_lock_acquire(l.handle);
+    l.since = micros();
+    l.holder = xTaskGetCurrentTaskHandle();
+}
+
+void pmRelease(PmLock &l)
+{
+    l.heldUs += micros() - l.since;
+    l.holder = NULL;
+    if (l.handle)
+        esp_pm_lock_release(l.handle);
+}
+
+// Bus access for sensors and LCD: mutex plus the APB clock lock
+void i2cAcquire()
+{
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    pmAcquire(pmI2c);
+}
+
+void i2cRelease()
+{
+    pmRelease(pmI2c);
+    xSemaphoreGive(i2cMutex);
+}
+
+// Average current since the previous call, from time spent under each clock
+// regime. A coarse model: good for comparing settings, not for billing.
+float estimateCurrentMa(uint16_t &wakes)
+{
+    static uint32_t lastUs = micros();
+    static uint32_t lastTls = 0, lastBus = 0, lastWakes = 0;
+    uint32_t now = micros();
+    uint32_t periodUs = now - lastUs;
+    uint32_t tls = pmTls.heldUs, bus = pmI2c.heldUs + pmAdc.heldUs, w = wakeCount.load();
+    uint32_t tlsUs = tls - lastTls, busUs = bus - lastBus;
+    wakes = (w - lastWakes > UINT16_MAX) ? UINT16_MAX : (uint16_t)(w - lastWakes);
+    lastUs = now;
+    lastTls = tls;
+    lastBus = bus;
+    lastWakes = w;
+    if (periodUs == 0)
+        return 0;
+
+    float wifiMa = WiFi.status() != WL_CONNECTED ? 0 : pmMode ? PM_MA_WIFI_MODEM : PM_MA_WIFI_ACTIVE;
+    if (!pmMode)
+        return PM_MA_240 + wifiMa;
+
+    float activeUs = busUs + (float)wakes * PM_WAKE_ACTIVE_US;
+    if (tlsUs + activeUs > periodUs)
+        activeUs = periodUs - tlsUs;
+    float idleUs = periodUs - tlsUs - activeUs;
+    float idleMa = pmMode == 2 ? PM_MA_LIGHT_SLEEP : PM_MA_IDLE_80;
+    return (tlsUs * PM_MA_240 + activeUs * PM_MA_80 + idleUs * idleMa) / periodUs + wifiMa;
+}
+
+// --- INTERRUPT SERVICE ROUTINE (ISR) ---
+void IRAM_ATTR isrResetButton()
+{
+    static unsigned long last_interrupt_time = 0;
+    unsigned long interrupt_time = millis();
     // Debounce: 200ms
     if (interrupt_time - last_interrupt_time > 200)
     {
@@ -358,34 +1581,29 @@ void IRAM_ATTR isrResetButton()
 // ==========================================
 void setup()
 {
+    // 0. Relays off before anything else: a reset mid-cycle must not leave
+    //    the pump or heater running while the rest of the system comes up.
+    pinMode(PIN_PUMP, OUTPUT);
+    digitalWrite(PIN_PUMP, LOW);
+    pinMode(PIN_FAN, OUTPUT);
+    digitalWrite(PIN_FAN, LOW);
+    pinMode(PIN_HEATER, OUTPUT);
+    digitalWrite(PIN_HEATER, LOW);
+
     Serial.begin(115200);
     Serial.println(FIRMWARE_VERSION);
+    powerInit();
 
-    // 0. Generate Unique Device ID
+    // 1. Generate Unique Device ID
     uint64_t chipid = ESP.getEfuseMac();
     snprintf(deviceId, 20, "GH-%04X%08X", (uint16_t)(chipid >> 32), (uint32_t)chipid);
     Serial.print("Device ID: ");
     Serial.println(deviceId);
 
-    // 1. Initialize Hardware (LCD, I2C, Pins)
-    Wire.begin(21, 22);
+    // The bus is shared; the LCD and sensors are initialised by their own tasks
+    Wire.begin(PIN_SDA, PIN_SCL);
     Wire.setTimeOut(3000); // FIX: Prevent I2C lockups
-    lcd.init();
-    lcd.backlight();
-    lcd.setCursor(0, 0);
-    lcd.print("Smart GreenHouse");
-    lcd.setCursor(0, 1);
-    lcd.print(deviceId); // Show ID on boot
-    delay(2000);         // Let user see the ID
-    lcd.setCursor(0, 1);
-    lcd.print("System Starting...");
-
-    pinMode(PIN_PUMP, OUTPUT);
-    digitalWrite(PIN_PUMP, LOW);
-    pinMode(PIN_FAN, OUTPUT);
-    digitalWrite(PIN_FAN, LOW);
-    pinMode(PIN_HEATER, OUTPUT);
-    digitalWrite(PIN_HEATER, LOW);
+    i2cMutex = xSemaphoreCreateMutex();
     pinMode(PIN_RESET_BTN, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(PIN_RESET_BTN), isrResetButton, FALLING);
 
@@ -423,72 +1641,99 @@ void setup()
     TANK_FULL_DIST = preferences.getInt("tank_full", 5);
     AIR_VAL = preferences.getInt("cal_air", 4095);
     WATER_VAL = preferences.getInt("cal_water", 1670);
-    Serial.println("Config Loaded from NVS");
-
-    // 3. Initialize File System
-    if (!LittleFS.begin(true))
+    PULSE_SOAK_MODE = preferences.getBool("irr_pulse", true);
+    PULSE_ON_SEC = preferences.getInt("pulse_on", 20);
+    SOAK_SEC = preferences.getInt("soak_sec", 120);
+    PUMP_FLOW_MLPM = preferences.getInt("pump_flow", 1500);
+    FAN_WATTS = preferences.getInt("fan_w", 40);
+    HEATER_WATTS = preferences.getInt("heater_w", 500);
+    TZ_OFFSET_MIN = preferences.getInt("tz_offset", 330);
+    MAX_ACTIVE_VALVES = preferences.getInt("max_valves", 1);
+    if (preferences.getBytesLength("zones") == sizeof(ZoneConfig))
     {
-        Serial.println("LittleFS Mount Failed");
+        preferences.getBytes("zones", &zoneCfg, sizeof(ZoneConfig));
+        if (!zoneConfigValid(zoneCfg))
+            zoneCfg = {1, {PIN_SOIL}, {-1}, {0}, {0}};
     }
-    else
+    if (preferences.getBytesLength("sampling") == sizeof(sampleLimits))
+        preferences.getBytes("sampling", sampleLimits, sizeof(sampleLimits));
+    if (preferences.getBytesLength("governor") == sizeof(govLimits))
+        preferences.getBytes("governor", govLimits, sizeof(govLimits));
+    uint32_t switches[ACT_COUNT];
+    if (preferences.getBytes("act_switches", switches, sizeof(switches)) == sizeof(switches))
     {
-        Serial.println("LittleFS Mounted");
-
-        // --- DEBUG: PRINT OFFLINE LOGS ---
-        if (LittleFS.exists("/offline_log.txt"))
-        {
-            Serial.println("--- FOUND OFFLINE LOGS ---");
-            File f = LittleFS.open("/offline_log.txt", "r");
-            while (f.available())
-                Serial.write(f.read());
-            f.close();
-            Serial.println("\n--- END LOGS ---");
-        }
-        if (LittleFS.exists("/processing.txt"))
+        for (int i = 0; i < ACT_COUNT; i++)
+            actuatorSwitches[i] = switches[i];
+    }
+    if (preferences.getBytesLength("lan_broker") == sizeof(lanCfg))
+    {
+        preferences.getBytes("lan_broker", &lanCfg, sizeof(lanCfg));
+        if (lanCfg.mode > LAN_ALWAYS)
+            lanCfg.mode = LAN_OFF;
+    }
+    for (int i = 0; i < zoneCfg.count; i++)
+    {
+        if (zoneCfg.valvePin[i] >= 0)
         {
-            Serial.println("--- FOUND PROCESSING LOGS ---");
-            File f = LittleFS.open("/processing.txt", "r");
-            while (f.available())
-                Serial.write(f.read());
-            f.close();
-            Serial.println("\n--- END LOGS ---");
+            pinMode(zoneCfg.valvePin[i], OUTPUT);
+            digitalWrite(zoneCfg.valvePin[i], LOW);
         }
     }
 
-    // 4. Initialize Sensors
-    bool sensorsOk = true;
-    if (!aht.begin())
+    scheduleMutex = xSemaphoreCreateMutex();
+    if (preferences.getBytesLength("schedule") == sizeof(schedule.data))
     {
-        Serial.println("AHT Error");
-        sensorsOk = false;
+        preferences.getBytes("schedule", &schedule.data, sizeof(schedule.data));
+        if (!schedule.rebuild())
+            Serial.println("Stored Schedule Invalid, Using Fixed Thresholds");
     }
-    if (!ens160.begin())
+    rulesMutex = xSemaphoreCreateMutex();
+    size_t rulesLen = preferences.getBytesLength("rules");
+    if (rulesLen > 0 && rulesLen <= RULE_MAX_CODE)
     {
-        Serial.println("ENS Error");
-        sensorsOk = false;
+        static uint8_t program[RULE_MAX_CODE];
+        preferences.getBytes("rules", program, rulesLen);
+        if (!ruleVM.load(program, rulesLen))
+            Serial.println("Stored Rules Invalid, Ignoring");
     }
-    else
-        ens160.setMode(ENS160_OPMODE_STD);
 
-    if (!sensorsOk)
+    lastKnownEpoch = preferences.getULong("last_epoch", 0);
+    lastKnownEpochAt = millis();
+    shadowVersion = preferences.getULong("shadow_ver", 0);
+
+    bootId = preferences.getULong("boot_id", 0) + 1;
+    preferences.putULong("boot_id", bootId);
+    if (preferences.getBytesLength("boots") != sizeof(bootHistory) ||
+        preferences.getBytes("boots", &bootHistory, sizeof(bootHistory)) != sizeof(bootHistory) ||
+        bootHistory.count > BOOT_HISTORY)
+        bootHistory.count = 0;
+    if (bootHistory.count == BOOT_HISTORY)
     {
-        lcd.setCursor(0, 1);
-        lcd.print("Sensor Failure!");
-        delay(2000);
+        memmove(&bootHistory.boots[0], &bootHistory.boots[1], sizeof(BootInfo) * (BOOT_HISTORY - 1));
+        bootHistory.count--;
     }
+    bootHistory.boots[bootHistory.count++] = {bootId, 0, 0};
+    preferences.putBytes("boots", &bootHistory, sizeof(bootHistory));
+    Serial.printf("Boot ID: %lu\n", (unsigned long)bootId);
+    Serial.println("Config Loaded from NVS");
 
-    // Initialize Watchdog (30s timeout)
-    esp_task_wdt_init(30, true);
-    
+    // Initialize Watchdog. Stalls are handled by the supervisor first; the
+    // panic only fires if recovery itself gets stuck.
+    esp_task_wdt_init(WDT_TIMEOUT_S, true);
 
-    // 4. Create RTOS Tasks
+    // 3. Create RTOS Tasks (static stacks, see TASK STACKS). Control starts
+    //    first; LCD, sensors, flash and WiFi/TLS then come up in parallel
+    //    inside their own tasks instead of one after another here.
     // Core 1 (Application Logic)
-    xTaskCreatePinnedToCore(TaskReadSensors, "Sensors", 4096, NULL, 1, NULL, 1);
-    xTaskCreatePinnedToCore(TaskControlSystem, "Control", 4096, NULL, 2, NULL, 1);
-    xTaskCreatePinnedToCore(TaskInterface, "UI", 4096, NULL, 1, NULL, 1);
+    startTask(TASK_CONTROL, TaskControlSystem, 2, 1);
+    startTask(TASK_SUPERVISOR, TaskSupervisor, 3, 1); // Above the tasks it watches
+    startTask(TASK_SENSORS, TaskReadSensors, 1, 1);
+    startTask(TASK_UI, TaskInterface, 1, 1);
+    startTask(TASK_SAMPLER, TaskSampler, 2, 1);
 
     // Core 0 (WiFi/SSL/Radio)
-    xTaskCreatePinnedToCore(TaskConnectivity, "AWS", 10240, NULL, 1, NULL, 0);
+    startTask(TASK_AWS, TaskConnectivity, 1, 0);
+    markBoot(BP_TASKS);
 }
 
 void loop()
@@ -503,52 +1748,775 @@ void loop()
 // ==========================================
 
 // --- TASK 1: SENSOR READING ---
+int readSoilMoisture(int pin)
+{
+    // Soil Moisture Mapping (for ESP32 12-bit)
+    pmAcquire(pmAdc);
+    int rawADC = analogRead(pin);
+    pmRelease(pmAdc);
+    rawADC = constrain(rawADC, WATER_VAL, AIR_VAL);
+    // Map inverted: High Raw = Dry(0%), Low Raw = Wet(100%)
+    // If sensor logic is reversed, swap 0 and 100 below
+    return map(rawADC, AIR_VAL, WATER_VAL, 0, 100);
+}
+
 void TaskReadSensors(void *pvParameters)
 {
     esp_task_wdt_add(NULL); // Add this task to WDT watch list
+    unsigned long nextAirRead = millis();
+    unsigned long nextSoilRead = millis();
+    AdaptiveRate tempRate, humRate, co2Rate;
+    AdaptiveRate soilRate[MAX_ZONES]; // Soil period follows the busiest zone
+    ChannelLimits lim[CH_COUNT];
+#if SENSOR_ASYNC
+    unsigned long nextGasRead = millis();
+    unsigned long ahtReadyAt = 0;
+    uint32_t ahtTriggerUs = 0;
+#endif
+
+    // Chip init (reset, calibration, op mode) runs here, in parallel with the
+    // LCD and WiFi coming up, rather than in setup().
+    i2cAcquire();
+    bool ahtOk = aht.begin();
+    bool ensOk = ens160.begin();
+    if (ensOk)
+        ens160.setMode(ENS160_OPMODE_STD);
+    i2cRelease();
+    if (!ahtOk)
+        Serial.println("AHT Error");
+    if (!ensOk)
+        Serial.println("ENS Error");
+    sensorInitOk = ahtOk && ensOk;
+    bool airDone = !ahtOk; // First air reading attempted (or no sensor to wait for)
+    bool soilDone = false;
+
     for (;;)
     {
         esp_task_wdt_reset(); // Feed the watchdog
-        // AHT21 Reading
-        sensors_event_t humidity, temp;
-        aht.getEvent(&humidity, &temp);
-        currentTemp = temp.temperature;
-        currentHum = humidity.relative_humidity;
+        heartbeat(TASK_SENSORS);
+        taskSafePoint(TASK_SENSORS);
+        wakeCount++;
+        unsigned long now = millis();
+
+        portENTER_CRITICAL(&samplingMux);
+        memcpy(lim, sampleLimits, sizeof(lim));
+        portEXIT_CRITICAL(&samplingMux);
 
-        // ENS160 Reading
-        if (ens160.available())
+#if SENSOR_ASYNC
+        // 1. Start an AHT21 acquisition. It converts while the task sleeps.
+        if (!ahtDrv.pending() && (long)(now - nextAirRead) >= 0)
         {
-            ens160.measure(true);
-            ens160.measureRaw(true);
-            eco2 = ens160.geteCO2();
-            tvoc = ens160.getTVOC();
+            // Retry at the current rate if the read fails; a good read reschedules
+            uint32_t pt = tempRate.periodMs ? tempRate.periodMs : lim[CH_TEMP].minMs;
+            uint32_t ph = humRate.periodMs ? humRate.periodMs : lim[CH_HUM].minMs;
+            nextAirRead = now + (pt < ph ? pt : ph);
+            i2cAcquire();
+            uint32_t t0 = micros();
+            if (!ahtDrv.trigger())
+                airDone = true; // No answer: don't hold up control for it
+            ahtTriggerUs = micros() - t0;
+            i2cRelease();
+            ahtReadyAt = now + AHT21_CONVERSION_MS;
         }
 
-        // Soil Moisture Mapping (for ESP32 12-bit)
-        int rawADC = analogRead(PIN_SOIL);
-        rawADC = constrain(rawADC, WATER_VAL, AIR_VAL);
-        // Map inverted: High Raw = Dry(0%), Low Raw = Wet(100%)
-        // If sensor logic is reversed, swap 0 and 100 below
-        soilMoisture = map(rawADC, AIR_VAL, WATER_VAL, 0, 100);
+        // 2. AHT21 conversion time has passed: fetch the result
+        if (ahtDrv.pending() && (long)(now - ahtReadyAt) >= 0)
+        {
+            i2cAcquire();
+            uint32_t t0 = micros();
+            bool ok = ahtDrv.read();
+            uint32_t readUs = micros() - t0;
+            i2cRelease();
 
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
-    }
-}
+            ahtAcqUs = ahtTriggerUs + readUs;
+            if (ok)
+            {
+                currentTemp = ahtDrv.temperature;
+                currentHum = ahtDrv.humidity;
+                // One chip serves both channels: sample at the faster of the two
+                uint32_t pt = tempRate.update(ahtDrv.temperature, now, lim[CH_TEMP]);
+                uint32_t ph = humRate.update(ahtDrv.humidity, now, lim[CH_HUM]);
+                nextAirRead = now + (pt < ph ? pt : ph);
+            }
+            else if (ahtDrv.pending())
+            {
+                ahtReadyAt = now + 10; // Still busy, check again shortly
+            }
+            if (!ahtDrv.pending())
+                airDone = true;
+        }
 
-// --- TASK 2: INTELLIGENT CONTROL ---
-void TaskControlSystem(void *pvParameters)
-{
-    esp_task_wdt_add(NULL); // Add to WDT
-    pinMode(PIN_TRIG, OUTPUT);
-    pinMode(PIN_ECHO, INPUT);
+        // 3. ENS160 on its own schedule (eCO2 moves on a different time scale)
+        if ((long)(now - nextGasRead) >= 0)
+        {
+            i2cAcquire();
+            uint32_t t0 = micros();
+            bool ensNew = ensDrv.poll();
+            ensAcqUs = micros() - t0;
+            i2cRelease();
 
-    // Tank dimensions (adjust these for tank)
-    // const int TANK_EMPTY_DIST = 25;  // Distance when tank is empty (cm) - MOVED TO GLOBAL
-    // const int TANK_FULL_DIST = 5;    // Distance when tank is full (cm) - MOVED TO GLOBAL
+            if (ensNew)
+            {
+                eco2 = ensDrv.eco2;
+                tvoc = ensDrv.tvoc;
+                nextGasRead = now + co2Rate.update(ensDrv.eco2, now, lim[CH_CO2]);
+            }
+            else
+            {
+                nextGasRead = now + ENS_RETRY_MS; // No new sample yet
+            }
+        }
+#else
+        // Legacy blocking reads (kept to measure the difference)
+        if ((long)(now - nextAirRead) >= 0)
+        {
+            i2cAcquire();
 
-    for (;;)
+            // AHT21 Reading
+            uint32_t t0 = micros();
+            sensors_event_t humidity, temp;
+            aht.getEvent(&humidity, &temp);
+            currentTemp = temp.temperature;
+            currentHum = humidity.relative_humidity;
+            ahtAcqUs = micros() - t0;
+            airDone = true;
+
+            // ENS160 Reading
+            t0 = micros();
+            bool ensNew = ens160.available();
+            if (ensNew)
+            {
+                ens160.measure(true);
+                ens160.measureRaw(true);
+                eco2 = ens160.geteCO2();
+                tvoc = ens160.getTVOC();
+            }
+            ensAcqUs = micros() - t0;
+            i2cRelease();
+
+            // Both chips are read together here: use the fastest channel
+            uint32_t pt = tempRate.update(temp.temperature, now, lim[CH_TEMP]);
+            uint32_t ph = humRate.update(humidity.relative_humidity, now, lim[CH_HUM]);
+            uint32_t period = pt < ph ? pt : ph;
+            if (ensNew)
+                co2Rate.update(eco2, now, lim[CH_CO2]);
+            if (co2Rate.periodMs && co2Rate.periodMs < period)
+                period = co2Rate.periodMs;
+            nextAirRead = now + period;
+        }
+#endif
+
+        // 4. Soil. While the pump runs, soil changes quickly: sample it at a high
+        //    rate so the control loop can stop the pulse as soon as it is wet.
+        if (pumpStatus && (long)(nextSoilRead - now) > SOIL_FAST_MS)
+            nextSoilRead = now;
+        if ((long)(now - nextSoilRead) >= 0)
+        {
+            // All zones share the calibration; zone 0 is also the legacy "soil" value
+            ZoneConfig cfg = zoneConfigSnapshot();
+            uint32_t period = lim[CH_SOIL].maxMs;
+            for (int i = 0; i < cfg.count; i++)
+            {
+                zoneMoisture[i] = readSoilMoisture(cfg.soilPin[i]);
+                uint32_t p = soilRate[i].update(zoneMoisture[i], now, lim[CH_SOIL]);
+                if (p < period)
+                    period = p;
+            }
+            soilMoisture = zoneMoisture[0];
+            soilDone = true;
+            nextSoilRead = now + (pumpStatus ? SOIL_FAST_MS : period);
+            samplePeriodMs[CH_SOIL] = pumpStatus ? SOIL_FAST_MS : period;
+        }
+        if (!sensorsReady && airDone && soilDone)
+        {
+            sensorsReady = true;
+            markBoot(BP_SENSORS);
+        }
+        samplePeriodMs[CH_TEMP] = tempRate.periodMs;
+        samplePeriodMs[CH_HUM] = humRate.periodMs;
+        samplePeriodMs[CH_CO2] = co2Rate.periodMs;
+
+        // 5. Sleep until the next deadline
+        unsigned long wake = nextSoilRead;
+#if SENSOR_ASYNC
+        unsigned long airDue = ahtDrv.pending() ? ahtReadyAt : nextAirRead;
+        if ((long)(nextGasRead - wake) < 0)
+            wake = nextGasRead;
+#else
+        unsigned long airDue = nextAirRead;
+#endif
+        if ((long)(airDue - wake) < 0)
+            wake = airDue;
+        long wait = (long)(wake - millis());
+        if (wait > SENSOR_MAX_SLEEP_MS)
+            wait = SENSOR_MAX_SLEEP_MS;
+        vTaskDelay((wait > 0 ? wait : 1) / portTICK_PERIOD_MS);
+    }
+}
+
+// --- SETPOINT EVALUATION ---
+// Wall time for the scheduler. Uses NTP when synced; otherwise estimates from
+// the last time persisted to NVS plus uptime (off by the length of any power
+// cut, but keeps day/night roughly right until NTP returns).
+uint32_t currentEpoch(uint8_t &source)
+{
+    time_t now = time(nullptr);
+    if (now > (time_t)EPOCH_VALID)
+    {
+        source = 2;
+        return (uint32_t)now;
+    }
+    if (lastKnownEpoch > EPOCH_VALID)
+    {
+        source = 1;
+        return lastKnownEpoch + (millis() - lastKnownEpochAt) / 1000;
+    }
+    source = 0;
+    return 0;
+}
+
+// --- TIMESTAMP REPAIR ---
+// Called once per boot at the first NTP sync
+void anchorBootClock(uint32_t nowEpoch)
+{
+    BootInfo &cur = bootHistory.boots[bootHistory.count - 1];
+    cur.startEpoch = nowEpoch - millis() / 1000;
+    preferences.putBytes("boots", &bootHistory, sizeof(bootHistory));
+    Serial.printf("Boot %lu anchored at %lu\n", (unsigned long)bootId, (unsigned long)cur.startEpoch);
+}
+
+// Remembers how long this boot has run with records on flash. A later boot
+// uses it to bound when this one started.
+void noteBootProgress(uint32_t monoMs)
+{
+    bootHistory.boots[bootHistory.count - 1].lastMonoMs = monoMs;
+    preferences.putBytes("boots", &bootHistory, sizeof(bootHistory));
+}
+
+// Converts a boot-relative record time to wall clock.
+//   src: 0 = no clock, 1 = estimated, 2 = NTP, 3 = rebased (see ts_err)
+//   err: uncertainty in seconds, -1 = no lower bound known
+// Returns false if the record cannot be rebased yet (no synced boot after it).
+//
+// Boot b started no later than the next boot's start minus b's known uptime,
+// and no earlier than the previous boot's start plus its known uptime. An
+// estimated (NVS + uptime) timestamp is also a lower bound: real time can only
+// have advanced further than the uptime counter since it was saved.
+bool rebaseTimestamp(uint32_t recBoot, uint32_t monoMs, uint8_t &src, uint32_t &ts, int32_t &err)
+{
+    if (src >= 2)
+        return true;
+    int k = -1;
+    for (int i = 0; i < bootHistory.count; i++)
+    {
+        if (bootHistory.boots[i].bootId == recBoot)
+            k = i;
+    }
+    if (k < 0)
+        return false;
+
+    uint32_t offset = monoMs / 1000;
+    if (bootHistory.boots[k].startEpoch)
+    {
+        ts = bootHistory.boots[k].startEpoch + offset;
+        err = 1 + (int32_t)((uint64_t)offset * CLOCK_DRIFT_PPM / 1000000);
+        src = 3;
+        return true;
+    }
+
+    // Upper bound: walk forward to the next synced boot
+    int64_t upper = 0;
+    int64_t used = 0;
+    for (int i = k; i < bootHistory.count; i++)
+    {
+        if (i > k && bootHistory.boots[i].startEpoch)
+        {
+            upper = (int64_t)bootHistory.boots[i].startEpoch - used + offset;
+            break;
+        }
+        used += bootHistory.boots[i].lastMonoMs / 1000;
+    }
+    if (!upper)
+        return false;
+
+    // Lower bound: walk back to the previous synced boot
+    int64_t lower = 0;
+    used = 0;
+    for (int i = k - 1; i >= 0; i--)
+    {
+        used += bootHistory.boots[i].lastMonoMs / 1000;
+        if (bootHistory.boots[i].startEpoch)
+        {
+            lower = (int64_t)bootHistory.boots[i].startEpoch + used + offset;
+            break;
+        }
+    }
+    if (src == 1 && ts > lower)
+        lower = ts;
+
+    if (!lower)
+    {
+        ts = (uint32_t)upper; // Assume the outage was short
+        err = -1;
+    }
+    else if (lower >= upper)
+    {
+        ts = (uint32_t)upper;
+        err = 1;
+    }
+    else
+    {
+        ts = (uint32_t)((lower + upper) / 2);
+        err = (int32_t)((upper - lower + 1) / 2) + 1;
+    }
+    src = 3;
+    return true;
+}
+
+volatile float localHour = -1; // Local time of day in hours (-1 = unknown)
+
+Setpoints computeSetpoints()
+{
+    Setpoints sp = {TEMP_MIN_NIGHT, TEMP_MAX_DAY, HUM_MAX, (float)SOIL_DRY, (float)SOIL_WET};
+    uint8_t source;
+    uint32_t epoch = currentEpoch(source);
+    clockSource = source;
+
+    xSemaphoreTake(scheduleMutex, portMAX_DELAY);
+    if (source == 0)
+    {
+        localHour = -1;
+        activeSegment = -1;
+        activeStage = -1;
+    }
+    else
+    {
+        uint16_t minuteOfDay = (uint16_t)(((int64_t)epoch / 60 + TZ_OFFSET_MIN + SCHED_MINUTES_PER_DAY) % SCHED_MINUTES_PER_DAY);
+        localHour = minuteOfDay / 60.0f;
+        if (schedule.enabled())
+        {
+            activeSegment = schedule.segmentAt(minuteOfDay);
+            sp = schedule.evaluate(minuteOfDay, epoch);
+        }
+        else
+        {
+            activeSegment = -1;
+            schedule.applyStage(sp, epoch);
+        }
+        activeStage = schedule.stageAt(epoch);
+    }
+    xSemaphoreGive(scheduleMutex);
+    return sp;
+}
+
+// --- ACTUATOR DRIVER ---
+// Edge-triggered: a relay GPIO is written only when its state changes, and
+// every change is queued as a timestamped event with its reason. Control task
+// only (manual commands reach it through commandQueue).
+const uint8_t ACTUATOR_PINS[ACT_COUNT] = {PIN_PUMP, PIN_FAN, PIN_HEATER};
+volatile bool *const ACTUATOR_STATE[ACT_COUNT] = {&pumpStatus, &fanStatus, &heaterStatus};
+SpscRing<ActuatorEvent, EVENT_QUEUE_LEN> eventQueue; // Control task -> connectivity task
+uint64_t actChangedUs[ACT_COUNT] = {0}; // Last transition (0 = boot, when all relays start off)
+uint64_t actOnUs[ACT_COUNT] = {0};      // Completed on-time
+uint32_t eventSeq = 0;
+ActuatorGovernor actGov[ACT_COUNT];
+uint64_t onUsCharged[ACT_COUNT] = {0}; // On-time already charged to a climate strategy
+
+void setActuator(Actuator a, bool on, uint8_t reason)
+{
+    if (*ACTUATOR_STATE[a] == on)
+        return;
+    digitalWrite(ACTUATOR_PINS[a], on ? HIGH : LOW);
+    *ACTUATOR_STATE[a] = on;
+
+    uint64_t now = esp_timer_get_time();
+    ActuatorEvent e = {};
+    e.act = a;
+    e.on = on;
+    e.reason = reason;
+    e.bootId = bootId;
+    e.seq = ++eventSeq;
+    e.tUs = now;
+    e.heldMs = (now - actChangedUs[a]) / 1000;
+    e.timestamp = currentEpoch(e.tsSrc);
+    e.tsErr = e.tsSrc == 2 ? 0 : -1;
+    if (!on)
+        actOnUs[a] += now - actChangedUs[a];
+    actChangedUs[a] = now;
+    actGov[a].noteChange(on, millis());
+    actuatorSwitches[a]++;
+    if (!eventQueue.push(e)) // Counted by the queue (event_drops); the relay state itself is in telemetry
+        Serial.printf("Event Queue Full: %s transition lost\n", ACTUATOR_NAMES[a]);
+    Serial.printf("%s %s (%s)\n", ACTUATOR_NAMES[a], on ? "ON" : "OFF", ACTUATOR_REASON_NAMES[reason]);
+}
+
+GovernorLimits governorLimits(Actuator a)
+{
+    portENTER_CRITICAL(&governorMux);
+    GovernorLimits lim = govLimits[a];
+    portEXIT_CRITICAL(&governorMux);
+    return lim;
+}
+
+// Automatic decisions pass through the governor; a change it refuses is
+// simply retried on the next tick. Manual and safety changes act at once.
+void requestActuator(Actuator a, bool on, uint8_t reason)
+{
+    if (on != *ACTUATOR_STATE[a] && (reason == AR_THRESHOLD || reason == AR_RULE) &&
+        !actGov[a].mayChange(on, millis(), governorLimits(a)))
+        return;
+    setActuator(a, on, reason);
+}
+
+// On-time for /metrics, including a run still in progress. Heater and fan
+// energy since the last tick is charged to the strategy that ran them.
+void updateOnTime()
+{
+    uint64_t now = esp_timer_get_time();
+    int watts[ACT_COUNT] = {0, FAN_WATTS, HEATER_WATTS};
+    float wh = 0;
+    for (int i = 0; i < ACT_COUNT; i++)
+    {
+        uint64_t us = actOnUs[i] + (*ACTUATOR_STATE[i] ? now - actChangedUs[i] : 0);
+        actuatorOnS[i] = us / 1000000;
+        wh += (float)(us - onUsCharged[i]) * watts[i] / 3.6e9f;
+        onUsCharged[i] = us;
+    }
+    climateWh[climateStrategy] += wh;
+}
+
+// --- IRRIGATION ENGINE (Pulse & Soak, multi-zone) ---
+// Each zone runs its own pulse/soak cycle: open the valve for PULSE_ON_SEC,
+// close it for SOAK_SEC while the water diffuses, re-measure, repeat until the
+// zone is above its wet target. One pump feeds all valves, so at most
+// MAX_ACTIVE_VALVES zones may pulse at once; the driest waiting zone goes
+// next. Soaking zones free their slot, so zones interleave naturally.
+unsigned long irrLastTick = 0;
+
+bool irrigationActive()
+{
+    for (int i = 0; i < zoneCfg.count; i++)
+        if (zonePhase[i] != IRR_IDLE)
+            return true;
+    return false;
+}
+
+void zoneSetValve(int z, bool open)
+{
+    if (zoneCfg.valvePin[z] >= 0 && zoneValveOn[z] != open)
+        digitalWrite(zoneCfg.valvePin[z], open ? HIGH : LOW);
+    zoneValveOn[z] = open;
+}
+
+// Pump runs whenever any valve is open
+void irrigationUpdatePump(uint8_t reason)
+{
+    bool on = false;
+    for (int i = 0; i < zoneCfg.count; i++)
+        on |= zoneValveOn[i];
+    setActuator(ACT_PUMP, on, reason);
+}
+
+// Splits the pump flow between open valves since the last tick
+void irrigationAccountWater()
+{
+    unsigned long now = millis();
+    unsigned long dt = now - irrLastTick;
+    irrLastTick = now;
+
+    int open = 0;
+    for (int i = 0; i < zoneCfg.count; i++)
+        open += zoneValveOn[i] ? 1 : 0;
+    if (open == 0)
+        return;
+
+    float ml = dt * (float)PUMP_FLOW_MLPM / 60000.0 / open;
+    for (int i = 0; i < zoneCfg.count; i++)
+    {
+        if (zoneValveOn[i])
+        {
+            zoneCycleWaterMl[i] += ml;
+            zoneTotalWaterMl[i] += ml;
+        }
+    }
+}
+
+void zoneStartPulse(int z, unsigned long now)
+{
+    zonePhase[z] = IRR_PULSE;
+    zonePhaseStart[z] = now;
+    zoneCyclePulses[z]++;
+    zoneSetValve(z, true);
+}
+
+void zoneEndCycle(int z, const char *reason)
+{
+    zoneSetValve(z, false);
+    if (zonePhase[z] != IRR_IDLE)
+    {
+        zoneLastWaterMl[z] = zoneCycleWaterMl[z];
+        zoneLastPulses[z] = zoneCyclePulses[z];
+        Serial.printf("Zone %d Irrigation Done (%s): %d pulses, %.0f ml\n", z + 1, reason, zoneCyclePulses[z], zoneCycleWaterMl[z]);
+    }
+    zonePhase[z] = IRR_IDLE;
+}
+
+void irrigationEndAll(const char *why, uint8_t reason)
+{
+    irrigationAccountWater();
+    for (int i = 0; i < zoneCfg.count; i++)
+        zoneEndCycle(i, why);
+    irrigationUpdatePump(reason);
+}
+
+// Swaps in a new zone layout from messageHandler (all valves closed first)
+void irrigationApplyConfig()
+{
+    if (!zoneCfgPending)
+        return;
+    irrigationEndAll("reconfigured", AR_SAFETY);
+    for (int i = 0; i < zoneCfg.count; i++)
+        if (zoneCfg.valvePin[i] >= 0)
+            digitalWrite(zoneCfg.valvePin[i], LOW);
+
+    portENTER_CRITICAL(&zoneMux);
+    zoneCfg = pendingZoneCfg;
+    zoneCfgPending = false;
+    portEXIT_CRITICAL(&zoneMux);
+
+    for (int i = 0; i < zoneCfg.count; i++)
+    {
+        zonePhase[i] = IRR_IDLE;
+        zoneValveOn[i] = false;
+        if (zoneCfg.valvePin[i] >= 0)
+        {
+            pinMode(zoneCfg.valvePin[i], OUTPUT);
+            digitalWrite(zoneCfg.valvePin[i], LOW);
+        }
+    }
+}
+
+// Requests a cycle on every idle zone below its wet target (used by rules)
+void irrigationRequestAll(float soilWet)
+{
+    for (int i = 0; i < zoneCfg.count; i++)
+    {
+        float wet = zoneCfg.wet[i] ? zoneCfg.wet[i] : soilWet;
+        if (zonePhase[i] == IRR_IDLE && zoneMoisture[i] < wet)
+        {
+            zoneCycleWaterMl[i] = 0;
+            zoneCyclePulses[i] = 0;
+            zonePhase[i] = IRR_PENDING;
+            zonePhaseStart[i] = millis();
+        }
+    }
+}
+
+void irrigationStep(bool tankHasWater, float soilDry, float soilWet)
+{
+    unsigned long now = millis();
+    uint8_t pumpReason = AR_THRESHOLD;
+    irrigationAccountWater();
+
+    // Governor: pulses run until the pump has had its minimum run time, and no
+    // new pulse starts the pump before its minimum off time or over its cap
+    GovernorLimits pumpLim = governorLimits(ACT_PUMP);
+    bool pumpHold = pumpStatus && !actGov[ACT_PUMP].mayChange(false, now, pumpLim);
+    bool pumpMayStart = pumpStatus || actGov[ACT_PUMP].mayChange(true, now, pumpLim);
+
+    if (!tankHasWater)
+    {
+        if (irrigationActive())
+            irrigationEndAll("tank empty", AR_SAFETY);
+        return;
+    }
+
+    int active = 0;
+    for (int i = 0; i < zoneCfg.count; i++)
+    {
+        // Per-zone thresholds, or the global (scheduled) ones
+        float dry = zoneCfg.dry[i] ? zoneCfg.dry[i] : soilDry;
+        float wet = zoneCfg.wet[i] ? zoneCfg.wet[i] : soilWet;
+        int moisture = zoneMoisture[i];
+
+        // Only pulsing zones hold their valve open (e.g. after leaving MANUAL)
+        if (zonePhase[i] != IRR_PULSE && zoneValveOn[i])
+            zoneSetValve(i, false);
+
+        switch (zonePhase[i])
+        {
+        case IRR_IDLE:
+            if (moisture < dry)
+            {
+                zoneCycleWaterMl[i] = 0;
+                zoneCyclePulses[i] = 0;
+                zonePhase[i] = IRR_PENDING;
+                zonePhaseStart[i] = now;
+            }
+            break;
+
+        case IRR_PENDING:
+            break;
+
+        case IRR_PULSE:
+            if (pumpHold)
+                active++;
+            else if (moisture > wet)
+                zoneEndCycle(i, "wet");
+            else if (PULSE_SOAK_MODE && now - zonePhaseStart[i] >= (unsigned long)PULSE_ON_SEC * 1000)
+            {
+                zoneSetValve(i, false);
+                zonePhase[i] = IRR_SOAK;
+                zonePhaseStart[i] = now;
+            }
+            else
+                active++;
+            break;
+
+        case IRR_SOAK:
+            if (now - zonePhaseStart[i] >= (unsigned long)SOAK_SEC * 1000)
+            {
+                if (moisture > wet)
+                    zoneEndCycle(i, "wet");
+                else if (zoneCyclePulses[i] >= MAX_PULSES_PER_CYCLE)
+                {
+                    zoneEndCycle(i, "pulse limit");
+                    pumpReason = AR_SAFETY;
+                }
+                else
+                {
+                    zonePhase[i] = IRR_PENDING;
+                    zonePhaseStart[i] = now;
+                }
+            }
+            break;
+        }
+    }
+
+    // Shared-pump scheduler: fill free valve slots, driest pending zone first
+    while (active < MAX_ACTIVE_VALVES && pumpMayStart)
+    {
+        int pick = -1;
+        for (int i = 0; i < zoneCfg.count; i++)
+        {
+            if (zonePhase[i] == IRR_PENDING && (pick < 0 || zoneMoisture[i] < zoneMoisture[pick]))
+                pick = i;
+        }
+        if (pick < 0)
+            break;
+        zoneStartPulse(pick, now);
+        active++;
+    }
+
+    irrigationUpdatePump(pumpReason);
+}
+
+// --- USER RULES ---
+// Runs after the built-in logic so rules can see (and override) its decisions.
+// Later rules take precedence. The pump is never forced on with an empty tank.
+void applyRules(bool tankHasWater, float soilWet, bool &wantFan, bool &wantHeater)
+{
+    xSemaphoreTake(rulesMutex, portMAX_DELAY);
+    if (!ruleVM.loaded())
+    {
+        xSemaphoreGive(rulesMutex);
+        return;
+    }
+
+    float vars[RULE_VAR_COUNT];
+    vars[RV_TEMP] = currentTemp;
+    vars[RV_HUM] = currentHum;
+    vars[RV_SOIL] = soilMoisture;
+    vars[RV_CO2] = eco2;
+    vars[RV_TVOC] = tvoc;
+    vars[RV_TANK] = waterTankLevel;
+    vars[RV_PUMP] = pumpStatus ? 1 : 0;
+    vars[RV_FAN] = wantFan ? 1 : 0;
+    vars[RV_HEATER] = wantHeater ? 1 : 0;
+    vars[RV_HOUR] = localHour;
+
+    unsigned long t0 = micros();
+    ruleVM.evaluate(vars, millis());
+    ruleEvalUs = micros() - t0;
+
+    bool on;
+    if (ruleVM.override(RO_FAN, on))
+        wantFan = on;
+    if (ruleVM.override(RO_HEATER, on))
+        wantHeater = on;
+
+    bool pumpRule = ruleVM.override(RO_PUMP, on);
+    xSemaphoreGive(rulesMutex);
+
+    // Pump rules start (or stop) irrigation cycles; the zone scheduler still
+    // decides which valves open, so the pump never runs deadheaded.
+    if (pumpRule)
+    {
+        if (on && tankHasWater)
+            irrigationRequestAll(soilWet);
+        else if (!on && irrigationActive())
+            irrigationEndAll("rule", AR_RULE);
+    }
+}
+
+// --- MANUAL COMMANDS ---
+// Directly control based on manual switches from Web App / AWS
+void applyManualOutputs()
+{
+    // Manual pump opens every zone valve (never run the pump deadheaded)
+    if (irrigationActive())
+        irrigationEndAll("manual", AR_MANUAL);
+    irrigationAccountWater();
+    for (int i = 0; i < zoneCfg.count; i++)
+        zoneSetValve(i, manualPump);
+    irrigationUpdatePump(AR_MANUAL);
+
+    setActuator(ACT_FAN, manualFan, AR_MANUAL);
+    setActuator(ACT_HEATER, manualHeater, AR_MANUAL);
+}
+
+// Taken before the relays are set, so an ack never claims a command that
+// arrived after them
+int takeCommands(CommandAck *cmds)
+{
+    int n = 0;
+    while (n < CMD_QUEUE_LEN && commandQueue.pop(cmds[n]))
+        n++;
+    return n;
+}
+
+void ackCommands(CommandAck *cmds, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        cmds[i].latencyUs = micros() - cmds[i].rxUs;
+        cmds[i].pump = pumpStatus;
+        cmds[i].fan = fanStatus;
+        cmds[i].heater = heaterStatus;
+        cmds[i].manual = manualMode;
+        ackQueue.push(cmds[i]);
+    }
+}
+
+// --- TASK 2: INTELLIGENT CONTROL ---
+void TaskControlSystem(void *pvParameters)
+{
+    esp_task_wdt_add(NULL); // Add to WDT
+    pinMode(PIN_TRIG, OUTPUT);
+    pinMode(PIN_ECHO, INPUT);
+
+    // Tank dimensions (adjust these for tank)
+    // const int TANK_EMPTY_DIST = 25;  // Distance when tank is empty (cm) - MOVED TO GLOBAL
+    // const int TANK_FULL_DIST = 5;    // Distance when tank is full (cm) - MOVED TO GLOBAL
+
+    for (;;)
     {
         esp_task_wdt_reset(); // Feed WDT
+        heartbeat(TASK_CONTROL);
+        taskSafePoint(TASK_CONTROL);
+        wakeCount++;
+
+        updateOnTime();
         // 1. Water Tank Level Check
         digitalWrite(PIN_TRIG, LOW);
         delayMicroseconds(2);
@@ -578,76 +2546,322 @@ void TaskControlSystem(void *pvParameters)
         // Tank is empty if distance > 25cm (sensor at top looking down)
         bool tankHasWater = (distanceCM < TANK_EMPTY_DIST);
 
+        irrigationApplyConfig();
+
+        // Targets for this tick (fixed thresholds or time-of-day schedule)
+        Setpoints sp = computeSetpoints();
+        activeSp = sp;
+
+        // Commands queued so far are acked once this tick has set the relays
+        CommandAck cmds[CMD_QUEUE_LEN];
+        int cmdCount = takeCommands(cmds);
+
         // Check if Manual or Auto mode
         if (manualMode)
         {
+            markBoot(BP_CONTROL);
             // ========== MANUAL MODE ==========
-            // Directly control based on manual switches from Web App / AWS
-            digitalWrite(PIN_PUMP, manualPump ? HIGH : LOW);
-            pumpStatus = manualPump;
-
-            digitalWrite(PIN_FAN, manualFan ? HIGH : LOW);
-            fanStatus = manualFan;
-
-            digitalWrite(PIN_HEATER, manualHeater ? HIGH : LOW);
-            heaterStatus = manualHeater;
+            applyManualOutputs();
+            climateStrategy = CS_MANUAL;
+        }
+        else if (!sensorsReady)
+        {
+            // Boot: relays stay in their safe (off) state until the first
+            // readings arrive, instead of acting on zeroed values.
         }
         else
         {
+            markBoot(BP_CONTROL);
             // ========== AUTO MODE (Default) ==========
-            // 2. Irrigation Control (Hysteresis)
-            if (soilMoisture < SOIL_DRY && tankHasWater)
-            {
-                digitalWrite(PIN_PUMP, HIGH); // Turn ON
-                pumpStatus = true;
-            }
-            else if (soilMoisture > SOIL_WET || !tankHasWater)
-            {
-                digitalWrite(PIN_PUMP, LOW); // Turn OFF
-                pumpStatus = false;
-            }
+            // 2. Irrigation Control (Pulse & Soak, or continuous hysteresis)
+            irrigationStep(tankHasWater, sp.soilDry, sp.soilWet);
 
-            // 3. Climate Control
-            // Fan: Turns on if too hot OR too humid
-            if (currentTemp > TEMP_MAX_DAY || currentHum > HUM_MAX)
-            {
-                digitalWrite(PIN_FAN, HIGH);
-                fanStatus = true;
-            }
-            else
-            {
-                digitalWrite(PIN_FAN, LOW);
-                fanStatus = false;
-            }
+            // 3. Climate Control: heater and fan are arbitrated together, so
+            // cold humid nights (Welimada) do not vent the heat straight out
+            GovernorLimits fanLim = governorLimits(ACT_FAN);
+            GovernorLimits heaterLim = governorLimits(ACT_HEATER);
+            ClimateInputs ci = {currentTemp, currentHum, sp.tempMin, sp.tempMax, sp.humMax,
+                                fanLim.band, heaterLim.band, fanStatus, heaterStatus};
+            ClimateDecision cd = climateArbiter.decide(ci);
+            climateStrategy = cd.strategy;
+            bool wantFan = cd.fan;
+            bool wantHeater = cd.heater;
 
-            // Heater: Turns on if too cold (Critical for Welimada nights)
-            if (currentTemp < TEMP_MIN_NIGHT)
-            {
-                digitalWrite(PIN_HEATER, HIGH);
-                heaterStatus = true;
-            }
-            else
-            {
-                digitalWrite(PIN_HEATER, LOW);
-                heaterStatus = false;
-            }
+            // 4. User Rules (may override the decisions above)
+            bool baseFan = wantFan, baseHeater = wantHeater;
+            applyRules(tankHasWater, sp.soilWet, wantFan, wantHeater);
+
+            requestActuator(ACT_HEATER, wantHeater, wantHeater != baseHeater ? AR_RULE : AR_THRESHOLD);
+            // A vent burst waits while the heater is held on by its minimum run time
+            if (wantFan && !fanStatus && heaterStatus && !wantHeater && wantFan == baseFan)
+                wantFan = false;
+            requestActuator(ACT_FAN, wantFan, wantFan != baseFan ? AR_RULE : AR_THRESHOLD);
+        }
+        ackCommands(cmds, cmdCount);
+
+        // Tick faster during a cycle so pulses end close to SOIL_WET. A manual
+        // command wakes the task early: in manual mode the relays switch right
+        // away (skipping the tank ping); a mode change runs a full tick now.
+        TickType_t wakeAt = xTaskGetTickCount() + (irrigationActive() ? CONTROL_FAST_MS : CONTROL_PERIOD_MS) / portTICK_PERIOD_MS;
+        for (;;)
+        {
+            TickType_t left = wakeAt - xTaskGetTickCount();
+            if ((int32_t)left <= 0 || !ulTaskNotifyTake(pdTRUE, left) || !manualMode)
+                break;
+            cmdCount = takeCommands(cmds);
+            applyManualOutputs();
+            ackCommands(cmds, cmdCount);
         }
+    }
+}
 
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+// --- LAN WEB SERVER ---
+// Live snapshot built straight from the shared state (no record is taken, so
+// seq is not consumed). Keys match the telemetry record.
+size_t writeLiveSnapshot(char *buf, size_t size)
+{
+    int n = snprintf(buf, size,
+                     "{\"device_id\":\"%s\",\"uptime_ms\":%lu,\"temp\":%.1f,\"hum\":%.1f,\"soil\":%d,\"co2\":%d,"
+                     "\"tvoc\":%d,\"tank_level\":%d,\"pump\":%d,\"fan\":%d,\"heater\":%d,\"mode\":\"%s\",\"zones\":[",
+                     deviceId, (unsigned long)millis(), currentTemp, currentHum, soilMoisture, eco2, tvoc,
+                     waterTankLevel, pumpStatus, fanStatus, heaterStatus, manualMode ? "MANUAL" : "AUTO");
+    int count = zoneConfigSnapshot().count;
+    for (int i = 0; i < count && n > 0 && (size_t)n < size; i++)
+        n += snprintf(buf + n, size - n, i ? ",%d" : "%d", zoneMoisture[i]);
+    if (n > 0 && (size_t)n < size)
+        n += snprintf(buf + n, size - n, "]}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+// Runs on the async TCP task
+void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *c, AwsEventType type, void *arg, uint8_t *data,
+               size_t len)
+{
+    if (type == WS_EVT_CONNECT)
+    {
+        if (server->count() > WS_MAX_CLIENTS)
+        {
+            c->close(1013, "Too many clients");
+            wsRejected++;
+            return;
+        }
+        Serial.printf("WS Client %lu Connected (%u total)\n", (unsigned long)c->id(), (unsigned)server->count());
+    }
+    else if (type == WS_EVT_DISCONNECT)
+    {
+        Serial.printf("WS Client %lu Disconnected\n", (unsigned long)c->id());
     }
 }
 
+// Renders every metric into `buf`. Reads the shared state directly; the only
+// work per scrape is formatting. Returns 0 if the page did not fit.
+size_t renderMetrics(char *buf, size_t size)
+{
+    uint32_t t0 = micros();
+    PromWriter m(buf, size);
+    char idx[4];
+
+    m.family("greenhouse_temperature_celsius", "gauge", "Air temperature");
+    m.sampleF("greenhouse_temperature_celsius", currentTemp);
+    m.family("greenhouse_humidity_percent", "gauge", "Relative humidity");
+    m.sampleF("greenhouse_humidity_percent", currentHum);
+    m.family("greenhouse_vpd_kpa", "gauge", "Vapour-pressure deficit");
+    m.sampleF("greenhouse_vpd_kpa", vpdKPa(currentTemp, currentHum));
+    m.family("greenhouse_dew_point_celsius", "gauge", "Dew point");
+    m.sampleF("greenhouse_dew_point_celsius", dewPointC(currentTemp, currentHum));
+    m.family("greenhouse_soil_moisture_percent", "gauge", "Soil moisture (zone 0 or single probe)");
+    m.sample("greenhouse_soil_moisture_percent", soilMoisture);
+    m.family("greenhouse_zone_soil_moisture_percent", "gauge", "Soil moisture per irrigation zone");
+    int zones = zoneConfigSnapshot().count;
+    for (int i = 0; i < zones; i++)
+    {
+        snprintf(idx, sizeof(idx), "%d", i);
+        m.sample("greenhouse_zone_soil_moisture_percent", zoneMoisture[i], "zone", idx);
+    }
+    m.family("greenhouse_co2_ppm", "gauge", "Equivalent CO2");
+    m.sample("greenhouse_co2_ppm", eco2);
+    m.family("greenhouse_tvoc_ppb", "gauge", "Total volatile organic compounds");
+    m.sample("greenhouse_tvoc_ppb", tvoc);
+    m.family("greenhouse_tank_level_percent", "gauge", "Water tank level");
+    m.sample("greenhouse_tank_level_percent", waterTankLevel);
+
+    bool on[ACT_COUNT] = {pumpStatus, fanStatus, heaterStatus};
+    m.family("greenhouse_actuator_on", "gauge", "Actuator state (1 = on)");
+    for (int i = 0; i < ACT_COUNT; i++)
+        m.sample("greenhouse_actuator_on", on[i], "actuator", ACTUATOR_NAMES[i]);
+    m.family("greenhouse_actuator_on_seconds_total", "counter", "Time the actuator has been on since boot");
+    for (int i = 0; i < ACT_COUNT; i++)
+        m.sample("greenhouse_actuator_on_seconds_total", actuatorOnS[i], "actuator", ACTUATOR_NAMES[i]);
+    m.family("greenhouse_actuator_switches_total", "counter", "Relay switch count over the device lifetime");
+    for (int i = 0; i < ACT_COUNT; i++)
+        m.sample("greenhouse_actuator_switches_total", actuatorSwitches[i], "actuator", ACTUATOR_NAMES[i]);
+    m.family("greenhouse_climate_strategy", "gauge", "Heater/fan strategy in force (1 = active)");
+    for (int i = 0; i < CS_COUNT; i++)
+        m.sample("greenhouse_climate_strategy", climateStrategy == i, "strategy", CLIMATE_STRATEGY_NAMES[i]);
+    m.family("greenhouse_climate_energy_wh_total", "counter", "Estimated heater and fan energy per strategy since boot");
+    for (int i = 0; i < CS_COUNT; i++)
+        m.sampleF("greenhouse_climate_energy_wh_total", climateWh[i], "strategy", CLIMATE_STRATEGY_NAMES[i]);
+    m.family("greenhouse_manual_mode", "gauge", "1 = manual control");
+    m.sample("greenhouse_manual_mode", manualMode);
+
+    m.family("greenhouse_uptime_seconds", "counter", "Time since boot");
+    m.sample("greenhouse_uptime_seconds", millis() / 1000);
+    m.family("greenhouse_heap_free_bytes", "gauge", "Free 8-bit heap");
+    m.sample("greenhouse_heap_free_bytes", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    m.family("greenhouse_heap_largest_free_bytes", "gauge", "Largest free heap block");
+    m.sample("greenhouse_heap_largest_free_bytes", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    m.family("greenhouse_heap_largest_free_min_bytes", "gauge", "Smallest largest-free-block seen since boot");
+    m.sample("greenhouse_heap_largest_free_min_bytes", heapLargestMin);
+    m.family("greenhouse_task_stack_free_bytes", "gauge", "Lowest free stack seen per task");
+    for (int i = 0; i < TASK_COUNT; i++)
+        m.sample("greenhouse_task_stack_free_bytes", tasks[i].minFree, "task", tasks[i].name);
+    m.family("greenhouse_supervisor_recoveries_total", "counter", "Recovery steps taken by the supervisor");
+    m.sample("greenhouse_supervisor_recoveries_total", recoveryCount);
+
+    m.family("greenhouse_mqtt_connected", "gauge", "Broker connection state");
+    m.sample("greenhouse_mqtt_connected", awsConnected, "broker", "aws");
+    m.sample("greenhouse_mqtt_connected", lanConnected, "broker", "lan");
+    m.family("greenhouse_mqtt_connects_total", "counter", "Successful AWS connects");
+    m.sample("greenhouse_mqtt_connects_total", mqttConnects);
+    m.family("greenhouse_mqtt_connect_failures_total", "counter", "Failed AWS connects");
+    m.sample("greenhouse_mqtt_connect_failures_total", mqttConnectFails);
+    m.family("greenhouse_mqtt_publishes_total", "counter", "Messages published to AWS");
+    m.sample("greenhouse_mqtt_publishes_total", mqttPublishes);
+    m.family("greenhouse_mqtt_publish_failures_total", "counter", "AWS publishes that failed");
+    m.sample("greenhouse_mqtt_publish_failures_total", mqttPublishFails);
+    m.family("greenhouse_mqtt_received_total", "counter", "Command messages received");
+    m.sample("greenhouse_mqtt_received_total", mqttReceived);
+
+    m.family("greenhouse_queue_depth", "gauge", "Records waiting in the telemetry queue");
+    m.sample("greenhouse_queue_depth", telemetryQueue.depth());
+    m.family("greenhouse_queue_drops_total", "counter", "Records dropped on a full telemetry queue");
+    m.sample("greenhouse_queue_drops_total", telemetryQueue.overflowCount());
+    m.family("greenhouse_event_drops_total", "counter", "Actuator events dropped on a full event queue");
+    m.sample("greenhouse_event_drops_total", eventQueue.overflowCount());
+    m.family("greenhouse_event_corrupt_total", "counter", "Actuator events that could not be encoded");
+    m.sample("greenhouse_event_corrupt_total", eventCorrupt);
+    m.family("greenhouse_offline_pending_bytes", "gauge", "Offline log not yet uploaded");
+    m.sample("greenhouse_offline_pending_bytes", offlinePendingBytes);
+    m.family("greenhouse_fs_used_bytes", "gauge", "LittleFS space in use");
+    m.sample("greenhouse_fs_used_bytes", fsUsedBytes);
+    m.family("greenhouse_fs_total_bytes", "gauge", "LittleFS capacity");
+    m.sample("greenhouse_fs_total_bytes", fsTotalBytes);
+    m.family("greenhouse_ws_clients", "gauge", "Live stream clients");
+    m.sample("greenhouse_ws_clients", ws.count());
+
+    m.family("greenhouse_metrics_render_microseconds", "gauge", "Time taken by the previous scrape");
+    m.sample("greenhouse_metrics_render_microseconds", metricsRenderUs);
+    m.family("greenhouse_metrics_overflows_total", "counter", "Scrapes refused because the page did not fit");
+    m.sample("greenhouse_metrics_overflows_total", metricsOverflows);
+
+    metricsRenderUs = micros() - t0;
+    if (m.overflow)
+    {
+        metricsOverflows++;
+        Serial.println("Metrics buffer too small!");
+        return 0;
+    }
+    return m.length();
+}
+
+// The page is rendered into one static buffer and sent straight from it. The
+// response streams after the handler returns, so a second scrape arriving
+// before the first has gone out is refused rather than overwriting it.
+void handleMetrics(AsyncWebServerRequest *req)
+{
+    static char page[METRICS_BUF_SIZE];
+    static volatile bool sending = false;
+    if (sending)
+    {
+        req->send(503);
+        return;
+    }
+    sending = true;
+    size_t len = renderMetrics(page, sizeof(page));
+    if (!len)
+    {
+        sending = false;
+        req->send(500, "text/plain", "Metrics buffer too small\n"); // A cut page would read as valid but missing series
+        return;
+    }
+    req->onDisconnect([]() { sending = false; });
+    req->send(req->beginResponse_P(200, "text/plain; version=0.0.4", (const uint8_t *)page, len));
+}
+
+void startLanServer()
+{
+    ws.onEvent(onWsEvent);
+    webServer.addHandler(&ws);
+    webServer.on("/snapshot", HTTP_GET, [](AsyncWebServerRequest *req)
+                 {
+                     char buf[WS_SNAPSHOT_MAX];
+                     writeLiveSnapshot(buf, sizeof(buf));
+                     req->send(200, "application/json", buf);
+                 });
+    webServer.on("/metrics", HTTP_GET, handleMetrics);
+    webServer.begin();
+    webServerStarted = true;
+    Serial.printf("LAN Server on port %d (/ws, /snapshot, /metrics)\n", WEB_PORT);
+}
+
+// Serializes one snapshot into a shared, reference-counted buffer and queues
+// it to every client, so the cost does not grow with the number of viewers.
+void pushLiveSnapshot()
+{
+    if (!webServerStarted)
+        return;
+    ws.cleanupClients(WS_MAX_CLIENTS);
+    size_t clients = ws.count();
+    uint32_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (clients == 0)
+    {
+        wsHeapBase = freeHeap;
+        wsClientBytes = 0;
+        return;
+    }
+    uint32_t perClient = wsHeapBase > freeHeap ? (wsHeapBase - freeHeap) / clients : 0;
+    wsClientBytes = perClient > UINT16_MAX ? UINT16_MAX : perClient;
+
+    char buf[WS_SNAPSHOT_MAX];
+    size_t len = writeLiveSnapshot(buf, sizeof(buf));
+    AsyncWebSocketMessageBuffer *msg = len ? ws.makeBuffer((uint8_t *)buf, len) : NULL;
+    if (msg)
+        ws.textAll(msg);
+}
+
 // --- TASK 3: USER INTERFACE ---
 void TaskInterface(void *pvParameters)
 {
-    unsigned long lastLcdUpdate = 0;
+    esp_task_wdt_add(NULL); // Add to WDT
+
+    i2cAcquire();
+    lcd.init();
+    lcd.backlight();
+    lcd.setCursor(0, 0);
+    lcd.print("Smart GreenHouse");
+    lcd.setCursor(0, 1);
+    lcd.print(deviceId); // Show ID on boot
+    lcd.setCursor(0, 2);
+    lcd.print("System Starting...");
+    i2cRelease();
+    markBoot(BP_LCD);
+
+    // The splash stays up for SPLASH_MS while the other tasks carry on
+    unsigned long lastLcdUpdate = millis() + SPLASH_MS - 500;
+    unsigned long lastWsPush = 0;
+    bool splashChecked = false;
 
     for (;;)
     {
+        esp_task_wdt_reset(); // Feed WDT
+        heartbeat(TASK_UI);
+        taskSafePoint(TASK_UI);
+        wakeCount++;
         // Check Button Flag from ISR
         if (btnRequest)
         {
             btnRequest = false;
+            i2cAcquire();
             if (portalRunning)
             {
                 stopPortalRequest = true;
@@ -670,174 +2884,905 @@ void TaskInterface(void *pvParameters)
                 // We do NOT disconnect here anymore, to allow simultaneous operation
                 // WiFi.disconnect();
             }
+            i2cRelease();
+        }
+
+        // Report a sensor failure on the splash once the sensor task knows
+        if (!splashChecked && sensorsReady)
+        {
+            splashChecked = true;
+            if (!sensorInitOk)
+            {
+                i2cAcquire();
+                lcd.setCursor(0, 2);
+                lcd.print("Sensor Failure!     ");
+                i2cRelease();
+            }
+        }
+
+        // Update LCD every 500ms
+        if ((long)(millis() - lastLcdUpdate) > 500)
+        {
+            lastLcdUpdate = millis();
+            i2cAcquire();
+
+            if (portalRunning || reconfigureWiFi)
+            {
+                lcd.setCursor(0, 0);
+                lcd.print("WiFi Setup Mode     ");
+                lcd.setCursor(0, 1);
+                lcd.print("Connect to AP:      ");
+                lcd.setCursor(0, 2);
+                lcd.print("Greenhouse-Setup    ");
+                lcd.setCursor(0, 3);
+                lcd.print("                    ");
+            }
+            else
+            {
+                // Line 0: Temp & Heater
+                lcd.setCursor(0, 0);
+                lcd.printf("Temp:%4.1fC  Heat:%s", currentTemp, heaterStatus ? "ON " : "OFF");
+
+                // Line 1: Humidity & Fan
+                lcd.setCursor(0, 1);
+                lcd.printf("Hum :%3d%%   Fan :%s", (int)currentHum, fanStatus ? "ON " : "OFF");
+
+                // Line 2: Soil & Pump
+                lcd.setCursor(0, 2);
+                lcd.printf("Soil:%3d%%   Pump:%s", soilMoisture, pumpStatus ? "ON " : "OFF");
+
+                // Line 3: CO2 & AWS Status
+                lcd.setCursor(0, 3);
+                if (awsConnected)
+                {
+                    lcd.printf("CO2 :%-4d   AWS :ON ", eco2);
+                }
+                else if (wifiConnected)
+                {
+                    lcd.printf("CO2 :%-4d   AWS :CON", eco2);
+                }
+                else
+                {
+                    lcd.printf("CO2 :%-4d   AWS :OFF", eco2);
+                }
+            }
+            i2cRelease();
+        }
+
+        // Live stream for LAN dashboards
+        if (millis() - lastWsPush >= WS_PUSH_MS)
+        {
+            lastWsPush = millis();
+            pushLiveSnapshot();
         }
 
-        // Update LCD every 500ms
-        if (millis() - lastLcdUpdate > 500)
-        {
-            lastLcdUpdate = millis();
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+}
+
+// --- DATA LOGGING HELPER FUNCTIONS ---
+// Records are binary telemetry records (see telemetry_schema.h) stored as
+// CRC-checked frames (see record_log.h). They are appended to a fixed RAM
+// buffer and written to flash in one go, so logging never touches the heap.
+// Upload resumes from a cursor that is persisted after every sent record.
+#define LOG_FILE "/offline_log.bin"
+#define LEGACY_LOG_BIN "/legacy_log.bin" // A LOG_FILE from before the log header
+
+uint8_t ramBuffer[RAM_BUFFER_BYTES];
+size_t ramBufferLen = 0;
+int ramBufferCount = 0;
+uint32_t ramBufferLastMono = 0; // mono_ms of the newest buffered record
+const int RAM_BUFFER_SIZE = 50; // Write to flash every ~4 minutes (50 * 5s)
+LogCursor logCursor = {0, LOG_HEADER_SIZE};
+uint32_t logFileBytes = 0; // Size of LOG_FILE (0 = none)
+
+// Backlog for /metrics; cheap, refreshed whenever the buffer or cursor moves
+void notePendingBytes()
+{
+    uint32_t inFile = logFileBytes > logCursor.offset ? logFileBytes - logCursor.offset : 0;
+    offlinePendingBytes = inFile + ramBufferLen;
+}
+
+// Filesystem usage walks the LittleFS metadata, so only after writes/removes
+void noteStorageUsage()
+{
+    notePendingBytes();
+    fsUsedBytes = LittleFS.usedBytes();
+    fsTotalBytes = LittleFS.totalBytes();
+}
+
+void saveLogCursor()
+{
+    preferences.putBytes("log_cursor", &logCursor, sizeof(logCursor));
+}
+
+// Called once at boot: matches the stored upload cursor against the log file
+void openOfflineLog()
+{
+    if (preferences.getBytes("log_cursor", &logCursor, sizeof(logCursor)) != sizeof(logCursor))
+        logCursor = {0, LOG_HEADER_SIZE};
+
+    File file = LittleFS.open(LOG_FILE, FILE_READ);
+    if (!file)
+    {
+        hasOfflineData = false;
+        return;
+    }
+    uint8_t hdr[LOG_HEADER_SIZE];
+    uint32_t gen = 0;
+    uint32_t size = file.size();
+    bool valid = file.read(hdr, sizeof(hdr)) == sizeof(hdr) && logParseHeader(hdr, gen);
+    file.close();
+
+    if (!logResumeCursor(valid, gen, logCursor))
+    {
+        LittleFS.remove(LOG_FILE);
+        hasOfflineData = false;
+        return;
+    }
+    hasOfflineData = logCursor.offset < size;
+    logFileBytes = size;
+    Serial.printf("Offline Log: %lu bytes, %lu pending\n", (unsigned long)size,
+                  (unsigned long)(hasOfflineData ? size - logCursor.offset : 0));
+}
+
+void flushRamBuffer()
+{
+    if (ramBufferCount > 0)
+    {
+        bool fresh = !LittleFS.exists(LOG_FILE);
+        File file = LittleFS.open(LOG_FILE, FILE_APPEND);
+        if (!file)
+        {
+            Serial.println("Failed to open log file for flushing");
+            return;
+        }
+        if (fresh)
+        {
+            uint8_t hdr[LOG_HEADER_SIZE];
+            logHeader(logCursor.gen, hdr);
+            file.write(hdr, sizeof(hdr));
+        }
+        file.write(ramBuffer, ramBufferLen);
+        logFileBytes = file.size();
+        file.close();
+        noteBootProgress(ramBufferLastMono);
+        Serial.println("RAM Buffer Flushed to Flash");
+
+        ramBufferLen = 0;
+        ramBufferCount = 0;
+        hasOfflineData = true;
+        noteStorageUsage();
+    }
+}
+
+// Appends one record (telemetry or actuator event) to the offline log
+void logRecordOffline(const uint8_t *rec, size_t len, uint32_t monoMs)
+{
+    size_t frameLen = len + LOG_FRAME_OVERHEAD;
+    if (len == 0 || frameLen > sizeof(ramBuffer))
+        return;
+
+    // Make room first if this record would overflow the buffer
+    if (ramBufferLen + frameLen > sizeof(ramBuffer))
+        flushRamBuffer();
+    if (ramBufferLen + frameLen > sizeof(ramBuffer))
+        return; // Flash write failed; drop rather than overrun
+
+    // Buffer in RAM first
+    ramBufferLen += logEncodeFrame(rec, len, ramBuffer + ramBufferLen);
+    ramBufferCount++;
+    ramBufferLastMono = monoMs;
+    notePendingBytes();
+
+    Serial.printf("Offline Data Buffered: %d/%d\n", ramBufferCount, RAM_BUFFER_SIZE);
+
+    // Only write to Flash if buffer is full
+    if (ramBufferCount >= RAM_BUFFER_SIZE)
+    {
+        flushRamBuffer();
+    }
+}
+
+void logDataOffline(const TelemetrySample &sample)
+{
+    static uint8_t rec[TELEMETRY_BINARY_MAX];
+    size_t len = writeTelemetryBinary(sample, rec, sizeof(rec));
+    logRecordOffline(rec, len, sample.mono_ms);
+}
+
+void logEventOffline(const ActuatorEvent &e)
+{
+    uint8_t rec[EVENT_RECORD_SIZE];
+    logRecordOffline(rec, encodeEvent(e, rec), e.tUs / 1000);
+}
+
+// Moves the records of a log written by older firmware into the offline log,
+// then removes it. Text logs hold one JSON record per line; binary ones a u16
+// length before each record (schema version 3). JSON records from before NTP
+// are marked ts_src 0, so the backend stores them at their arrival time;
+// binary ones carry boot_id/mono_ms and are rebased on upload like any other.
+// The old file is kept if the log cannot be written, and retried next boot.
+void migrateLegacyLog(const char *name, bool text)
+{
+    File file = LittleFS.open(name, FILE_READ);
+    if (!file)
+        return;
+    static const char TS_MARK[] = "{\"ts_src\": 0, "; // Replaces the opening brace
+    static uint8_t rec[LOG_LINE_MAX];
+    uint32_t moved = 0, bad = 0;
+    while (file.available())
+    {
+        size_t len;
+        if (text)
+        {
+            // Read past the room the mark needs, so it can go in front in place
+            char *line = (char *)rec + sizeof(TS_MARK) - 2;
+            len = file.readBytesUntil('\n', line, sizeof(rec) - sizeof(TS_MARK));
+            while (len && (line[len - 1] == '\r' || line[len - 1] == ' '))
+                len--;
+            line[len] = '\0';
+            if (len < 2 || line[0] != '{')
+            {
+                bad += len > 0;
+                continue;
+            }
+            const char *ts = strstr(line, "\"timestamp\": ");
+            if (!strstr(line, "\"ts_src\"") && (!ts || strtoul(ts + 13, nullptr, 10) <= EPOCH_VALID))
+            {
+                memcpy(rec, TS_MARK, sizeof(TS_MARK) - 1);
+                len += sizeof(TS_MARK) - 2;
+                line = (char *)rec;
+            }
+            logRecordOffline((const uint8_t *)line, len, millis());
+        }
+        else
+        {
+            uint8_t hdr[2];
+            TelemetryTimeOffsets at;
+            if (file.read(hdr, 2) != 2)
+                break;
+            len = hdr[0] | (hdr[1] << 8);
+            if (len > sizeof(rec) || file.read(rec, len) != len || !telemetryTimeOffsets(rec, len, at))
+            {
+                bad++;
+                break; // Framing lost: nothing after this can be trusted
+            }
+            logRecordOffline(rec, len, millis());
+        }
+        moved++;
+    }
+    file.close();
+    flushRamBuffer();
+    if (ramBufferCount > 0)
+    {
+        Serial.printf("Legacy Log %s kept: offline log write failed\n", name);
+        return;
+    }
+    LittleFS.remove(name);
+    Serial.printf("Migrated Legacy Log %s: %lu records, %lu unreadable\n", name, (unsigned long)moved,
+                  (unsigned long)bad);
+}
+
+// Mounts the filesystem (formatting it if unreadable). Runs once, at the
+// first start of the connectivity task, the only writer, so a slow mount or
+// format does not hold up control.
+void initStorage()
+{
+    if (!LittleFS.begin(true))
+    {
+        Serial.println("LittleFS Mount Failed");
+        hasOfflineData = false;
+        return;
+    }
+    Serial.println("LittleFS Mounted");
+    logFileBytes = 0;
+
+    // LOG_FILE without a log header was written by firmware that framed
+    // records with a bare length; move it aside before the log opens
+    File file = LittleFS.open(LOG_FILE, FILE_READ);
+    if (file)
+    {
+        uint8_t hdr[LOG_HEADER_SIZE];
+        uint32_t gen;
+        bool framed = file.read(hdr, sizeof(hdr)) == sizeof(hdr) && logParseHeader(hdr, gen);
+        file.close();
+        if (!framed)
+            LittleFS.rename(LOG_FILE, LEGACY_LOG_BIN);
+    }
+    openOfflineLog();
+
+    // Backlogs from older firmware, oldest records first
+    migrateLegacyLog("/processing.txt", true);
+    migrateLegacyLog("/offline_log.txt", true);
+    migrateLegacyLog("/processing.bin", false);
+    migrateLegacyLog(LEGACY_LOG_BIN, false);
+    noteStorageUsage();
+}
+
+
+// Rewrites the time fields of a binary record read from the offline log. Only
+// the RAM copy being uploaded changes; the log itself is append-only. Works
+// for records left by older firmware too (see telemetryTimeOffsets).
+void rebaseRecord(uint8_t *rec, size_t len)
+{
+    TelemetryTimeOffsets at;
+    if (!telemetryTimeOffsets(rec, len, at))
+        return;
+    uint32_t recBoot, monoMs, ts;
+    int32_t err;
+    uint8_t src = rec[at.tsSrc];
+    memcpy(&recBoot, rec + at.bootId, 4);
+    memcpy(&monoMs, rec + at.monoMs, 4);
+    memcpy(&ts, rec + at.timestamp, 4);
+    memcpy(&err, rec + at.tsErr, 4);
+    if (!rebaseTimestamp(recBoot, monoMs, src, ts, err))
+        return;
+    rec[at.tsSrc] = src;
+    memcpy(rec + at.timestamp, &ts, 4);
+    memcpy(rec + at.tsErr, &err, 4);
+}
+
+// Uploads one batch from the persisted cursor (see logUpload in record_log.h)
+// and returns, so the connectivity loop drains the live queues between
+// batches instead of stalling behind a long backlog. The cursor is persisted
+// once per batch. An interrupted upload resumes at the first unsent record.
+void processOfflineData()
+{
+    if (!hasOfflineData)
+        return; // Skip if we know there's nothing
+
+    File file = LittleFS.open(LOG_FILE, FILE_READ);
+    if (!file)
+    {
+        hasOfflineData = false;
+        return;
+    }
 
-            if (portalRunning || reconfigureWiFi)
+    char topic[50];
+    snprintf(topic, sizeof(topic), "greenhouse/%s/data", deviceId);
+    char eventsTopic[50];
+    snprintf(eventsTopic, sizeof(eventsTopic), "greenhouse/%s/events", deviceId);
+    static uint8_t frame[LOG_LINE_MAX + LOG_FRAME_OVERHEAD];
+    uint32_t skipped = 0;
+    uint32_t startOffset = logCursor.offset;
+    uint32_t start = millis();
+    int sent = 0;
+    LogUploadResult result = logUpload(
+        file, file.size(), logCursor, frame, LOG_LINE_MAX, skipped, OFFLINE_BATCH_RECORDS,
+        [&]() { return millis() - start >= OFFLINE_BATCH_MS; },
+        [&](uint8_t *rec, uint16_t len)
+        {
+            // Wall-clock times for records captured before NTP
+            bool ok = client.connected();
+            if (ok && isEventRecord(rec, len))
             {
-                lcd.setCursor(0, 0);
-                lcd.print("WiFi Setup Mode     ");
-                lcd.setCursor(0, 1);
-                lcd.print("Connect to AP:      ");
-                lcd.setCursor(0, 2);
-                lcd.print("Greenhouse-Setup    ");
-                lcd.setCursor(0, 3);
-                lcd.print("                    ");
+                ActuatorEvent e;
+                char json[EVENT_JSON_MAX];
+                decodeEvent(rec, e);
+                rebaseTimestamp(e.bootId, e.tUs / 1000, e.tsSrc, e.timestamp, e.tsErr);
+                if (e.act >= ACT_COUNT || !writeEventJson(e, ACTUATOR_NAMES, json, sizeof(json)))
+                {
+                    eventCorrupt++; // Retrying cannot help: step over it
+                    return true;
+                }
+                ok = client.publish(eventsTopic, json);
             }
-            else
+            else if (ok)
             {
-                // Line 0: Temp & Heater
-                lcd.setCursor(0, 0);
-                lcd.printf("Temp:%4.1fC  Heat:%s", currentTemp, heaterStatus ? "ON " : "OFF");
+                rebaseRecord(rec, len);
+                ok = client.publish(topic, rec, len);
+            }
+            if (ok)
+            {
+                mqttPublishes++;
+                sent++;
+            }
+            else
+                mqttPublishFails++;
+            return ok;
+        });
+    file.close();
+    if (logCursor.offset != startOffset)
+    {
+        saveLogCursor();
+        notePendingBytes();
+    }
+    if (sent || skipped)
+        Serial.printf("Offline Upload: %d sent, %lu damaged bytes skipped, %lu ms\n", sent, (unsigned long)skipped,
+                      (unsigned long)(millis() - start));
+    if (result != LOG_UPLOAD_DONE)
+        return; // More next loop, or publish failed: resume from the cursor
 
-                // Line 1: Humidity & Fan
-                lcd.setCursor(0, 1);
-                lcd.printf("Hum :%3d%%   Fan :%s", (int)currentHum, fanStatus ? "ON " : "OFF");
+    // Everything sent: retire this file. The generation bump makes the cursor
+    // invalid for it first, so a reset before remove() cannot re-send it.
+    if (ramBufferCount == 0)
+    {
+        logCursor = {logCursor.gen + 1, LOG_HEADER_SIZE};
+        saveLogCursor();
+        LittleFS.remove(LOG_FILE);
+        logFileBytes = 0;
+        hasOfflineData = false;
+        noteStorageUsage();
+        Serial.println("Old Offline Data Cleared");
+    }
+}
 
-                // Line 2: Soil & Pump
-                lcd.setCursor(0, 2);
-                lcd.printf("Soil:%3d%%   Pump:%s", soilMoisture, pumpStatus ? "ON " : "OFF");
+// Samples heap health once per telemetry record
+void updateHeapStats(uint32_t &freeBytes, uint32_t &largest, int &fragPct)
+{
+    freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (largest < heapLargestMin)
+        heapLargestMin = largest;
+    fragPct = freeBytes ? 100 - (int)((uint64_t)largest * 100 / freeBytes) : 0;
+}
 
-                // Line 3: CO2 & AWS Status
-                lcd.setCursor(0, 3);
-                if (awsConnected)
-                {
-                    lcd.printf("CO2 :%-4d   AWS :ON ", eco2);
-                }
-                else if (wifiConnected)
-                {
-                    lcd.printf("CO2 :%-4d   AWS :CON", eco2);
-                }
+// Snapshot of the current state in telemetry schema order
+void fillTelemetry(TelemetrySample &t, uint32_t heapFree, uint32_t heapLargest, int heapFrag, bool stacksOk)
+{
+    t.device_id = deviceId;
+    t.version = FIRMWARE_VERSION;
+    t.timestamp = currentEpoch(t.ts_src); // Acquisition time (0 if the clock is unknown)
+    t.ts_err = t.ts_src == 2 ? 0 : -1;
+    t.boot_id = bootId;
+    t.seq = ++recordSeq;
+    t.mono_ms = millis();
+    t.temp = currentTemp;
+    t.hum = currentHum;
+    t.vpd = vpdKPa(currentTemp, currentHum);
+    t.dew_point = dewPointC(currentTemp, currentHum);
+    t.soil = soilMoisture;
+    t.co2 = eco2;
+    t.tvoc = tvoc;
+    t.tank_level = waterTankLevel;
+    t.pump = pumpStatus;
+    t.fan = fanStatus;
+    t.heater = heaterStatus;
+    t.mode = manualMode ? "MANUAL" : "AUTO";
+    t.climate = CLIMATE_STRATEGY_NAMES[climateStrategy];
+    for (int i = 0; i < CS_COUNT; i++)
+        t.energy_wh[i] = climateWh[i];
+    t.sp_tmin = activeSp.tempMin;
+    t.sp_tmax = activeSp.tempMax;
+    t.sp_hmax = activeSp.humMax;
+    t.seg = activeSegment;
+    t.stage = activeStage;
+    t.clock = clockSource;
+    t.rules = ruleVM.ruleCount();
+    t.rules_us = ruleEvalUs;
+    t.aht_us = ahtAcqUs;
+    t.ens_us = ensAcqUs;
+    t.heap_free = heapFree;
+    t.heap_largest = heapLargest;
+    t.heap_largest_min = heapLargestMin;
+    t.heap_frag = heapFrag;
+    for (int i = 0; i < TASK_COUNT; i++)
+        t.stack_free[i] = tasks[i].minFree;
+    t.stack_ok = stacksOk;
+    t.recoveries = recoveryCount;
+    t.wifi_assoc_ms = wifiAssocMs;
+    t.wifi_dhcp_ms = wifiDhcpMs;
+    t.wifi_fast = wifiFastUsed;
+    t.lan = lanConnected;
+    t.ws_clients = webServerStarted ? ws.count() : 0;
+    t.ws_client_bytes = wsClientBytes;
+    for (int i = 0; i < BP_COUNT; i++)
+        t.boot_ms[i] = bootMs[i];
+    t.queue_depth = telemetryQueue.depth();
+    t.queue_max = telemetryQueue.maxDepth();
+    t.queue_drops = telemetryQueue.overflowCount();
+    t.event_drops = eventQueue.overflowCount();
+    t.event_corrupt = eventCorrupt;
+    for (int i = 0; i < CH_COUNT; i++)
+        t.sample_ms[i] = samplePeriodMs[i];
+    for (int i = 0; i < ACT_COUNT; i++)
+        t.switches[i] = actuatorSwitches[i];
+
+    t.zone_count = zoneConfigSnapshot().count;
+    t.water_total_ml = 0;
+    for (int i = 0; i < t.zone_count; i++)
+    {
+        t.water_total_ml += zoneTotalWaterMl[i];
+        t.zone_soil[i] = zoneMoisture[i];
+        t.zone_valve[i] = zoneValveOn[i];
+        t.zone_phase[i] = zonePhase[i];
+        t.zone_water[i] = zoneLastWaterMl[i];
+        t.zone_pulses[i] = zoneLastPulses[i];
+    }
+}
+
+#if TELEMETRY_BENCH
+// Schema writers vs the equivalent snprintf("%.1f") record, 100 runs each
+void benchTelemetry(const TelemetrySample &t)
+{
+    static char buf[TELEMETRY_JSON_MAX];
+    static uint8_t bin[TELEMETRY_BINARY_MAX];
+    const int runs = 100;
+    size_t jsonLen = 0, binLen = 0;
+
+    uint32_t t0 = micros();
+    for (int r = 0; r < runs; r++)
+    {
+        int len = snprintf(buf, sizeof(buf),
+                           "{\"device_id\": \"%s\", \"version\": \"%s\", \"timestamp\": %lu, \"temp\": %.1f, \"hum\": %.1f, \"soil\": %d, \"co2\": %d, \"tvoc\": %d, \"tank_level\": %d, \"pump\": %d, \"fan\": %d, \"heater\": %d, \"mode\": \"%s\", \"water_total_ml\": %.0f, \"sp_tmin\": %.1f, \"sp_tmax\": %.1f, \"sp_hmax\": %.1f, \"seg\": %d, \"stage\": %d, \"clock\": %d, \"rules\": %d, \"rules_us\": %lu, \"aht_us\": %lu, \"ens_us\": %lu, \"heap_free\": %lu, \"heap_largest\": %lu, \"heap_largest_min\": %lu, \"heap_frag\": %d, \"stack_free\": [%lu,%lu,%lu,%lu], \"stack_ok\": %d, \"zones\": {",
+                           t.device_id, t.version, (unsigned long)t.timestamp, t.temp, t.hum, t.soil, t.co2, t.tvoc,
+                           t.tank_level, t.pump, t.fan, t.heater, t.mode, t.water_total_ml, t.sp_tmin, t.sp_tmax,
+                           t.sp_hmax, t.seg, t.stage, t.clock, t.rules, (unsigned long)t.rules_us,
+                           (unsigned long)t.aht_us, (unsigned long)t.ens_us, (unsigned long)t.heap_free,
+                           (unsigned long)t.heap_largest, (unsigned long)t.heap_largest_min, t.heap_frag,
+                           (unsigned long)t.stack_free[0], (unsigned long)t.stack_free[1],
+                           (unsigned long)t.stack_free[2], (unsigned long)t.stack_free[3], t.stack_ok);
+        const char *keys[] = {"soil", "valve", "phase", "water_ml", "pulses"};
+        for (int k = 0; k < 5; k++)
+        {
+            len += snprintf(buf + len, sizeof(buf) - len, "%s\"%s\": [", k ? ", " : "", keys[k]);
+            for (int i = 0; i < t.zone_count; i++)
+            {
+                if (k == 3)
+                    len += snprintf(buf + len, sizeof(buf) - len, "%s%.0f", i ? "," : "", t.zone_water[i]);
                 else
                 {
-                    lcd.printf("CO2 :%-4d   AWS :OFF", eco2);
+                    const uint8_t *arr = k == 0 ? t.zone_soil : k == 1 ? t.zone_valve : k == 2 ? t.zone_phase : t.zone_pulses;
+                    len += snprintf(buf + len, sizeof(buf) - len, "%s%d", i ? "," : "", arr[i]);
                 }
             }
+            len += snprintf(buf + len, sizeof(buf) - len, "]");
         }
-
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        snprintf(buf + len, sizeof(buf) - len, "}}");
     }
+    uint32_t t1 = micros();
+    for (int r = 0; r < runs; r++)
+        jsonLen = writeTelemetryJson(t, buf, sizeof(buf));
+    uint32_t t2 = micros();
+    for (int r = 0; r < runs; r++)
+        binLen = writeTelemetryBinary(t, bin, sizeof(bin));
+    uint32_t t3 = micros();
+
+    Serial.printf("Telemetry bench: snprintf %lu us, json %lu us (%u B), binary %lu us (%u B)\n",
+                  (unsigned long)(t1 - t0) / runs, (unsigned long)(t2 - t1) / runs, (unsigned)jsonLen,
+                  (unsigned long)(t3 - t2) / runs, (unsigned)binLen);
 }
+#endif
 
-// --- DATA LOGGING HELPER FUNCTIONS ---
-String ramBuffer = "";
-int ramBufferCount = 0;
-const int RAM_BUFFER_SIZE = 50; // Write to flash every ~4 minutes (50 * 5s)
+// --- TASK SUPERVISOR (recovery steps) ---
+// Frees a bus held low by a slave that lost a clock edge mid-byte: nine SCL
+// pulses let it finish the byte, then a STOP releases it.
+bool i2cBusReset()
+{
+    if (xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(I2C_RESET_WAIT_MS)) != pdTRUE)
+        return false; // The stalled task is holding the bus
+    Wire.end();
+    pinMode(PIN_SDA, INPUT_PULLUP);
+    pinMode(PIN_SCL, OUTPUT_OPEN_DRAIN);
+    for (int i = 0; i < 9 && digitalRead(PIN_SDA) == LOW; i++)
+    {
+        digitalWrite(PIN_SCL, LOW);
+        delayMicroseconds(5);
+        digitalWrite(PIN_SCL, HIGH);
+        delayMicroseconds(5);
+    }
+    pinMode(PIN_SDA, OUTPUT_OPEN_DRAIN);
+    digitalWrite(PIN_SDA, LOW);
+    delayMicroseconds(5);
+    digitalWrite(PIN_SCL, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(PIN_SDA, HIGH);
+    delayMicroseconds(5);
 
-void flushRamBuffer()
+    Wire.begin(PIN_SDA, PIN_SCL);
+    Wire.setTimeOut(3000);
+    lcd.init(); // A glitch on the bus desyncs the LCD's 4-bit interface
+    lcd.backlight();
+    xSemaphoreGive(i2cMutex);
+    return true;
+}
+
+// Recreates a task on its static stack. The task is asked to stop and parks
+// itself at its safe point, so it is never deleted while holding one of our
+// mutexes or a LittleFS, NVS or lwIP lock we cannot see. A task that does not
+// get there in time is left running and the ladder moves on to the reboot.
+bool restartTask(TaskId id)
 {
-    if (ramBufferCount > 0)
+    TaskSlot &t = tasks[id];
+    portENTER_CRITICAL(&taskStopMux);
+    t.stopRequest = true;
+    portEXIT_CRITICAL(&taskStopMux);
+    uint32_t start = millis();
+    while (!t.parked || eTaskGetState(t.handle) != eSuspended)
     {
-        File file = LittleFS.open("/offline_log.txt", FILE_APPEND);
-        if (!file)
+        if (millis() - start >= TASK_STOP_WAIT_MS)
         {
-            Serial.println("Failed to open log file for flushing");
-            return;
+            // Withdraw the request unless the task has already taken it
+            portENTER_CRITICAL(&taskStopMux);
+            bool parked = t.parked;
+            t.stopRequest = parked;
+            portEXIT_CRITICAL(&taskStopMux);
+            if (!parked)
+                return false;
         }
-        file.print(ramBuffer);
-        file.close();
-        Serial.println("RAM Buffer Flushed to Flash");
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    esp_task_wdt_delete(t.handle);
+    vTaskDelete(t.handle);
+    // A suspended task is not running on either core, so it is freed at once;
+    // check before its TCB and stack are reused
+    start = millis();
+    while (eTaskGetState(t.handle) != eDeleted)
+    {
+        if (millis() - start >= TASK_STOP_WAIT_MS)
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
 
-        ramBuffer = "";
-        ramBufferCount = 0;
-        hasOfflineData = true;
+    if (id == TASK_AWS)
+    {
+        // The TLS session was owned by the deleted task (its WiFiManager leaks a little heap)
+        net.stop();
+        awsConnected = false;
     }
+    return startTask(id, t.fn, t.priority, t.core) != NULL;
 }
 
-void logDataOffline(const char *jsonString)
+// Last step. Saves the cause for an alert after boot and keeps the records
+// still in RAM. Other tasks are stopped first so nothing appends meanwhile; if
+// one of them was holding the filesystem lock the flush blocks and the
+// hardware watchdog reboots instead.
+void supervisorReboot(TaskId id)
 {
-    // Buffer in RAM first
-    ramBuffer += String(jsonString) + "\n";
-    ramBufferCount++;
+    preferences.putUChar("sup_reboot", id + 1);
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        if (i != TASK_SUPERVISOR && tasks[i].handle)
+            vTaskSuspend(tasks[i].handle);
+    }
+    if (ramBufferCount > 0)
+        flushRamBuffer();
+    ESP.restart();
+}
 
-    Serial.printf("Offline Data Buffered: %d/%d\n", ramBufferCount, RAM_BUFFER_SIZE);
+bool runRecovery(TaskId id, RecoveryStep step)
+{
+    switch (step)
+    {
+    case RS_I2C_RESET:
+        return i2cBusReset();
+    case RS_MQTT_RESTART:
+        mqttRestartRequest = true; // Handled by the connectivity task if it is still looping
+        return true;
+    case RS_TASK_RESTART:
+        return restartTask(id);
+    case RS_REBOOT:
+        supervisorReboot(id);
+        return false;
+    default:
+        return true;
+    }
+}
 
-    // Only write to Flash if buffer is full
-    if (ramBufferCount >= RAM_BUFFER_SIZE)
+// Called by the connectivity task (owner of the MQTT client)
+bool publishAlert(const SupervisorAlert &a)
+{
+    char topic[50];
+    snprintf(topic, sizeof(topic), "greenhouse/%s/alerts", deviceId);
+    const char *task = a.task < TASK_COUNT ? tasks[a.task].name : "?";
+    const char *action = RECOVERY_STEP_NAMES[a.step <= RS_REBOOT ? a.step : RS_NONE];
+    char text[96];
+    const char *alert;
+    if (a.recovered)
     {
-        flushRamBuffer();
+        alert = "TASK_RECOVERED";
+        snprintf(text, sizeof(text), "%s responding again after %s.", task, action);
+    }
+    else if (a.step == RS_REBOOT)
+    {
+        alert = "SUPERVISOR_REBOOT";
+        snprintf(text, sizeof(text), "Rebooted after %s stopped responding.", task);
     }
+    else
+    {
+        alert = "TASK_STALLED";
+        snprintf(text, sizeof(text), "%s stalled for %lu s: %s %s.", task, (unsigned long)(a.stalledMs / 1000), action,
+                 a.ok ? "done" : "not possible");
+    }
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "{\"alert\": \"%s\", \"task\": \"%s\", \"action\": \"%s\", \"ok\": %s, \"stalled_ms\": %lu, "
+             "\"message\": \"%s\", \"timestamp\": %lu}",
+             alert, task, action, a.ok ? "true" : "false", (unsigned long)a.stalledMs, text,
+             (unsigned long)time(nullptr));
+    return client.publish(topic, msg);
 }
 
-void processOfflineData()
+// --- DEVICE SHADOW ---
+// Reported state: what the device is actually running, after validation. Keys
+// match the desired document; structured settings are reported by size. A
+// version with rejected keys is named with the keys, and a desired document
+// that did not parse with the parser's error.
+bool publishShadowReport()
 {
-    if (!hasOfflineData)
-        return; // Skip if we know there's nothing
+    char topic[64];
+    snprintf(topic, sizeof(topic), "greenhouse/%s/shadow/reported", deviceId);
+    static char msg[1024]; // Connectivity task only
+    int n = snprintf(msg, sizeof(msg),
+                     "{\"version\": %lu, \"state\": {\"temp_min\": %.1f, \"temp_max\": %.1f, \"hum_max\": %.1f, "
+                     "\"soil_dry\": %d, \"soil_wet\": %d, \"tank_empty_dist\": %d, \"tank_full_dist\": %d, "
+                     "\"cal_air\": %d, \"cal_water\": %d, \"irrigation_mode\": \"%s\", \"pulse_on\": %d, "
+                     "\"soak_time\": %d, \"pump_flow\": %d, \"fan_w\": %d, \"heater_w\": %d, \"tz_offset\": %d, "
+                     "\"max_valves\": %d, \"zone_count\": %d, \"schedule_segments\": %d, \"rule_count\": %d, "
+                     "\"lan_mode\": \"%s\"}",
+                     (unsigned long)shadowVersion, TEMP_MIN_NIGHT, TEMP_MAX_DAY, HUM_MAX, SOIL_DRY, SOIL_WET,
+                     TANK_EMPTY_DIST, TANK_FULL_DIST, AIR_VAL, WATER_VAL, PULSE_SOAK_MODE ? "pulse" : "continuous",
+                     PULSE_ON_SEC, SOAK_SEC, PUMP_FLOW_MLPM, FAN_WATTS, HEATER_WATTS, TZ_OFFSET_MIN, MAX_ACTIVE_VALVES,
+                     zoneConfigSnapshot().count, schedule.data.segmentCount, ruleVM.ruleCount(), LAN_MODE_NAMES[lanCfg.mode]);
+    if (shadowRejected[0])
+        n += snprintf(msg + n, sizeof(msg) - n, ", \"rejected_version\": %lu, \"rejected\": [%s]",
+                      (unsigned long)shadowRejectedVersion, shadowRejected);
+    if (shadowError[0])
+        n += snprintf(msg + n, sizeof(msg) - n, ", \"error\": \"%s\"", shadowError);
+    snprintf(msg + n, sizeof(msg) - n, "}");
+    bool ok = client.publish(topic, msg);
+    if (ok)
+        mqttPublishes++;
+    else
+        mqttPublishFails++;
+    return ok;
+}
 
-    bool foundProcessing = false;
-    bool foundLog = false;
+// Relay state right after a manual command, to every connected broker
+void publishCommandAck(const CommandAck &a)
+{
+    char topic[50];
+    snprintf(topic, sizeof(topic), "greenhouse/%s/ack", deviceId);
+    char msg[192];
+    snprintf(msg, sizeof(msg),
+             "{\"id\": \"%s\", \"latency_us\": %lu, \"pump\": %d, \"fan\": %d, \"heater\": %d, \"mode\": \"%s\", "
+             "\"timestamp\": %lu}",
+             a.id, (unsigned long)a.latencyUs, a.pump, a.fan, a.heater, a.manual ? "MANUAL" : "AUTO",
+             (unsigned long)time(nullptr));
+    if (client.connected())
+        client.publish(topic, msg);
+    if (lanConnected)
+        lanClient.publish(topic, msg);
+}
 
-    // Use directory listing to check for files to avoid "does not exist" error logs
-    File root = LittleFS.open("/");
-    if (!root)
-        return;
+// Asks the backend for every desired change after the version applied here
+bool requestShadowDelta()
+{
+    char topic[64];
+    snprintf(topic, sizeof(topic), "greenhouse/%s/shadow/get", deviceId);
+    char msg[32];
+    snprintf(msg, sizeof(msg), "{\"version\": %lu}", (unsigned long)shadowVersion);
+    return client.publish(topic, msg);
+}
 
-    File file = root.openNextFile();
-    while (file)
+// --- WIFI FAST RECONNECT ---
+// Runs on the WiFi event task: timestamps association and address assignment
+void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info)
+{
+    uint32_t now = millis();
+    if (event == ARDUINO_EVENT_WIFI_STA_CONNECTED)
     {
-        String fileName = file.name();
-        if (fileName.indexOf("processing.txt") >= 0)
-            foundProcessing = true;
-        if (fileName.indexOf("offline_log.txt") >= 0)
-            foundLog = true;
-        file = root.openNextFile();
+        wifiAssocAt = now;
+        wifiAssocMs = now - wifiBeginAt > UINT16_MAX ? UINT16_MAX : now - wifiBeginAt;
     }
-    root.close();
-
-    // If neither file exists, update flag and return
-    if (!foundProcessing && !foundLog)
+    else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
     {
-        hasOfflineData = false;
-        return;
+        wifiDhcpMs = now - wifiAssocAt > UINT16_MAX ? UINT16_MAX : now - wifiAssocAt;
+        if (wifiDhcpPending)
+        {
+            wifiDhcpPending = false;
+            wifiLeaseRenewed = true;
+        }
     }
+}
 
-    // 1. Check if we have a pending processing file from a previous failed attempt
-    if (foundProcessing)
+void loadWifiCache()
+{
+    if (wifiCache.magic == WIFI_CACHE_MAGIC)
+        return; // Still in RTC memory from before a reset
+    if (preferences.getBytes("wifi_cache", &wifiCache, sizeof(wifiCache)) != sizeof(wifiCache) ||
+        wifiCache.magic != WIFI_CACHE_MAGIC)
+        wifiCache.magic = 0;
+}
+
+// Records the current AP and lease; NVS is only written when they change
+void saveWifiCache()
+{
+    WifiCache c = {};
+    c.magic = WIFI_CACHE_MAGIC;
+    uint8_t *bssid = WiFi.BSSID();
+    if (bssid)
+        memcpy(c.bssid, bssid, sizeof(c.bssid));
+    c.channel = WiFi.channel();
+    c.ip = WiFi.localIP();
+    c.gateway = WiFi.gatewayIP();
+    c.subnet = WiFi.subnetMask();
+    c.dns = WiFi.dnsIP(0);
+    if (!bssid || c.ip == 0 || memcmp(&c, &wifiCache, sizeof(c)) == 0)
+        return;
+    wifiCache = c;
+    preferences.putBytes("wifi_cache", &wifiCache, sizeof(wifiCache));
+}
+
+// Starts a connect with the credentials WiFiManager stored. `fast` goes
+// straight to the cached BSSID/channel with the cached address; otherwise
+// the driver scans and DHCP runs. Returns false if never provisioned.
+bool wifiBegin(bool fast)
+{
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK || conf.sta.ssid[0] == 0)
+        return false;
+    char ssid[33] = {0}, pass[65] = {0};
+    memcpy(ssid, conf.sta.ssid, 32);
+    memcpy(pass, conf.sta.password, 64);
+
+    fast = fast && wifiCache.magic == WIFI_CACHE_MAGIC;
+    if (fast)
+        WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet),
+                    IPAddress(wifiCache.dns));
+    else
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // Back to DHCP
+    wifiFastUsed = fast;
+    wifiDhcpPending = false;
+    wifiBeginAt = millis();
+    WiFi.begin(ssid, pass, fast ? wifiCache.channel : 0, fast ? wifiCache.bssid : NULL);
+    return true;
+}
+
+// --- LAN BROKER ---
+// Keeps the LAN client connected when the configured mode calls for it.
+// Called from the connectivity task while WiFi is up.
+void serviceLanBroker()
+{
+    static unsigned long awsDownSince = 0;
+    static unsigned long lastLanAttempt = 0;
+    if (awsConnected)
+        awsDownSince = 0;
+    else if (awsDownSince == 0)
+        awsDownSince = millis() ? millis() : 1;
+
+    bool want = lanCfg.mode == LAN_ALWAYS ||
+                (lanCfg.mode == LAN_FALLBACK && awsDownSince && millis() - awsDownSince >= lanCfg.failoverMs);
+    if (!want)
     {
-        File file = LittleFS.open("/processing.txt", FILE_READ);
-        if (file)
+        if (lanClient.connected())
         {
-            Serial.println("Retrying Offline Data Upload...");
-            bool allSent = true;
-            while (file.available())
-            {
-                String line = file.readStringUntil('\n');
-                line.trim();
-                if (line.length() > 0)
-                {
-                    char topic[50];
-                    snprintf(topic, sizeof(topic), "greenhouse/%s/data", deviceId);
-                    if (!client.connected() || !client.publish(topic, line.c_str()))
-                    {
-                        allSent = false;
-                        break;
-                    }
-                    delay(50);
-                }
-            }
-            file.close();
-            if (allSent)
-            {
-                LittleFS.remove("/processing.txt");
-                Serial.println("Old Offline Data Cleared");
-            }
-            else
-            {
-                return; // Stop if we failed again
-            }
+            lanClient.disconnect();
+            Serial.println("LAN Broker: Standby (AWS is back)");
         }
+        lanConnected = false;
+        return;
+    }
+    if (lanClient.connected())
+    {
+        lanConnected = true;
+        lanClient.loop();
+        return;
     }
 
-    // 2. Check for new offline data
-    if (foundLog)
+    lanConnected = false;
+    if (lastLanAttempt != 0 && millis() - lastLanAttempt < LAN_RETRY_MS)
+        return;
+    lastLanAttempt = millis();
+    if (lanClient.getBufferSize() != MQTT_BUFFER_SIZE)
+        lanClient.setBufferSize(MQTT_BUFFER_SIZE); // Commands carry rule bytecode here too
+    lanClient.setServer(lanCfg.host, lanCfg.port);
+    lanClient.setCallback(messageHandler);
+    Serial.printf("LAN Broker Connecting to %s:%u...", lanCfg.host, lanCfg.port);
+    bool ok = lanCfg.user[0] ? lanClient.connect(deviceId, lanCfg.user, lanCfg.pass) : lanClient.connect(deviceId);
+    if (ok)
+    {
+        Serial.println("CONNECTED");
+        char topic[50];
+        snprintf(topic, sizeof(topic), "greenhouse/%s/commands", deviceId);
+        lanClient.subscribe(topic);
+        lanConnected = true;
+    }
+    else
     {
-        LittleFS.rename("/offline_log.txt", "/processing.txt");
-        // Recursive call to process the newly renamed file
-        processOfflineData();
+        Serial.print("Failed: ");
+        Serial.println(lanClient.state());
     }
 }
 
@@ -850,6 +3795,15 @@ void configModeCallback(WiFiManager *myWiFiManager)
 
 void TaskConnectivity(void *pvParameters)
 {
+    // Storage, the WiFi event hook and the LAN server outlive this task. A
+    // supervisor restart runs this preamble again and must not repeat them.
+    static bool started = false;
+    if (!started)
+    {
+        initStorage();
+        WiFi.onEvent(onWiFiEvent);
+    }
+
     WiFiManager wm;
     wm.setAPCallback(configModeCallback);
 
@@ -862,19 +3816,53 @@ void TaskConnectivity(void *pvParameters)
     wm.setEnableConfigPortal(false);   // Disable auto-AP on failure
     wm.setConfigPortalBlocking(false); // Ensure portal is non-blocking if we start it later
 
-    Serial.println("Attempting WiFi Connection...");
-    // FIX: Added password for security
-    if (!wm.autoConnect("Greenhouse-Setup", "password123"))
+    WiFi.mode(WIFI_STA);
+    if (!started)
+        startLanServer(); // Listens on every interface, so it is ready when WiFi is
+    started = true;
+    loadWifiCache();
+
+    // After a restart the link may still be up; keep it rather than reconnecting
+    bool fastOk = WiFi.status() == WL_CONNECTED;
+
+    // Known AP: connect directly, skipping WiFiManager's scan and DHCP
+    if (!fastOk && wifiCache.magic == WIFI_CACHE_MAGIC && wifiBegin(true))
+    {
+        unsigned long t0 = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - t0 < WIFI_FAST_TIMEOUT_MS)
+            vTaskDelay(20 / portTICK_PERIOD_MS);
+        fastOk = WiFi.status() == WL_CONNECTED;
+        if (!fastOk)
+        {
+            WiFi.disconnect();
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        }
+    }
+
+    if (fastOk)
     {
-        Serial.println("WiFi not connected. Running in Offline Mode.");
-        // Ensure we are in STA mode to allow background reconnection attempts
-        WiFi.mode(WIFI_STA);
+        Serial.println("WiFi Connected! (cached AP)");
+        wifiConnected = true;
     }
     else
     {
-        Serial.println("WiFi Connected!");
-        wifiConnected = true;
+        Serial.println("Attempting WiFi Connection...");
+        wifiFastUsed = false;
+        wifiBeginAt = millis();
+        // FIX: Added password for security
+        if (!wm.autoConnect("Greenhouse-Setup", "password123"))
+        {
+            Serial.println("WiFi not connected. Running in Offline Mode.");
+            // Ensure we are in STA mode to allow background reconnection attempts
+            WiFi.mode(WIFI_STA);
+        }
+        else
+        {
+            Serial.println("WiFi Connected!");
+            wifiConnected = true;
+        }
     }
+    WiFi.setAutoReconnect(false); // Reconnects are driven below (cached AP first)
     portalRunning = false;
 
     // Load AWS Certificates
@@ -883,14 +3871,33 @@ void TaskConnectivity(void *pvParameters)
     net.setPrivateKey(AWS_CERT_PRIVATE);
 
     client.setServer(AWS_IOT_ENDPOINT, 8883);
+    client.setBufferSize(MQTT_BUFFER_SIZE); // Default 256 B drops schedule / rules commands
     client.setCallback(messageHandler);
 
     esp_task_wdt_add(NULL); // Add to WDT
+    bool linkUp = false;
+    unsigned long linkUpAt = 0;
+    uint8_t wifiRetryPhase = 0; // 0 = cached AP, 1 = full scan, 2 = pause
+    unsigned long wifiRetryAt = 0;
+    uint32_t wifiBackoff = WIFI_RETRY_MIN_MS;
 
     for (;;)
     {
         esp_task_wdt_reset(); // Feed WDT
+        heartbeat(TASK_AWS);
+        taskSafePoint(TASK_AWS);
+        wakeCount++;
         wm.process();         // Process WiFiManager (Non-blocking)
+
+        if (mqttRestartRequest)
+        {
+            // Supervisor step: drop the session and let the loop below reconnect
+            mqttRestartRequest = false;
+            Serial.println("Supervisor: restarting MQTT client");
+            client.disconnect();
+            net.stop();
+            awsConnected = false;
+        }
         portalRunning = wm.getConfigPortalActive();
 
         if (reconfigureWiFi)
@@ -914,32 +3921,95 @@ void TaskConnectivity(void *pvParameters)
         // Run Cloud tasks if WiFi is Connected (Even if Portal is running)
         if (WiFi.status() == WL_CONNECTED)
         {
+            if (!linkUp)
+            {
+                linkUp = true;
+                linkUpAt = millis();
+                markBoot(BP_WIFI);
+                Serial.printf("WiFi Up: assoc %u ms, dhcp %u ms (%s)\n", wifiAssocMs, wifiDhcpMs,
+                              wifiFastUsed ? "cached AP" : "scan");
+                if (wifiFastUsed)
+                {
+                    // The cached address may have been handed to someone else since;
+                    // get a real lease before NTP or TLS open anything on it
+                    wifiDhcpPending = true;
+                    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+                }
+                else
+                    saveWifiCache();
+                wifiRetryPhase = 0;
+                wifiRetryAt = millis();
+                wifiBackoff = WIFI_RETRY_MIN_MS;
+                WiFi.setSleep(pmMode ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE); // Light sleep requires modem sleep
+                // NTP Time Sync (Required for AWS SSL). Started once per link-up:
+                // SNTP retries by itself, and restarting it every loop delays the sync.
+                if (time(nullptr) < (time_t)EPOCH_VALID)
+                    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+            }
             wifiConnected = true;
+            if (wifiLeaseRenewed)
+            {
+                wifiLeaseRenewed = false;
+                Serial.printf("DHCP Lease: %s\n", WiFi.localIP().toString().c_str());
+                saveWifiCache();
+            }
 
-            // NTP Time Sync (Required for AWS SSL)
             time_t now = time(nullptr);
-            if (now < 8 * 3600 * 2)
+            if (now > (time_t)EPOCH_VALID)
             {
-                configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+                static bool anchored = false;
+                if (!anchored)
+                {
+                    anchored = true;
+                    markBoot(BP_NTP);
+                    anchorBootClock((uint32_t)now);
+                }
+
+                // Persist wall time so the scheduler has a fallback clock after a power cut
+                static unsigned long lastEpochSave = 0;
+                if (lastEpochSave == 0 || millis() - lastEpochSave > EPOCH_SAVE_MS)
+                {
+                    lastEpochSave = millis();
+                    preferences.putULong("last_epoch", (uint32_t)now);
+
+                    // Relay wear survives reboots; an hour of switches is lost at most
+                    uint32_t switches[ACT_COUNT];
+                    for (int i = 0; i < ACT_COUNT; i++)
+                        switches[i] = actuatorSwitches[i];
+                    preferences.putBytes("act_switches", switches, sizeof(switches));
+                }
             }
 
             if (!client.connected())
             {
                 awsConnected = false;
                 // Only try to connect to AWS occasionally to avoid spamming logs/blocking
+                // Wait for NTP first: a handshake before the clock is set fails
+                // certificate validation and then costs a full retry interval.
                 static unsigned long lastAwsAttempt = 0;
-                if (millis() - lastAwsAttempt > 5000)
+                bool clockOk = now > (time_t)EPOCH_VALID || millis() - linkUpAt > NTP_WAIT_MS;
+                if (clockOk && !wifiDhcpPending && (lastAwsAttempt == 0 || millis() - lastAwsAttempt > 5000))
                 {
                     lastAwsAttempt = millis();
                     Serial.print("AWS Connecting...");
+                    pmAcquire(pmTls);
                     if (client.connect(deviceId))
                     {
+                        mqttConnects++;
                         Serial.println("CONNECTED");
+                        markBoot(BP_MQTT);
                         char topic[50];
                         snprintf(topic, sizeof(topic), "greenhouse/%s/commands", deviceId);
                         client.subscribe(topic);
+                        snprintf(topic, sizeof(topic), "greenhouse/%s/shadow/desired", deviceId);
+                        client.subscribe(topic);
                         awsConnected = true;
 
+                        // Catch up on config changed while offline, and tell the
+                        // backend what is running now
+                        requestShadowDelta();
+                        shadowReportPending = true;
+
                         // FIX: Mark boot as successful (reset crash count)
                         if (preferences.getInt("crash_count", 0) > 0)
                         {
@@ -962,77 +4032,269 @@ void TaskConnectivity(void *pvParameters)
                                 Serial.println("Rollback Alert Publish FAILED");
                             }
                         }
+
+                        // --- REPORT SUPERVISOR REBOOT ---
+                        uint8_t rebootTask = preferences.getUChar("sup_reboot", 0);
+                        if (rebootTask && publishAlert({(uint8_t)(rebootTask - 1), RS_REBOOT, false, true, 0}))
+                            preferences.remove("sup_reboot");
                     }
                     else
                     {
+                        mqttConnectFails++;
                         Serial.print("Failed: ");
                         Serial.println(client.state());
                     }
+                    pmRelease(pmTls);
                 }
             }
             else
             {
                 awsConnected = true;
                 client.loop();
+
+                if (shadowReportPending && publishShadowReport())
+                    shadowReportPending = false;
+
+                SupervisorAlert alert;
+                while (alertQueue.pop(alert))
+                    publishAlert(alert);
             }
+
+            serviceLanBroker();
+
+            CommandAck ack;
+            while (ackQueue.pop(ack))
+                publishCommandAck(ack);
         }
         else
         {
             // WiFi Lost
+            linkUp = false;
+            lanConnected = false;
             if (!portalRunning)
             {
                 wifiConnected = false;
                 awsConnected = false;
 
                 // --- SELF-HEALING: Auto-Reconnect Strategy ---
-                // If the router was off during boot (Power Cut), the ESP32 enters Offline Mode.
-                // We need to periodically check if the router is back online.
-                static unsigned long lastWifiRetry = 0;
-                if (millis() - lastWifiRetry > 30000)
-                { // Check every 30 seconds
-                    lastWifiRetry = millis();
-                    Serial.println("Offline: Attempting background reconnection...");
-
-                    // This forces the ESP32 to try connecting with saved credentials
-                    WiFi.reconnect();
+                // Each round tries the cached AP directly (a brief AP drop comes
+                // back in well under a second), then a full scan with DHCP (AP
+                // moved channel, new router), then pauses. The pause doubles up
+                // to 30 s so a long outage (router off after a power cut) costs
+                // little radio time.
+                if ((long)(millis() - wifiRetryAt) >= 0)
+                {
+                    if (wifiRetryPhase == 0)
+                    {
+                        // Without a cache this is already a full scan; unprovisioned: just pause
+                        bool started = wifiBegin(true);
+                        if (started)
+                            Serial.println(wifiFastUsed ? "Offline: Reconnecting to cached AP..." : "Offline: Scanning for AP...");
+                        wifiRetryAt = millis() + (!started ? 0 : wifiFastUsed ? WIFI_FAST_TIMEOUT_MS : WIFI_SCAN_TIMEOUT_MS);
+                        wifiRetryPhase = started && wifiFastUsed ? 1 : 2;
+                    }
+                    else if (wifiRetryPhase == 1)
+                    {
+                        Serial.println("Offline: Scanning for AP...");
+                        wifiBegin(false);
+                        wifiRetryAt = millis() + WIFI_SCAN_TIMEOUT_MS;
+                        wifiRetryPhase = 2;
+                    }
+                    else
+                    {
+                        WiFi.disconnect();
+                        wifiRetryAt = millis() + wifiBackoff;
+                        wifiBackoff = wifiBackoff * 2 > WIFI_RETRY_MAX_MS ? WIFI_RETRY_MAX_MS : wifiBackoff * 2;
+                        wifiRetryPhase = 0;
+                    }
                 }
             }
         }
 
         // Unified Data Logging & Publishing (Runs regardless of WiFi)
-        static unsigned long lastDataGen = 0;
-        if (millis() - lastDataGen > 5000)
+        // Records are captured by TaskSampler; this task only drains and sends.
+        static char jsonBuffer[TELEMETRY_JSON_MAX]; // Worst case of the schema (all zones, longest strings)
+        TelemetrySample sample;
+        bool published = false;
+        bool sending = awsConnected && (telemetryQueue.depth() > 0 || eventQueue.depth() > 0 || hasOfflineData);
+        if (sending)
+            pmAcquire(pmTls);
+
+        // Actuator transitions, as they happen (offline log while AWS is down)
+        ActuatorEvent event;
+        while (eventQueue.pop(event))
+        {
+            char topic[50];
+            snprintf(topic, sizeof(topic), "greenhouse/%s/events", deviceId);
+            char json[EVENT_JSON_MAX];
+            rebaseTimestamp(event.bootId, event.tUs / 1000, event.tsSrc, event.timestamp, event.tsErr);
+            if (!writeEventJson(event, ACTUATOR_NAMES, json, sizeof(json)))
+            {
+                eventCorrupt++;
+                Serial.printf("Event %lu Not Encoded: dropped\n", (unsigned long)event.seq);
+                continue;
+            }
+            if (lanConnected)
+                lanClient.publish(topic, json);
+            if (wifiConnected && awsConnected && client.publish(topic, json))
+                mqttPublishes++;
+            else
+                logEventOffline(event);
+        }
+        while (telemetryQueue.pop(sample))
         {
-            char jsonBuffer[512]; // Increased buffer size
-            snprintf(jsonBuffer, sizeof(jsonBuffer),
-                     "{\"device_id\": \"%s\", \"version\": \"%s\", \"timestamp\": %lu, \"temp\": %.1f, \"hum\": %.1f, \"soil\": %d, \"co2\": %d, \"tvoc\": %d, \"tank_level\": %d, \"pump\": %d, \"fan\": %d, \"heater\": %d, \"mode\": \"%s\"}",
-                     deviceId, FIRMWARE_VERSION, (unsigned long)time(nullptr),
-                     currentTemp, currentHum, soilMoisture, eco2, tvoc, waterTankLevel,
-                     pumpStatus ? 1 : 0, fanStatus ? 1 : 0, heaterStatus ? 1 : 0,
-                     manualMode ? "MANUAL" : "AUTO");
+            rebaseTimestamp(sample.boot_id, sample.mono_ms, sample.ts_src, sample.timestamp, sample.ts_err);
+            size_t jsonLen = writeTelemetryJson(sample, jsonBuffer, sizeof(jsonBuffer));
+#if TELEMETRY_BENCH
+            benchTelemetry(sample);
+#endif
 
-            if (wifiConnected && awsConnected)
+            char topic[50];
+            snprintf(topic, sizeof(topic), "greenhouse/%s/data", deviceId);
+#if TELEMETRY_BINARY
+            static uint8_t binBuffer[TELEMETRY_BINARY_MAX];
+            size_t binLen = writeTelemetryBinary(sample, binBuffer, sizeof(binBuffer));
+            bool encoded = binLen > 0;
+#else
+            bool encoded = jsonLen > 0;
+#endif
+            if (!encoded)
             {
-                char topic[50];
-                snprintf(topic, sizeof(topic), "greenhouse/%s/data", deviceId);
-                client.publish(topic, jsonBuffer);
-                Serial.println("Published Data");
+                // Only a string over TELEMETRY_STR_MAX gets here: keep the
+                // record for the backlog rather than publish a broken one
+                Serial.println("Telemetry record too large to publish, logged offline");
+                logDataOffline(sample);
+                continue;
+            }
 
-                // Flush any pending RAM buffer to disk so it can be uploaded
-                if (ramBufferCount > 0)
-                    flushRamBuffer();
+            // Live copy for the site network; AWS still gets every record
+            // (directly below, or from the offline log once it is back)
+            if (lanConnected)
+            {
+#if TELEMETRY_BINARY
+                lanClient.publish(topic, binBuffer, binLen);
+#else
+                lanClient.publish(topic, jsonBuffer);
+#endif
+            }
 
-                // Also check for offline data upload here
-                processOfflineData();
+            if (wifiConnected && awsConnected)
+            {
+#if TELEMETRY_BINARY
+                bool ok = client.publish(topic, binBuffer, binLen);
+#else
+                bool ok = client.publish(topic, jsonBuffer);
+#endif
+                if (!ok)
+                {
+                    // Still "connected" but the send failed: keep the record
+                    mqttPublishFails++;
+                    logDataOffline(sample);
+                    continue;
+                }
+                mqttPublishes++;
+                Serial.println("Published Data");
+                published = true;
+                if (bootMs[BP_PUBLISH] == 0)
+                {
+                    markBoot(BP_PUBLISH);
+                    printBootReport();
+                }
             }
             else
             {
                 // If AWS is down (even if WiFi is up), log locally
-                logDataOffline(jsonBuffer);
+                logDataOffline(sample);
             }
-            lastDataGen = millis();
         }
 
+        // Flush any pending RAM buffer to disk so it can be uploaded
+        if (published && ramBufferCount > 0)
+            flushRamBuffer();
+
+        // Backlog goes up one bounded batch per loop, after the live queues
+        if (wifiConnected && awsConnected && hasOfflineData)
+            processOfflineData();
+        if (sending)
+            pmRelease(pmTls);
+
         vTaskDelay(50 / portTICK_PERIOD_MS); // Yield to other tasks
     }
-}
\ No newline at end of file
+}
+
+// --- TASK 5: TELEMETRY SAMPLER ---
+// Captures a record every TELEMETRY_PERIOD_MS on a fixed cadence, independent
+// of how long connect/TLS/upload take on the other core. The timestamp is the
+// acquisition time, not the publish time.
+void TaskSampler(void *pvParameters)
+{
+    esp_task_wdt_add(NULL); // Add to WDT
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TELEMETRY_PERIOD_MS));
+        esp_task_wdt_reset(); // Feed WDT
+        heartbeat(TASK_SAMPLER);
+        taskSafePoint(TASK_SAMPLER);
+        wakeCount++;
+
+        uint32_t heapFree, heapLargest;
+        int heapFrag;
+        updateHeapStats(heapFree, heapLargest, heapFrag);
+        bool stacksOk = updateStackStats();
+#if STACK_PROFILING
+        printStackReport();
+#endif
+        TelemetrySample sample;
+        fillTelemetry(sample, heapFree, heapLargest, heapFrag, stacksOk);
+        sample.pm = pmMode;
+        sample.current_ma = estimateCurrentMa(sample.wakes);
+        if (!telemetryQueue.push(sample))
+            Serial.println("Telemetry queue full, record dropped");
+    }
+}
+
+// --- TASK 6: SUPERVISOR ---
+// Checks every task's heartbeat and walks stalled tasks up the recovery
+// ladder (task_supervisor.h). Each step goes to the alerts topic.
+void TaskSupervisor(void *pvParameters)
+{
+    esp_task_wdt_add(NULL); // Add to WDT (nothing else watches the supervisor)
+    uint32_t start = millis();
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        taskWatch[i].lastBeat = tasks[i].heartbeat;
+        taskWatch[i].beatAt = start;
+    }
+
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SUPERVISOR_PERIOD_MS));
+        esp_task_wdt_reset(); // Feed WDT
+        wakeCount++;
+
+        uint32_t now = millis();
+        for (int i = 0; i < TASK_COUNT; i++)
+        {
+            TaskWatch &w = taskWatch[i];
+            uint32_t stalledMs = now - w.beatAt;
+            RecoveryStep recoveredFrom;
+            RecoveryStep step = superviseTask(w, tasks[i].heartbeat, now, RECOVERY_WAIT_MS, recoveredFrom);
+            if (recoveredFrom != RS_NONE)
+            {
+                Serial.printf("Supervisor: %s recovered after %s\n", tasks[i].name, RECOVERY_STEP_NAMES[recoveredFrom]);
+                alertQueue.push({(uint8_t)i, (uint8_t)recoveredFrom, true, true, stalledMs});
+            }
+            if (step == RS_NONE)
+                continue;
+
+            Serial.printf("Supervisor: %s stalled for %lu ms, %s\n", tasks[i].name, (unsigned long)stalledMs,
+                          RECOVERY_STEP_NAMES[step]);
+            recoveryCount++;
+            bool ok = runRecovery((TaskId)i, step);
+            alertQueue.push({(uint8_t)i, (uint8_t)step, false, ok, stalledMs});
+            esp_task_wdt_reset(); // A bus reset can wait several seconds for the mutex
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+// ==========================================
+// PROMETHEUS TEXT WRITER
+// ==========================================
+// Appends metrics in the Prometheus text exposition format to a caller-owned
+// buffer. Nothing is allocated. A line that does not fit is dropped whole and
+// `overflow` is set, so a scrape never sees half a sample.
+//
+//   # HELP greenhouse_temperature_celsius Air temperature
+//   # TYPE greenhouse_temperature_celsius gauge
+//   greenhouse_temperature_celsius 24.10
+//   greenhouse_actuator_on{actuator="pump"} 0
+//
+// Each family is declared once with family(), followed by its samples. At
+// most one label per sample, which is all the firmware needs.
+
+class PromWriter
+{
+public:
+    bool overflow = false;
+
+    PromWriter(char *buf, size_t size) : buf(buf), size(size)
+    {
+        if (size)
+            buf[0] = '\0';
+    }
+
+    size_t length() const { return len; }
+
+    // HELP and TYPE lines ("gauge" or "counter")
+    void family(const char *name, const char *type, const char *help)
+    {
+        append("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    void sample(const char *name, uint32_t value, const char *label = nullptr, const char *labelValue = nullptr)
+    {
+        if (label)
+            append("%s{%s=\"%s\"} %lu\n", name, label, labelValue, (unsigned long)value);
+        else
+            append("%s %lu\n", name, (unsigned long)value);
+    }
+
+    // NaN (failed sensor) is written as Prometheus' NaN
+    void sampleF(const char *name, float value, const char *label = nullptr, const char *labelValue = nullptr)
+    {
+        char num[16];
+        if (value != value)
+            snprintf(num, sizeof(num), "NaN");
+        else
+            snprintf(num, sizeof(num), "%.2f", value);
+        if (label)
+            append("%s{%s=\"%s\"} %s\n", name, label, labelValue, num);
+        else
+            append("%s %s\n", name, num);
+    }
+
+private:
+    char *buf;
+    size_t size;
+    size_t len = 0;
+
+    void append(const char *fmt, ...)
+    {
+        if (len >= size)
+            return;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, size - len, fmt, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= size - len)
+        {
+            buf[len] = '\0'; // Drop the partial line
+            overflow = true;
+            return;
+        }
+        len += n;
+    }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// ==========================================
+// RECORD LOG FORMAT
+// ==========================================
+// Append-only offline log. The file starts with a header carrying a generation
+// number; each record is a self-checking frame:
+//
+//   header: 'G' 'L' 'O' 'G' <gen u32 LE>
+//   frame:  0x52 0x4C <len u16 LE> <payload> <crc32 u32 LE> 0xC3
+//
+// The CRC covers the length and payload. The commit byte is written last, so
+// a frame cut short by a power loss never validates. A reader that hits a bad
+// frame skips forward to the next frame marker, so a torn record in the
+// middle of the file (with newer records appended after it) costs only that
+// record.
+//
+// Upload progress is a cursor {gen, offset} kept outside the file (NVS). When
+// every record has been sent the file is deleted and the generation bumped,
+// so a stale cursor can never point into a newer file.
+//
+// The reader and upload loop are templates over any file with seek(pos) and
+// read(buf, n), so the same code runs on LittleFS and in the host
+// fault-injection test (test/test_record_log).
+
+#define LOG_HEADER_SIZE 8
+#define LOG_FRAME_OVERHEAD 9 // Marker (2) + length (2) + CRC (4) + commit (1)
+#define LOG_MARK_0 0x52
+#define LOG_MARK_1 0x4C
+#define LOG_COMMIT 0xC3
+
+struct LogCursor
+{
+    uint32_t gen;
+    uint32_t offset; // Next byte to upload
+};
+
+// CRC-32 (IEEE, reflected), nibble table: small and fast enough for records
+inline uint32_t logCrc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t T[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+                                   0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                   0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = T[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = T[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+inline void logHeader(uint32_t gen, uint8_t *out)
+{
+    memcpy(out, "GLOG", 4);
+    memcpy(out + 4, &gen, 4);
+}
+
+// Returns false if `hdr` is not a log header
+inline bool logParseHeader(const uint8_t *hdr, uint32_t &gen)
+{
+    if (memcmp(hdr, "GLOG", 4) != 0)
+        return false;
+    memcpy(&gen, hdr + 4, 4);
+    return true;
+}
+
+// Encodes one frame into `out` (len + LOG_FRAME_OVERHEAD bytes). Returns its size.
+inline size_t logEncodeFrame(const uint8_t *payload, uint16_t len, uint8_t *out)
+{
+    out[0] = LOG_MARK_0;
+    out[1] = LOG_MARK_1;
+    out[2] = len & 0xFF;
+    out[3] = len >> 8;
+    memcpy(out + 4, payload, len);
+    uint32_t crc = logCrc32(0, out + 2, len + 2);
+    memcpy(out + 4 + len, &crc, 4);
+    out[8 + len] = LOG_COMMIT;
+    return len + LOG_FRAME_OVERHEAD;
+}
+
+// Checks a complete candidate frame of `size` bytes starting at a marker
+// (`len` already read from it). True if the CRC and commit byte match.
+inline bool logFrameValid(const uint8_t *frame, uint16_t len)
+{
+    if (frame[0] != LOG_MARK_0 || frame[1] != LOG_MARK_1 || frame[8 + len] != LOG_COMMIT)
+        return false;
+    uint32_t crc;
+    memcpy(&crc, frame + 4 + len, 4);
+    return crc == logCrc32(0, frame + 2, len + 2);
+}
+
+// Matches the stored cursor against the log file found at boot. Returns false
+// if the file must be deleted: unreadable header, or an older generation than
+// the cursor (fully uploaded, but a reset interrupted the cleanup).
+inline bool logResumeCursor(bool headerValid, uint32_t fileGen, LogCursor &cur)
+{
+    if (!headerValid || fileGen < cur.gen)
+        return false;
+    if (fileGen > cur.gen)
+        cur = {fileGen, LOG_HEADER_SIZE}; // Cursor lost (NVS erased): upload everything
+    if (cur.offset < LOG_HEADER_SIZE)
+        cur.offset = LOG_HEADER_SIZE;
+    return true;
+}
+
+// Finds the next valid frame at or after `pos` and moves `pos` past it.
+// `frame` must hold maxLen + LOG_FRAME_OVERHEAD bytes; the payload is returned
+// at frame + 4. Damaged frames (torn writes, bit rot) are skipped by scanning
+// for the next marker; `skipped` counts the bytes passed over.
+template <typename File>
+bool logReadFrame(File &file, uint32_t size, uint32_t &pos, uint8_t *frame, uint16_t maxLen, uint16_t &len,
+                  uint32_t &skipped)
+{
+    while (pos + LOG_FRAME_OVERHEAD <= size)
+    {
+        file.seek(pos);
+        if (file.read(frame, 4) != 4)
+            return false;
+        len = frame[2] | (frame[3] << 8);
+        if (frame[0] == LOG_MARK_0 && frame[1] == LOG_MARK_1 && len <= maxLen &&
+            pos + len + LOG_FRAME_OVERHEAD <= size && file.read(frame + 4, len + 5) == (size_t)len + 5 &&
+            logFrameValid(frame, len))
+        {
+            pos += len + LOG_FRAME_OVERHEAD;
+            return true;
+        }
+        skipped++;
+        pos++;
+    }
+    return false;
+}
+
+enum LogUploadResult : uint8_t
+{
+    LOG_UPLOAD_DONE,   // End of file reached
+    LOG_UPLOAD_MORE,   // Batch limit reached, records remain
+    LOG_UPLOAD_FAILED, // send() failed; the cursor points at that record
+};
+
+// Sends up to `maxRecords` records from the cursor, in order, stopping early
+// once expired() says the time slice is used up. send(payload, len) returns
+// true once the broker has accepted the record; only then does the cursor
+// move past it. The caller persists the cursor after each batch, so a reset
+// mid-batch repeats at most that batch; the records keep their
+// (boot_id, seq), so the backend drops the repeats.
+template <typename File, typename Expired, typename Send>
+LogUploadResult logUpload(File &file, uint32_t size, LogCursor &cur, uint8_t *frame, uint16_t maxLen,
+                          uint32_t &skipped, int maxRecords, Expired expired, Send send)
+{
+    uint32_t pos = cur.offset;
+    uint16_t len;
+    for (int n = 0; n < maxRecords && (n == 0 || !expired()); n++)
+    {
+        if (!logReadFrame(file, size, pos, frame, maxLen, len, skipped))
+            return LOG_UPLOAD_DONE;
+        if (!send(frame + 4, len))
+            return LOG_UPLOAD_FAILED;
+        cur.offset = pos;
+    }
+    return pos < size ? LOG_UPLOAD_MORE : LOG_UPLOAD_DONE; // A torn tail alone shows up as DONE next call
+}
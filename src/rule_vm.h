@@ -0,0 +1,324 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// ==========================================
+// RULE VM
+// ==========================================
+// Evaluates user automation rules compiled to bytecode by the backend
+// (webapp/backend/services/ruleCompiler.js), e.g.
+//
+//   if co2 > 1200 and fan == 0 then fan = 1 for 300s
+//
+// Program layout: 'G' 'R' <version> <ruleCount> <code...>
+//
+// Each rule compiles to: <condition> JZ <skip> SET... END_RULE
+// The program is validated once on load (operands, variable ids, stack depth,
+// jump targets), so evaluation needs no bounds checks. Jumps are forward-only:
+// every instruction runs at most once per tick, which bounds evaluation time
+// by the program length. No allocation happens after load.
+//
+// Keep the opcode and variable tables in sync with ruleCompiler.js.
+
+#define RULE_MAGIC_0 'G'
+#define RULE_MAGIC_1 'R'
+#define RULE_VERSION 1
+#define RULE_HEADER_SIZE 4
+#define RULE_MAX_CODE 4096
+#define RULE_STACK_DEPTH 16
+
+enum RuleOp : uint8_t
+{
+    OP_PUSH_I16 = 0x01, // <i16 LE>  push integer constant
+    OP_PUSH_F32 = 0x02, // <f32 LE>  push float constant
+    OP_LOAD = 0x03,     // <var u8>  push input variable
+    OP_ADD = 0x10,
+    OP_SUB = 0x11,
+    OP_MUL = 0x12,
+    OP_DIV = 0x13, // x / 0 = 0
+    OP_NEG = 0x14,
+    OP_GT = 0x20,
+    OP_LT = 0x21,
+    OP_GE = 0x22,
+    OP_LE = 0x23,
+    OP_EQ = 0x24,
+    OP_NE = 0x25,
+    OP_AND = 0x30,
+    OP_OR = 0x31,
+    OP_NOT = 0x32,
+    OP_JZ = 0x40,       // <u16 LE>  pop; skip forward if zero
+    OP_SET = 0x50,      // <out u8> <value u8> <hold s u16 LE>
+    OP_END_RULE = 0x60, // Rule boundary (stack must be empty)
+};
+
+// Input variables (index = operand of OP_LOAD)
+enum RuleVar : uint8_t
+{
+    RV_TEMP = 0,
+    RV_HUM,
+    RV_SOIL,
+    RV_CO2,
+    RV_TVOC,
+    RV_TANK,
+    RV_PUMP,
+    RV_FAN,
+    RV_HEATER,
+    RV_HOUR, // Local time of day in hours (e.g. 18.5), -1 when unknown
+    RULE_VAR_COUNT
+};
+
+// Outputs (index = first operand of OP_SET)
+enum RuleOut : uint8_t
+{
+    RO_PUMP = 0,
+    RO_FAN,
+    RO_HEATER,
+    RULE_OUT_COUNT
+};
+
+class RuleVM
+{
+public:
+    RuleVM() { clear(); }
+
+    void clear()
+    {
+        len = 0;
+        rules = 0;
+        memset(outs, 0, sizeof(outs));
+    }
+
+    bool loaded() const { return len > 0; }
+    uint8_t ruleCount() const { return rules; }
+    uint16_t codeSize() const { return len; }
+    const uint8_t *program() const { return code; }
+
+    // Validates and copies a program. On failure the previous program is kept.
+    bool load(const uint8_t *prog, size_t size)
+    {
+        if (size < RULE_HEADER_SIZE || size > RULE_MAX_CODE)
+            return false;
+        if (prog[0] != RULE_MAGIC_0 || prog[1] != RULE_MAGIC_1 || prog[2] != RULE_VERSION)
+            return false;
+        if (!validate(prog, size))
+            return false;
+        memcpy(code, prog, size);
+        len = size;
+        rules = prog[3];
+        memset(outs, 0, sizeof(outs));
+        return true;
+    }
+
+    // Runs every rule once. Returns the number of rules whose condition held.
+    int evaluate(const float *vars, uint32_t nowMs)
+    {
+        // Unlatched overrides only last one tick; latched ones until they expire
+        for (int i = 0; i < RULE_OUT_COUNT; i++)
+        {
+            if (outs[i].active && (!outs[i].latched || (int32_t)(nowMs - outs[i].until) >= 0))
+                outs[i].active = false;
+        }
+
+        float stack[RULE_STACK_DEPTH];
+        int sp = 0;
+        int fired = 0;
+        uint16_t pc = RULE_HEADER_SIZE;
+        while (pc < len)
+        {
+            uint8_t op = code[pc++];
+            switch (op)
+            {
+            case OP_PUSH_I16:
+                stack[sp++] = (float)(int16_t)rd16(pc);
+                pc += 2;
+                break;
+            case OP_PUSH_F32:
+            {
+                float f;
+                memcpy(&f, &code[pc], 4);
+                stack[sp++] = f;
+                pc += 4;
+                break;
+            }
+            case OP_LOAD:
+                stack[sp++] = vars[code[pc++]];
+                break;
+            case OP_NEG:
+                stack[sp - 1] = -stack[sp - 1];
+                break;
+            case OP_NOT:
+                stack[sp - 1] = (stack[sp - 1] == 0.0f) ? 1.0f : 0.0f;
+                break;
+            case OP_JZ:
+            {
+                uint16_t skip = rd16(pc);
+                pc += 2;
+                if (stack[--sp] == 0.0f)
+                    pc += skip;
+                else
+                    fired++;
+                break;
+            }
+            case OP_SET:
+            {
+                Override &o = outs[code[pc]];
+                uint16_t hold = rd16(pc + 2);
+                o.active = true;
+                o.value = code[pc + 1] != 0;
+                o.latched = hold > 0;
+                o.until = nowMs + (uint32_t)hold * 1000;
+                pc += 4;
+                break;
+            }
+            case OP_END_RULE:
+                break;
+            default:
+            {
+                // Binary operators
+                float b = stack[--sp];
+                float a = stack[sp - 1];
+                float r = 0;
+                switch (op)
+                {
+                case OP_ADD: r = a + b; break;
+                case OP_SUB: r = a - b; break;
+                case OP_MUL: r = a * b; break;
+                case OP_DIV: r = (b != 0.0f) ? a / b : 0.0f; break;
+                case OP_GT: r = a > b; break;
+                case OP_LT: r = a < b; break;
+                case OP_GE: r = a >= b; break;
+                case OP_LE: r = a <= b; break;
+                case OP_EQ: r = a == b; break;
+                case OP_NE: r = a != b; break;
+                case OP_AND: r = (a != 0.0f && b != 0.0f); break;
+                case OP_OR: r = (a != 0.0f || b != 0.0f); break;
+                }
+                stack[sp - 1] = r;
+                break;
+            }
+            }
+        }
+        return fired;
+    }
+
+    // True if a rule currently forces `out`; the forced state is in `value`
+    bool override(uint8_t out, bool &value) const
+    {
+        if (out >= RULE_OUT_COUNT || !outs[out].active)
+            return false;
+        value = outs[out].value;
+        return true;
+    }
+
+private:
+    struct Override
+    {
+        bool active;
+        bool value;
+        bool latched;
+        uint32_t until;
+    };
+
+    uint8_t code[RULE_MAX_CODE];
+    uint16_t len;
+    uint8_t rules;
+    Override outs[RULE_OUT_COUNT];
+    uint8_t boundary[RULE_MAX_CODE / 8]; // Validation scratch (kept off the task stack)
+
+    uint16_t rd16(uint16_t at) const { return (uint16_t)code[at] | ((uint16_t)code[at + 1] << 8); }
+
+    static int operandSize(uint8_t op)
+    {
+        switch (op)
+        {
+        case OP_PUSH_I16: return 2;
+        case OP_PUSH_F32: return 4;
+        case OP_LOAD: return 1;
+        case OP_JZ: return 2;
+        case OP_SET: return 4;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_NEG:
+        case OP_GT: case OP_LT: case OP_GE: case OP_LE: case OP_EQ: case OP_NE:
+        case OP_AND: case OP_OR: case OP_NOT: case OP_END_RULE:
+            return 0;
+        default: return -1;
+        }
+    }
+
+    // Two linear passes. The first checks operands and stack depth and marks
+    // rule-level instructions (stack empty); the second checks that every jump
+    // lands on one of them (or the end of the program).
+    bool validate(const uint8_t *p, size_t size)
+    {
+        memset(boundary, 0, sizeof(boundary));
+        int depth = 0;
+        int ruleEnds = 0;
+
+        size_t pc = RULE_HEADER_SIZE;
+        while (pc < size)
+        {
+            if (depth == 0)
+                boundary[pc >> 3] |= 1 << (pc & 7);
+            uint8_t op = p[pc];
+            int n = operandSize(op);
+            if (n < 0 || pc + 1 + n > size)
+                return false;
+            const uint8_t *arg = &p[pc + 1];
+            switch (op)
+            {
+            case OP_PUSH_I16:
+            case OP_PUSH_F32:
+                depth++;
+                break;
+            case OP_LOAD:
+                if (arg[0] >= RULE_VAR_COUNT)
+                    return false;
+                depth++;
+                break;
+            case OP_NEG:
+            case OP_NOT:
+                if (depth < 1)
+                    return false;
+                break;
+            case OP_JZ:
+                if (depth != 1)
+                    return false;
+                depth = 0;
+                break;
+            case OP_SET:
+                if (depth != 0 || arg[0] >= RULE_OUT_COUNT || arg[1] > 1)
+                    return false;
+                break;
+            case OP_END_RULE:
+                if (depth != 0)
+                    return false;
+                ruleEnds++;
+                break;
+            default:
+                if (depth < 2)
+                    return false;
+                depth--;
+                break;
+            }
+            if (depth > RULE_STACK_DEPTH)
+                return false;
+            pc += 1 + n;
+        }
+        if (depth != 0 || ruleEnds != p[3])
+            return false;
+
+        pc = RULE_HEADER_SIZE;
+        while (pc < size)
+        {
+            uint8_t op = p[pc];
+            if (op == OP_JZ)
+            {
+                size_t t = pc + 3 + (p[pc + 1] | (p[pc + 2] << 8));
+                if (t > size || (t < size && !(boundary[t >> 3] & (1 << (t & 7)))))
+                    return false;
+            }
+            pc += 1 + operandSize(op);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// ==========================================
+// NON-BLOCKING SENSOR DRIVERS
+// ==========================================
+// The Adafruit / ScioSense libraries busy-wait for conversions (AHT21 ~80 ms,
+// ENS160 until new data). These drivers split each acquisition into short
+// I2C transfers so the sensor task can sleep while the chips convert:
+//
+//   AHT21:  trigger() -> (sleep AHT21_CONVERSION_MS) -> read()
+//   ENS160: poll() reads the status register and, only if NEWDAT is set,
+//           the AQI/TVOC/eCO2 block. The chip converts on its own in STD mode.
+//
+// The libraries are still used for begin() (reset, calibration, op mode).
+// Callers own the bus: hold the I2C mutex around each call.
+
+#define AHT21_ADDR 0x38
+#define AHT21_CONVERSION_MS 80
+
+#define ENS160_REG_DATA_STATUS 0x20
+#define ENS160_REG_DATA_AQI 0x21
+#define ENS160_STATUS_NEWDAT 0x02
+
+class AsyncAHT21
+{
+public:
+    float temperature = 0;
+    float humidity = 0;
+
+    explicit AsyncAHT21(TwoWire &bus) : wire(bus) {}
+
+    // Starts a conversion. Result is ready after AHT21_CONVERSION_MS.
+    bool trigger()
+    {
+        wire.beginTransmission(AHT21_ADDR);
+        wire.write(0xAC);
+        wire.write(0x33);
+        wire.write(0x00);
+        busy = (wire.endTransmission() == 0);
+        return busy;
+    }
+
+    bool pending() const { return busy; }
+
+    // Reads the conversion result. Returns false if still busy or on CRC error.
+    bool read()
+    {
+        uint8_t d[7];
+        if (wire.requestFrom((uint8_t)AHT21_ADDR, (size_t)7) != 7)
+        {
+            busy = false;
+            return false;
+        }
+        for (int i = 0; i < 7; i++)
+            d[i] = wire.read();
+        if (d[0] & 0x80)
+            return false; // Still converting, caller retries
+        busy = false;
+        if (crc8(d, 6) != d[6])
+            return false;
+
+        uint32_t rawHum = ((uint32_t)d[1] << 12) | ((uint32_t)d[2] << 4) | (d[3] >> 4);
+        uint32_t rawTemp = (((uint32_t)d[3] & 0x0F) << 16) | ((uint32_t)d[4] << 8) | d[5];
+        humidity = rawHum * 100.0f / 1048576.0f;
+        temperature = rawTemp * 200.0f / 1048576.0f - 50.0f;
+        return true;
+    }
+
+private:
+    TwoWire &wire;
+    bool busy = false;
+
+    static uint8_t crc8(const uint8_t *data, int len)
+    {
+        uint8_t crc = 0xFF;
+        for (int i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++)
+                crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+        return crc;
+    }
+};
+
+class AsyncENS160
+{
+public:
+    uint8_t aqi = 0;
+    uint16_t tvoc = 0;
+    uint16_t eco2 = 400;
+
+    AsyncENS160(TwoWire &bus, uint8_t address) : wire(bus), addr(address) {}
+
+    // Returns true if a new sample was read. Never waits for the chip.
+    bool poll()
+    {
+        uint8_t status;
+        if (!readRegs(ENS160_REG_DATA_STATUS, &status, 1) || !(status & ENS160_STATUS_NEWDAT))
+            return false;
+
+        uint8_t d[5]; // AQI, TVOC (LE), eCO2 (LE)
+        if (!readRegs(ENS160_REG_DATA_AQI, d, sizeof(d)))
+            return false;
+        aqi = d[0] & 0x07;
+        tvoc = d[1] | (d[2] << 8);
+        eco2 = d[3] | (d[4] << 8);
+        return true;
+    }
+
+private:
+    TwoWire &wire;
+    uint8_t addr;
+
+    bool readRegs(uint8_t reg, uint8_t *buf, size_t len)
+    {
+        wire.beginTransmission(addr);
+        wire.write(reg);
+        if (wire.endTransmission(false) != 0)
+            return false;
+        if (wire.requestFrom(addr, len) != len)
+            return false;
+        for (size_t i = 0; i < len; i++)
+            buf[i] = wire.read();
+        return true;
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// ==========================================
+// SETPOINT SCHEDULE
+// ==========================================
+// A day is split into up to SCHED_MAX_SEGMENTS time-of-day segments, each with
+// its own climate and soil targets. Values ramp linearly into the next segment
+// during the last `rampMin` minutes before it starts, so there is no step
+// change at midnight or at sunrise.
+//
+// Optional growth stages (weeks long) shift all targets by an offset once the
+// crop passes each stage boundary.
+//
+// The whole schedule is a plain POD so it can be persisted to NVS as a blob.
+// evaluate() is O(1): a minute-of-day lookup table maps directly to a segment.
+
+#define SCHED_MAX_SEGMENTS 8
+#define SCHED_MAX_STAGES 6
+#define SCHED_MINUTES_PER_DAY 1440
+#define SCHED_BLOB_VERSION 1
+
+struct Setpoints
+{
+    float tempMin; // Heater ON below this
+    float tempMax; // Fan ON above this
+    float humMax;  // Fan ON above this
+    float soilDry; // Pump ON below this %
+    float soilWet; // Pump OFF above this %
+};
+
+struct SetpointSegment
+{
+    uint16_t startMin; // Minute of day (0-1439) the segment starts
+    Setpoints sp;
+};
+
+struct GrowthStage
+{
+    uint16_t days;    // Stage duration
+    float tempOffset; // Added to tempMin / tempMax
+    float humOffset;  // Added to humMax
+    float soilOffset; // Added to soilDry / soilWet
+};
+
+struct SetpointScheduleData
+{
+    uint8_t version;
+    uint8_t segmentCount; // 0 = schedule disabled
+    uint8_t stageCount;   // 0 = no growth curve
+    uint16_t rampMin;     // Blend window before each segment edge
+    uint32_t stageStart;  // Epoch (s) of day 0 of the growth curve
+    SetpointSegment segments[SCHED_MAX_SEGMENTS];
+    GrowthStage stages[SCHED_MAX_STAGES];
+};
+
+class SetpointSchedule
+{
+public:
+    SetpointScheduleData data;
+
+    SetpointSchedule() { clear(); }
+
+    void clear()
+    {
+        memset(&data, 0, sizeof(data));
+        data.version = SCHED_BLOB_VERSION;
+        memset(lookup, 0, sizeof(lookup));
+        cachedDay = UINT32_MAX;
+        cachedStage = -1;
+    }
+
+    bool enabled() const { return data.segmentCount > 0; }
+
+    // Validates the table, sorts segments by start time and rebuilds the
+    // minute lookup. Returns false (and disables the schedule) if invalid.
+    bool rebuild()
+    {
+        if (data.version != SCHED_BLOB_VERSION || data.segmentCount > SCHED_MAX_SEGMENTS || data.stageCount > SCHED_MAX_STAGES)
+        {
+            clear();
+            return false;
+        }
+        if (data.rampMin > SCHED_MINUTES_PER_DAY / 2)
+            data.rampMin = SCHED_MINUTES_PER_DAY / 2;
+
+        // Insertion sort (at most 8 entries)
+        for (int i = 1; i < data.segmentCount; i++)
+        {
+            SetpointSegment key = data.segments[i];
+            int j = i - 1;
+            while (j >= 0 && data.segments[j].startMin > key.startMin)
+            {
+                data.segments[j + 1] = data.segments[j];
+                j--;
+            }
+            data.segments[j + 1] = key;
+        }
+        for (int i = 0; i < data.segmentCount; i++)
+        {
+            if (data.segments[i].startMin >= SCHED_MINUTES_PER_DAY)
+            {
+                clear();
+                return false;
+            }
+        }
+
+        // Minutes before the first segment belong to the last one (wraps midnight)
+        uint8_t seg = data.segmentCount ? data.segmentCount - 1 : 0;
+        int next = 0;
+        for (int m = 0; m < SCHED_MINUTES_PER_DAY; m++)
+        {
+            while (next < data.segmentCount && data.segments[next].startMin <= m)
+                seg = next++;
+            lookup[m] = seg;
+        }
+        cachedDay = UINT32_MAX;
+        cachedStage = -1;
+        return true;
+    }
+
+    // Active segment index for a minute of day
+    int segmentAt(uint16_t minuteOfDay) const { return lookup[minuteOfDay % SCHED_MINUTES_PER_DAY]; }
+
+    // Growth stage for an epoch time, or -1 when no curve applies.
+    // Cached per day, so the stage walk runs once every 24h at most.
+    int stageAt(uint32_t epoch)
+    {
+        if (data.stageCount == 0 || epoch < data.stageStart)
+            return -1;
+        uint32_t day = (epoch - data.stageStart) / 86400;
+        if (day != cachedDay)
+        {
+            cachedDay = day;
+            cachedStage = data.stageCount - 1; // Hold the final stage once the curve ends
+            uint32_t acc = 0;
+            for (int i = 0; i < data.stageCount; i++)
+            {
+                acc += data.stages[i].days;
+                if (day < acc)
+                {
+                    cachedStage = i;
+                    break;
+                }
+            }
+        }
+        return cachedStage;
+    }
+
+    // Targets for the given local minute of day. `epoch` is only used for the
+    // growth curve (pass 0 when wall time is unknown).
+    Setpoints evaluate(uint16_t minuteOfDay, uint32_t epoch)
+    {
+        minuteOfDay %= SCHED_MINUTES_PER_DAY;
+        int cur = lookup[minuteOfDay];
+        Setpoints out = data.segments[cur].sp;
+
+        if (data.segmentCount > 1 && data.rampMin > 0)
+        {
+            int nxt = (cur + 1) % data.segmentCount;
+            int untilNext = (int)data.segments[nxt].startMin - (int)minuteOfDay;
+            if (untilNext <= 0)
+                untilNext += SCHED_MINUTES_PER_DAY;
+            if (untilNext <= data.rampMin)
+            {
+                float w = 1.0f - (float)untilNext / (float)data.rampMin;
+                const Setpoints &a = data.segments[cur].sp;
+                const Setpoints &b = data.segments[nxt].sp;
+                out.tempMin = a.tempMin + (b.tempMin - a.tempMin) * w;
+                out.tempMax = a.tempMax + (b.tempMax - a.tempMax) * w;
+                out.humMax = a.humMax + (b.humMax - a.humMax) * w;
+                out.soilDry = a.soilDry + (b.soilDry - a.soilDry) * w;
+                out.soilWet = a.soilWet + (b.soilWet - a.soilWet) * w;
+            }
+        }
+
+        applyStage(out, epoch);
+        return out;
+    }
+
+    // Applies the growth-stage offset to fixed (non-scheduled) targets
+    void applyStage(Setpoints &sp, uint32_t epoch)
+    {
+        int stage = stageAt(epoch);
+        if (stage < 0)
+            return;
+        const GrowthStage &g = data.stages[stage];
+        sp.tempMin += g.tempOffset;
+        sp.tempMax += g.tempOffset;
+        sp.humMax += g.humOffset;
+        sp.soilDry += g.soilOffset;
+        sp.soilWet += g.soilOffset;
+    }
+
+private:
+    uint8_t lookup[SCHED_MINUTES_PER_DAY];
+    uint32_t cachedDay;
+    int cachedStage;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// ==========================================
+// SPSC RING
+// ==========================================
+// Lock-free queue for exactly one producer task and one consumer task (they
+// may run on different cores). The producer only writes `head`, the consumer
+// only writes `tail`; release/acquire ordering publishes the slot contents.
+//
+// When full, push() drops the new item and counts an overflow: the consumer
+// owns the oldest slots, so the producer never overwrites them.
+
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Ring size must be a power of two");
+
+public:
+    // Producer side
+    bool push(const T &item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t depth = h - tail.load(std::memory_order_acquire);
+        if (depth >= N)
+        {
+            overflows.store(overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        if (depth + 1 > peak.load(std::memory_order_relaxed))
+            peak.store(depth + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        item = slots[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Safe from either side (a snapshot; may be stale by one item)
+    uint32_t depth() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    uint32_t maxDepth() const { return peak.load(std::memory_order_relaxed); }
+    uint32_t overflowCount() const { return overflows.load(std::memory_order_relaxed); }
+    static constexpr uint32_t capacity() { return N; }
+
+private:
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> overflows{0};
+    std::atomic<uint32_t> peak{0};
+    T slots[N];
+};
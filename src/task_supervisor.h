@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// ==========================================
+// TASK SUPERVISOR
+// ==========================================
+// Each task bumps a heartbeat counter once per loop. The supervisor compares
+// counters against the previous check; a task whose counter has not moved for
+// `stallMs` is stalled and gets the next step of the recovery ladder:
+//
+//   I2C bus reset -> MQTT client restart -> task restart -> reboot
+//
+// Steps that cannot help a given task are skipped (`steps` mask), and each
+// step is given `stepWaitMs` to work before escalating. Reboot is always the
+// last step. A heartbeat at any point resets the ladder.
+
+enum RecoveryStep : uint8_t
+{
+    RS_NONE,
+    RS_I2C_RESET,
+    RS_MQTT_RESTART,
+    RS_TASK_RESTART,
+    RS_REBOOT
+};
+
+#define RS_MASK(step) (1u << (step))
+
+const char *const RECOVERY_STEP_NAMES[] = {"none", "i2c_reset", "mqtt_restart", "task_restart", "reboot"};
+
+struct TaskWatch
+{
+    uint32_t stallMs; // No heartbeat for this long = stalled (0 = not watched)
+    uint8_t steps;    // RS_MASK() of the steps that apply before reboot
+    uint32_t lastBeat;
+    uint32_t beatAt; // When lastBeat changed
+    uint8_t step;    // Last step taken (RS_NONE = healthy)
+    uint32_t stepAt;
+};
+
+// Returns the step to take now (RS_NONE = nothing to do). `recoveredFrom` is
+// the last step taken when a stalled task has started beating again, else RS_NONE.
+inline RecoveryStep superviseTask(TaskWatch &w, uint32_t beat, uint32_t nowMs, uint32_t stepWaitMs,
+                                  RecoveryStep &recoveredFrom)
+{
+    recoveredFrom = RS_NONE;
+    if (w.stallMs == 0)
+        return RS_NONE;
+    if (beat != w.lastBeat)
+    {
+        recoveredFrom = (RecoveryStep)w.step;
+        w.lastBeat = beat;
+        w.beatAt = nowMs;
+        w.step = RS_NONE;
+        return RS_NONE;
+    }
+    if (nowMs - w.beatAt < w.stallMs)
+        return RS_NONE;
+    if (w.step != RS_NONE && nowMs - w.stepAt < stepWaitMs)
+        return RS_NONE;
+
+    uint8_t next = w.step + 1;
+    while (next < RS_REBOOT && !(w.steps & RS_MASK(next)))
+        next++;
+    if (next > RS_REBOOT)
+        next = RS_REBOOT;
+    w.step = next;
+    w.stepAt = nowMs;
+    return (RecoveryStep)next;
+}
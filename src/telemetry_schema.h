@@ -0,0 +1,524 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ==========================================
+// TELEMETRY SCHEMA
+// ==========================================
+// One table describes every telemetry field. From it we get:
+//   - TelemetrySample, the record the sampler task captures
+//   - TELEMETRY_SCHEMA, a constexpr field table (key, type, decimals, offset)
+//   - writeTelemetryJson() / writeTelemetryBinary(), table-driven writers with
+//     no format-string parsing
+//   - webapp/backend/services/telemetrySchema.js, generated from this file by
+//     `npm run gen:telemetry` in webapp/backend (decoder + DynamoDB field list)
+//
+// To add a field: add one line below, fill it in fillTelemetry(), bump
+// TELEMETRY_SCHEMA_VERSION and re-run the generator.
+//
+// TF(member, type, kind, decimals, history)
+// TA(member, "key", type, kind, decimals, count, group, history)
+//   decimals: digits after the point in JSON (floats only)
+//   history:  1 = stored in the DynamoDB history table
+//   group:    TG_ROOT arrays are fixed length; TG_ZONES arrays are written
+//             inside "zones": {...} with zone_count elements
+
+#define TELEMETRY_SCHEMA_VERSION 14
+#define TELEMETRY_MAGIC_0 'G'
+#define TELEMETRY_MAGIC_1 'T'
+#define TELEMETRY_MAX_ZONES 4
+#define TELEMETRY_TASKS 6
+#define TELEMETRY_CHANNELS 4 // Adaptive sampling channels: temp, hum, co2, soil
+#define TELEMETRY_BOOT_PHASES 8
+#define TELEMETRY_ACTUATORS 3 // pump, fan, heater
+#define TELEMETRY_STRATEGIES 6 // Climate strategies: idle, vent, heat, heat_dry, heat_vent, manual
+#define TELEMETRY_STR_MAX 24   // Longest string value: device id, firmware version, mode, climate
+
+// clang-format off
+#define TELEMETRY_FIELDS(TF, TA) \
+    TF(device_id,        const char *, TK_STR, 0, 0) \
+    TF(version,          const char *, TK_STR, 0, 1) \
+    TF(timestamp,        uint32_t,     TK_U32, 0, 0) \
+    TF(ts_src,           uint8_t,      TK_U8,  0, 1) \
+    TF(ts_err,           int32_t,      TK_I32, 0, 1) \
+    TF(boot_id,          uint32_t,     TK_U32, 0, 1) \
+    TF(seq,              uint32_t,     TK_U32, 0, 1) \
+    TF(mono_ms,          uint32_t,     TK_U32, 0, 1) \
+    TF(temp,             float,        TK_F32, 1, 1) \
+    TF(hum,              float,        TK_F32, 1, 1) \
+    TF(vpd,              float,        TK_F32, 2, 1) \
+    TF(dew_point,        float,        TK_F32, 1, 1) \
+    TF(soil,             int16_t,      TK_I16, 0, 1) \
+    TF(co2,              uint16_t,     TK_U16, 0, 1) \
+    TF(tvoc,             uint16_t,     TK_U16, 0, 0) \
+    TF(tank_level,       uint8_t,      TK_U8,  0, 1) \
+    TF(pump,             uint8_t,      TK_U8,  0, 1) \
+    TF(fan,              uint8_t,      TK_U8,  0, 1) \
+    TF(heater,           uint8_t,      TK_U8,  0, 1) \
+    TF(mode,             const char *, TK_STR, 0, 1) \
+    TF(climate,          const char *, TK_STR, 0, 1) \
+    TA(energy_wh, "energy_wh", float, TK_F32, 1, TELEMETRY_STRATEGIES, TG_ROOT, 0) \
+    TF(water_total_ml,   float,        TK_F32, 0, 1) \
+    TF(sp_tmin,          float,        TK_F32, 1, 0) \
+    TF(sp_tmax,          float,        TK_F32, 1, 0) \
+    TF(sp_hmax,          float,        TK_F32, 1, 0) \
+    TF(seg,              int8_t,       TK_I8,  0, 0) \
+    TF(stage,            int8_t,       TK_I8,  0, 0) \
+    TF(clock,            uint8_t,      TK_U8,  0, 0) \
+    TF(rules,            uint8_t,      TK_U8,  0, 0) \
+    TF(rules_us,         uint32_t,     TK_U32, 0, 0) \
+    TF(aht_us,           uint32_t,     TK_U32, 0, 0) \
+    TF(ens_us,           uint32_t,     TK_U32, 0, 0) \
+    TF(heap_free,        uint32_t,     TK_U32, 0, 0) \
+    TF(heap_largest,     uint32_t,     TK_U32, 0, 0) \
+    TF(heap_largest_min, uint32_t,     TK_U32, 0, 0) \
+    TF(heap_frag,        uint8_t,      TK_U8,  0, 0) \
+    TA(stack_free, "stack_free", uint32_t, TK_U32, 0, TELEMETRY_TASKS, TG_ROOT, 0) \
+    TF(stack_ok,         uint8_t,      TK_U8,  0, 0) \
+    TF(recoveries,       uint16_t,     TK_U16, 0, 0) \
+    TA(boot_ms,   "boot_ms",   uint32_t, TK_U32, 0, TELEMETRY_BOOT_PHASES, TG_ROOT, 0) \
+    TF(wifi_assoc_ms,    uint16_t,     TK_U16, 0, 0) \
+    TF(wifi_dhcp_ms,     uint16_t,     TK_U16, 0, 0) \
+    TF(wifi_fast,        uint8_t,      TK_U8,  0, 0) \
+    TF(lan,              uint8_t,      TK_U8,  0, 0) \
+    TF(ws_clients,       uint8_t,      TK_U8,  0, 0) \
+    TF(ws_client_bytes,  uint16_t,     TK_U16, 0, 0) \
+    TF(queue_depth,      uint8_t,      TK_U8,  0, 0) \
+    TF(queue_max,        uint8_t,      TK_U8,  0, 0) \
+    TF(queue_drops,      uint32_t,     TK_U32, 0, 0) \
+    TF(event_drops,      uint32_t,     TK_U32, 0, 0) \
+    TF(event_corrupt,    uint32_t,     TK_U32, 0, 0) \
+    TF(pm,               uint8_t,      TK_U8,  0, 0) \
+    TF(wakes,            uint16_t,     TK_U16, 0, 0) \
+    TF(current_ma,       float,        TK_F32, 1, 1) \
+    TA(sample_ms, "sample_ms", uint32_t, TK_U32, 0, TELEMETRY_CHANNELS, TG_ROOT, 0) \
+    TA(switches,  "switches",  uint32_t, TK_U32, 0, TELEMETRY_ACTUATORS, TG_ROOT, 0) \
+    TF(zone_count,       uint8_t,      TK_U8,  0, 0) \
+    TA(zone_soil,   "soil",     uint8_t, TK_U8,  0, TELEMETRY_MAX_ZONES, TG_ZONES, 1) \
+    TA(zone_valve,  "valve",    uint8_t, TK_U8,  0, TELEMETRY_MAX_ZONES, TG_ZONES, 1) \
+    TA(zone_phase,  "phase",    uint8_t, TK_U8,  0, TELEMETRY_MAX_ZONES, TG_ZONES, 1) \
+    TA(zone_water,  "water_ml", float,   TK_F32, 0, TELEMETRY_MAX_ZONES, TG_ZONES, 1) \
+    TA(zone_pulses, "pulses",   uint8_t, TK_U8,  0, TELEMETRY_MAX_ZONES, TG_ZONES, 1)
+// clang-format on
+
+enum TelemetryKind : uint8_t
+{
+    TK_U8,
+    TK_I8,
+    TK_U16,
+    TK_I16,
+    TK_U32,
+    TK_I32,
+    TK_F32, // Binary: IEEE float LE; JSON: fixed point with `decimals` digits
+    TK_STR, // Binary: u8 length + bytes
+};
+
+enum TelemetryGroup : uint8_t
+{
+    TG_ROOT,
+    TG_ZONES,
+};
+
+struct TelemetrySample
+{
+#define TS_MEMBER(m, type, kind, dec, hist) type m;
+#define TS_ARRAY(m, key, type, kind, dec, count, group, hist) type m[count];
+    TELEMETRY_FIELDS(TS_MEMBER, TS_ARRAY)
+#undef TS_MEMBER
+#undef TS_ARRAY
+};
+
+struct TelemetryField
+{
+    const char *key;
+    uint16_t offset;
+    TelemetryKind kind;
+    uint8_t decimals;
+    uint8_t count; // 0 = scalar
+    TelemetryGroup group;
+};
+
+static constexpr TelemetryField TELEMETRY_SCHEMA[] = {
+#define TS_FIELD(m, type, kind, dec, hist) {#m, offsetof(TelemetrySample, m), kind, dec, 0, TG_ROOT},
+#define TS_ARRAY(m, key, type, kind, dec, count, group, hist) {key, offsetof(TelemetrySample, m), kind, dec, count, group},
+    TELEMETRY_FIELDS(TS_FIELD, TS_ARRAY)
+#undef TS_FIELD
+#undef TS_ARRAY
+};
+
+// TFI_<member>: index of a field in TELEMETRY_SCHEMA
+enum TelemetryFieldId : uint8_t
+{
+#define TS_ID(m, ...) TFI_##m,
+    TELEMETRY_FIELDS(TS_ID, TS_ID)
+#undef TS_ID
+};
+
+static constexpr size_t TELEMETRY_FIELD_COUNT = sizeof(TELEMETRY_SCHEMA) / sizeof(TELEMETRY_SCHEMA[0]);
+
+static constexpr uint8_t telemetryKindSize(TelemetryKind k)
+{
+    return k == TK_U8 || k == TK_I8 ? 1 : k == TK_U16 || k == TK_I16 ? 2 : k == TK_STR ? sizeof(const char *) : 4;
+}
+
+static_assert(TELEMETRY_FIELD_COUNT < 256, "Telemetry schema too large");
+
+// --- Size bounds ---
+// Longest record either writer can produce: every number at its widest, every
+// zone present and every string TELEMETRY_STR_MAX characters of quotes (each
+// escaped in JSON). Buffers sized from these never see a writer return 0
+// unless a string breaks TELEMETRY_STR_MAX.
+
+static constexpr size_t telemetryJsonWidth(TelemetryKind k, uint8_t decimals)
+{
+    return k == TK_U8    ? 3   // 255
+           : k == TK_I8  ? 4   // -128
+           : k == TK_U16 ? 5   // 65535
+           : k == TK_I16 ? 6   // -32768
+           : k == TK_U32 ? 10  // 4294967295
+           : k == TK_I32 ? 11  // -2147483648
+           : k == TK_F32 ? (decimals ? 12 : 11) // '-', 10 digits (clamped), '.'
+                         : 2 + 2 * TELEMETRY_STR_MAX;
+}
+
+static constexpr size_t telemetryJsonMax()
+{
+    size_t n = 2; // {}
+    TelemetryGroup group = TG_ROOT;
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        if (f.group != group)
+        {
+            n += 13; // , "zones": { and its closing }
+            group = f.group;
+        }
+        else if (i)
+            n += 2; // ,
+        size_t key = 0;
+        while (f.key[key])
+            key++;
+        n += key + 4; // "key":
+        size_t w = telemetryJsonWidth(f.kind, f.decimals);
+        n += f.count ? 1 + f.count * (w + 1) : w; // [a,b,c]
+    }
+    return n;
+}
+
+static constexpr size_t telemetryBinaryMax()
+{
+    size_t n = 3; // Magic and version
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        size_t w = f.kind == TK_STR ? 1 + TELEMETRY_STR_MAX : telemetryKindSize(f.kind);
+        n += (f.count ? f.count : 1) * w;
+    }
+    return n;
+}
+
+static constexpr size_t TELEMETRY_JSON_MAX = telemetryJsonMax() + 1; // Including the terminator
+static constexpr size_t TELEMETRY_BINARY_MAX = telemetryBinaryMax();
+static_assert(TELEMETRY_STR_MAX < 256, "Binary strings carry a u8 length");
+
+// --- Writers ---
+// Both writers return the number of bytes written, or 0 if `cap` is too small
+// (the JSON writer then leaves an empty string in `buf`).
+
+class TelemetryOut
+{
+public:
+    TelemetryOut(char *buf, size_t cap) : p(buf), start(buf), end(buf + cap) {}
+
+    bool ok() const { return !overflow; }
+    size_t length() const { return overflow ? 0 : (size_t)(p - start); }
+
+    void put(char c)
+    {
+        if (p < end)
+            *p++ = c;
+        else
+            overflow = true;
+    }
+
+    void raw(const void *src, size_t n)
+    {
+        if ((size_t)(end - p) < n)
+        {
+            overflow = true;
+            return;
+        }
+        memcpy(p, src, n);
+        p += n;
+    }
+
+    void str(const char *s)
+    {
+        while (*s)
+            put(*s++);
+    }
+
+    void u32(uint32_t v)
+    {
+        char tmp[10];
+        int n = 0;
+        do
+        {
+            tmp[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        while (n)
+            put(tmp[--n]);
+    }
+
+    void i32(int32_t v)
+    {
+        if (v < 0)
+        {
+            put('-');
+            u32((uint32_t)(-(int64_t)v));
+        }
+        else
+            u32((uint32_t)v);
+    }
+
+    // Rounds to `decimals` digits (0-4) without printf's float formatting
+    void fixed(float v, uint8_t decimals)
+    {
+        static const uint32_t POW10[] = {1, 10, 100, 1000, 10000};
+        if (v != v)
+        {
+            str("null"); // NaN (e.g. sensor not read yet) is not valid JSON
+            return;
+        }
+        uint32_t scale = POW10[decimals > 4 ? 4 : decimals];
+        bool neg = v < 0;
+        float mag = (neg ? -v : v) * scale + 0.5f;
+        if (mag > 4294967040.0f) // Largest float below 2^32
+            mag = 4294967040.0f;
+        uint32_t scaled = (uint32_t)mag;
+        if (neg && scaled)
+            put('-');
+        u32(scaled / scale);
+        if (decimals)
+        {
+            put('.');
+            uint32_t frac = scaled % scale;
+            for (uint32_t d = scale / 10; d; d /= 10)
+            {
+                put('0' + frac / d);
+                frac %= d;
+            }
+        }
+    }
+
+private:
+    char *p;
+    char *start;
+    char *end;
+    bool overflow = false;
+};
+
+namespace telemetry_detail
+{
+template <typename T>
+inline T load(const uint8_t *base, uint16_t offset)
+{
+    T v;
+    memcpy(&v, base + offset, sizeof(T));
+    return v;
+}
+
+inline void jsonValue(TelemetryOut &out, const uint8_t *at, const TelemetryField &f)
+{
+    switch (f.kind)
+    {
+    case TK_U8: out.u32(load<uint8_t>(at, 0)); break;
+    case TK_I8: out.i32(load<int8_t>(at, 0)); break;
+    case TK_U16: out.u32(load<uint16_t>(at, 0)); break;
+    case TK_I16: out.i32(load<int16_t>(at, 0)); break;
+    case TK_U32: out.u32(load<uint32_t>(at, 0)); break;
+    case TK_I32: out.i32(load<int32_t>(at, 0)); break;
+    case TK_F32: out.fixed(load<float>(at, 0), f.decimals); break;
+    case TK_STR:
+    {
+        const char *s = load<const char *>(at, 0);
+        out.put('"');
+        for (; s && *s; s++)
+        {
+            if (*s == '"' || *s == '\\')
+                out.put('\\');
+            out.put(*s);
+        }
+        out.put('"');
+        break;
+    }
+    }
+}
+
+inline void binaryValue(TelemetryOut &out, const uint8_t *at, TelemetryKind kind)
+{
+    if (kind == TK_STR)
+    {
+        const char *s = load<const char *>(at, 0);
+        size_t n = s ? strlen(s) : 0;
+        uint8_t len = n > 255 ? 255 : (uint8_t)n;
+        out.put((char)len);
+        out.raw(s, len);
+    }
+    else
+    {
+        out.raw(at, telemetryKindSize(kind)); // ESP32 is little-endian
+    }
+}
+
+inline uint8_t elementCount(const TelemetrySample &s, const TelemetryField &f)
+{
+    if (f.group == TG_ZONES)
+        return s.zone_count < f.count ? s.zone_count : f.count;
+    return f.count;
+}
+} // namespace telemetry_detail
+
+// {"device_id": "...", ..., "zones": {"soil": [..], ...}}
+inline size_t writeTelemetryJson(const TelemetrySample &s, char *buf, size_t cap)
+{
+    using namespace telemetry_detail;
+    TelemetryOut out(buf, cap);
+    const uint8_t *base = (const uint8_t *)&s;
+    TelemetryGroup group = TG_ROOT;
+
+    out.put('{');
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        if (f.group != group)
+        {
+            out.str(", \"zones\": {");
+            group = f.group;
+        }
+        else if (i)
+            out.str(", ");
+        out.put('"');
+        out.str(f.key);
+        out.str("\": ");
+
+        if (!f.count)
+        {
+            jsonValue(out, base + f.offset, f);
+            continue;
+        }
+        uint8_t size = telemetryKindSize(f.kind);
+        uint8_t n = elementCount(s, f);
+        out.put('[');
+        for (uint8_t e = 0; e < n; e++)
+        {
+            if (e)
+                out.put(',');
+            jsonValue(out, base + f.offset + e * size, f);
+        }
+        out.put(']');
+    }
+    if (group != TG_ROOT)
+        out.put('}');
+    out.put('}');
+    out.put('\0');
+    if (!out.ok())
+    {
+        if (cap)
+            buf[0] = '\0'; // A caller that ignores the 0 still sends nothing, not a cut record
+        return 0;
+    }
+    return out.length() - 1;
+}
+
+// 'G' 'T' <schema version> then every field in table order. Zone arrays carry
+// zone_count elements (zone_count itself precedes them).
+inline size_t writeTelemetryBinary(const TelemetrySample &s, uint8_t *buf, size_t cap)
+{
+    using namespace telemetry_detail;
+    TelemetryOut out((char *)buf, cap);
+    const uint8_t *base = (const uint8_t *)&s;
+
+    out.put(TELEMETRY_MAGIC_0);
+    out.put(TELEMETRY_MAGIC_1);
+    out.put((char)TELEMETRY_SCHEMA_VERSION);
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        if (!f.count)
+        {
+            binaryValue(out, base + f.offset, f.kind);
+            continue;
+        }
+        uint8_t size = telemetryKindSize(f.kind);
+        uint8_t n = elementCount(s, f);
+        for (uint8_t e = 0; e < n; e++)
+            binaryValue(out, base + f.offset + e * size, f.kind);
+    }
+    return out.length();
+}
+
+// Finds where each field starts inside a binary record of the current schema
+// version. `offsets` gets one entry per field (array fields: offset of the
+// first element). Returns false if the record is truncated or from another
+// schema version.
+inline bool telemetryBinaryOffsets(const uint8_t *rec, size_t len, uint16_t *offsets)
+{
+    if (len < 3 || rec[0] != TELEMETRY_MAGIC_0 || rec[1] != TELEMETRY_MAGIC_1 || rec[2] != TELEMETRY_SCHEMA_VERSION)
+        return false;
+    size_t at = 3;
+    uint8_t zoneCount = 0;
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        size_t n = !f.count ? 1 : f.group == TG_ZONES ? (zoneCount < f.count ? zoneCount : f.count) : f.count;
+        if (at > len || (n && at == len)) // Empty zone arrays may end the record
+            return false;
+        offsets[i] = (uint16_t)at;
+        if (f.kind == TK_STR)
+            at += 1 + rec[at];
+        else
+            at += n * telemetryKindSize(f.kind);
+        if (i == TFI_zone_count)
+            zoneCount = rec[offsets[i]];
+    }
+    return at <= len;
+}
+
+// Where the time fields sit in a binary record of any schema version since 3,
+// so the offline log can repair timestamps in records written by older
+// firmware too. Every such version starts with device_id, version, timestamp,
+// ts_src, ts_err, boot_id, seq (from version 4) and mono_ms; only the fields
+// after these change between versions.
+struct TelemetryTimeOffsets
+{
+    uint16_t timestamp, tsSrc, tsErr, bootId, monoMs;
+};
+
+static_assert(TFI_device_id == 0 && TFI_version == 1 && TFI_timestamp == 2 && TFI_ts_src == 3 && TFI_ts_err == 4 &&
+                  TFI_boot_id == 5 && TFI_seq == 6 && TFI_mono_ms == 7,
+              "The time header is shared by all schema versions: add new fields after mono_ms");
+
+inline bool telemetryTimeOffsets(const uint8_t *rec, size_t len, TelemetryTimeOffsets &at)
+{
+    if (len < 3 || rec[0] != TELEMETRY_MAGIC_0 || rec[1] != TELEMETRY_MAGIC_1 || rec[2] < 3 ||
+        rec[2] > TELEMETRY_SCHEMA_VERSION)
+        return false;
+    size_t pos = 3;
+    for (int i = 0; i < 2; i++) // device_id, version
+    {
+        if (pos >= len)
+            return false;
+        pos += 1 + rec[pos];
+    }
+    at.timestamp = pos;
+    at.tsSrc = pos + 4;
+    at.tsErr = pos + 5;
+    at.bootId = pos + 9;
+    pos += rec[2] >= 4 ? 17 : 13; // Past seq where there is one
+    at.monoMs = pos;
+    return pos + 4 <= len;
+}
@@ -0,0 +1,32 @@
+// Prints each sample from telemetry_sample.h as the firmware encodes it, one
+// line per sample: "<binary record as hex> <JSON record>". Built and run by
+// webapp/backend/scripts/checkTelemetryDecoder.js; not a PlatformIO test, so
+// main() is compiled out if pio ever picks this file up as shared test code.
+
+#ifndef PIO_UNIT_TESTING
+#include <stdio.h>
+
+#include "telemetry_sample.h"
+
+int main()
+{
+    static char json[TELEMETRY_JSON_MAX]; // The firmware's buffer sizes
+    static uint8_t bin[TELEMETRY_BINARY_MAX];
+    for (int v = 0; v < TELEMETRY_SAMPLE_VARIANTS; v++)
+    {
+        TelemetrySample t;
+        telemetrySample(t, v);
+        size_t binLen = writeTelemetryBinary(t, bin, sizeof(bin));
+        size_t jsonLen = writeTelemetryJson(t, json, sizeof(json));
+        if (!binLen || !jsonLen)
+        {
+            fprintf(stderr, "sample %d does not fit\n", v);
+            return 1;
+        }
+        for (size_t i = 0; i < binLen; i++)
+            printf("%02x", bin[i]);
+        printf(" %s\n", json);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+// Deterministic telemetry samples shared by test/test_telemetry_schema and
+// telemetry_dump.cpp (the backend decoder check). Every field gets a value
+// that is distinct from its neighbours; variants cover no zones, all zones,
+// negative numbers, rounding halves and a sensor that has not been read.
+
+#include <math.h>
+#include <string.h>
+
+#include "telemetry_schema.h"
+
+#define TELEMETRY_SAMPLE_VARIANTS 4
+
+inline void telemetrySample(TelemetrySample &t, int variant)
+{
+    memset(&t, 0, sizeof(t));
+    t.device_id = "GH-0123456789AB";
+    t.version = variant == 2 ? "v3.0 \"test\" \\ build" : "v3.0";
+    t.timestamp = 1760000000u + variant;
+    t.ts_src = variant % 3;
+    t.ts_err = variant == 1 ? -1 : 12;
+    t.boot_id = 42;
+    t.seq = 1000u + variant;
+    t.mono_ms = 123456789u;
+    t.temp = variant == 3 ? NAN : 23.45f;
+    t.hum = 61.25f;
+    t.vpd = 1.125f;
+    t.dew_point = variant == 1 ? -1.25f : 15.5f;
+    t.soil = variant == 1 ? -3 : 47;
+    t.co2 = 612;
+    t.tvoc = 45;
+    t.tank_level = 80;
+    t.pump = 1;
+    t.fan = 0;
+    t.heater = 1;
+    t.mode = variant == 1 ? "MANUAL" : "AUTO";
+    t.climate = "heat_vent";
+    for (int i = 0; i < TELEMETRY_STRATEGIES; i++)
+        t.energy_wh[i] = 10.25f * (i + 1);
+    t.water_total_ml = 12345.0f;
+    t.sp_tmin = 18.0f;
+    t.sp_tmax = 28.5f;
+    t.sp_hmax = 75.0f;
+    t.seg = variant == 1 ? -1 : 2;
+    t.stage = variant == 1 ? -1 : 0;
+    t.clock = 2;
+    t.rules = 17;
+    t.rules_us = 85;
+    t.aht_us = 81000;
+    t.ens_us = 1200;
+    t.heap_free = 151234;
+    t.heap_largest = 110592;
+    t.heap_largest_min = 98304;
+    t.heap_frag = 27;
+    for (int i = 0; i < TELEMETRY_TASKS; i++)
+        t.stack_free[i] = 1000 + 111 * i;
+    t.stack_ok = 1;
+    t.recoveries = 3;
+    for (int i = 0; i < TELEMETRY_BOOT_PHASES; i++)
+        t.boot_ms[i] = 50 * (i + 1);
+    t.wifi_assoc_ms = 420;
+    t.wifi_dhcp_ms = 65535;
+    t.wifi_fast = 1;
+    t.lan = 0;
+    t.ws_clients = 2;
+    t.ws_client_bytes = 3100;
+    t.queue_depth = 1;
+    t.queue_max = 9;
+    t.queue_drops = 0xFFFFFFFFu;
+    t.event_drops = 3;
+    t.event_corrupt = 0;
+    t.pm = 1;
+    t.wakes = 640;
+    t.current_ma = 87.5f;
+    for (int i = 0; i < TELEMETRY_CHANNELS; i++)
+        t.sample_ms[i] = 500u << i;
+    for (int i = 0; i < TELEMETRY_ACTUATORS; i++)
+        t.switches[i] = 100u * (i + 1);
+    t.zone_count = variant == 0 ? 1 : variant == 1 ? 0 : TELEMETRY_MAX_ZONES;
+    for (int i = 0; i < TELEMETRY_MAX_ZONES; i++)
+    {
+        t.zone_soil[i] = 30 + 10 * i;
+        t.zone_valve[i] = i % 2;
+        t.zone_phase[i] = i;
+        t.zone_water[i] = 250.0f * (i + 1);
+        t.zone_pulses[i] = i + 1;
+    }
+}
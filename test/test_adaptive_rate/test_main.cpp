@@ -0,0 +1,143 @@
+// Host tests for the adaptive sampling period (src/adaptive_rate.h).
+//
+//   pio test -e native -f test_adaptive_rate
+
+#include <unity.h>
+#include <math.h>
+
+#include "adaptive_rate.h"
+
+// Temperature defaults from main.cpp: 0.5 s to 30 s, 0.02 °C/s, 0.15 °C noise
+static const ChannelLimits LIM = {500, 30000, 0.02f, 0.15f};
+
+static AdaptiveRate rate;
+static uint32_t now;
+
+// Feeds `value` one current period after the previous sample
+static uint32_t sample(float value)
+{
+    now += rate.periodMs;
+    return rate.update(value, now, LIM);
+}
+
+void setUp(void)
+{
+    rate = AdaptiveRate();
+    now = 1000;
+}
+
+void tearDown(void) {}
+
+void test_starts_at_min_period(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(500, rate.update(21.0f, now, LIM));
+    TEST_ASSERT_EQUAL_UINT32(500, rate.periodMs);
+}
+
+void test_quiet_signal_backs_off_to_max(void)
+{
+    rate.update(21.0f, now, LIM);
+    uint32_t prev = rate.periodMs;
+    int steps = 0;
+    while (rate.periodMs < LIM.maxMs && steps < 50)
+    {
+        uint32_t p = sample(21.0f);
+        TEST_ASSERT_TRUE(p >= prev); // Only ever stretches
+        TEST_ASSERT_TRUE(p <= prev + prev / 4);
+        prev = p;
+        steps++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs, rate.periodMs);
+    TEST_ASSERT_LESS_THAN(25, steps); // 25% per sample: 500 ms -> 30 s in ~19 samples
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs, sample(21.0f)); // and stays there
+}
+
+void test_step_change_is_caught_within_two_samples(void)
+{
+    rate.update(21.0f, now, LIM);
+    for (int i = 0; i < 40; i++)
+        sample(21.0f);
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs, rate.periodMs);
+
+    // A door opens: one degree in one period
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs / 2, sample(22.0f));
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs / 4, sample(22.0f)); // The variance still says "moving"
+}
+
+void test_noisy_signal_stays_fast(void)
+{
+    rate.update(21.0f, now, LIM);
+    for (int i = 0; i < 40; i++)
+        sample(i % 2 ? 21.0f : 21.6f); // 0.3 °C of noise, twice the limit
+    TEST_ASSERT_EQUAL_UINT32(LIM.minMs, rate.periodMs);
+}
+
+// A steady drift under the rate limit still backs off, but the EWMA mean lags
+// a ramp, so the lag counts as spread and the period cycles below the maximum
+// instead of settling there.
+void test_slow_drift_backs_off_below_max(void)
+{
+    rate.update(21.0f, now, LIM);
+    float v = 21.0f;
+    uint32_t longest = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        v += 0.005f * rate.periodMs / 1000.0f; // 0.005 °C/s, a quarter of the rate limit
+        uint32_t p = sample(v);
+        if (i >= 50 && p > longest)
+            longest = p;
+    }
+    TEST_ASSERT_GREATER_THAN(5000, longest);
+    TEST_ASSERT_LESS_THAN(LIM.maxMs, longest);
+}
+
+void test_failed_reads_are_ignored(void)
+{
+    rate.update(21.0f, now, LIM);
+    for (int i = 0; i < 10; i++)
+        sample(21.0f);
+    uint32_t p = rate.periodMs;
+    TEST_ASSERT_EQUAL_UINT32(p, sample(NAN));
+    TEST_ASSERT_EQUAL_UINT32(p, sample(NAN));
+    TEST_ASSERT_TRUE(sample(21.0f) >= p); // The NaNs did not count as a change
+}
+
+void test_period_clamped_to_new_limits(void)
+{
+    rate.update(21.0f, now, LIM);
+    for (int i = 0; i < 40; i++)
+        sample(21.0f);
+    ChannelLimits tighter = {200, 5000, LIM.rate, LIM.stdDev};
+    now += 1000;
+    TEST_ASSERT_EQUAL_UINT32(5000, rate.update(21.0f, now, tighter));
+    for (int i = 0; i < 10; i++)
+    {
+        now += 200;
+        rate.update(i % 2 ? 21.0f : 25.0f, now, tighter);
+    }
+    TEST_ASSERT_EQUAL_UINT32(200, rate.periodMs);
+}
+
+void test_millis_wraparound(void)
+{
+    now = 0xFFFFFF00u;
+    rate.update(21.0f, now, LIM);
+    for (int i = 0; i < 40; i++)
+        sample(21.0f); // Crosses 2^32 after the first sample
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs, rate.periodMs);
+    TEST_ASSERT_EQUAL_UINT32(LIM.maxMs / 2, sample(22.0f));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_at_min_period);
+    RUN_TEST(test_quiet_signal_backs_off_to_max);
+    RUN_TEST(test_step_change_is_caught_within_two_samples);
+    RUN_TEST(test_noisy_signal_stays_fast);
+    RUN_TEST(test_slow_drift_backs_off_below_max);
+    RUN_TEST(test_failed_reads_are_ignored);
+    RUN_TEST(test_period_clamped_to_new_limits);
+    RUN_TEST(test_millis_wraparound);
+    return UNITY_END();
+}
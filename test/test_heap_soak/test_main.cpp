@@ -0,0 +1,398 @@
+// Heap soak for the telemetry, offline-log and upload paths: 30 days of 5 s
+// records (518,400) pushed through the same code the connectivity task runs,
+// with a daily outage that fills the offline log and a reconnect that drains
+// it in batches. Every C++ allocation goes to a first-fit model of the device
+// heap, so the test reports free bytes, the largest free block and the
+// fragmentation % the firmware puts in each record (updateHeapStats()).
+//
+// The device model follows logRecordOffline(), flushRamBuffer() and
+// processOfflineData() in src/main.cpp. WiFi, MQTT, TLS and LittleFS are not
+// modelled: their allocations only show up on the device (heap_largest_min).
+//
+//   pio test -e native -f test_heap_soak
+
+#include <unity.h>
+#include <new>
+#include <stdio.h>
+#include <string>
+
+#include "../fixtures/telemetry_sample.h"
+#include "record_log.h"
+#include "spsc_ring.h"
+
+// From src/main.cpp
+#define TELEMETRY_PERIOD_MS 5000
+#define TELEMETRY_QUEUE_LEN 16
+#define RAM_BUFFER_BYTES 16384
+#define RAM_BUFFER_SIZE 50
+#define OFFLINE_BATCH_RECORDS 20
+#define LOG_LINE_MAX 1024
+#define LOOPS_PER_RECORD (TELEMETRY_PERIOD_MS / 50) // Connectivity loop yields 50 ms
+
+#define SOAK_DAYS 30
+#define RECORDS_PER_DAY (86400000UL / TELEMETRY_PERIOD_MS)
+#define LOG_FLASH_BYTES (1024 * 1024) // Offline log share of the LittleFS partition
+#define MODEL_HEAP_BYTES (160 * 1024) // Stand-in for the free heap with WiFi up
+
+// --- Model heap ---
+// First-fit over one arena with 16-byte headers and coalescing on free, close
+// enough to the ESP-IDF allocator for fragmentation to show the same way.
+
+struct ModelHeap
+{
+    struct Block
+    {
+        size_t size; // Including this header
+        size_t used;
+    };
+
+    // No initializers: the static instance is zero-filled before any
+    // constructor runs, including ones that allocate
+    alignas(16) uint8_t arena[MODEL_HEAP_BYTES];
+    bool ready;
+    unsigned long allocs;
+
+    Block *first() { return (Block *)arena; }
+    Block *next(Block *b) { return (Block *)((uint8_t *)b + b->size); }
+    bool inside(Block *b) { return (uint8_t *)b < arena + sizeof(arena); }
+
+    void init()
+    {
+        if (!ready) // First use may come from a static constructor
+        {
+            *first() = {sizeof(arena), 0};
+            ready = true;
+        }
+    }
+
+    void *alloc(size_t n)
+    {
+        init();
+        size_t need = (n + sizeof(Block) + 15) & ~(size_t)15;
+        for (Block *b = first(); inside(b); b = next(b))
+        {
+            if (b->used || b->size < need)
+                continue;
+            if (b->size - need >= 2 * sizeof(Block))
+            {
+                Block *rest = (Block *)((uint8_t *)b + need);
+                *rest = {b->size - need, 0};
+                b->size = need;
+            }
+            b->used = 1;
+            allocs++;
+            return b + 1;
+        }
+        return nullptr;
+    }
+
+    void release(void *p)
+    {
+        if (!p)
+            return;
+        ((Block *)((uintptr_t)p - sizeof(Block)))->used = 0; // Header just before the payload
+        for (Block *b = first(); inside(b); b = next(b))
+            while (!b->used && inside(next(b)) && !next(b)->used)
+                b->size += next(b)->size;
+    }
+
+    void stats(uint32_t &freeBytes, uint32_t &largest)
+    {
+        init();
+        freeBytes = largest = 0;
+        for (Block *b = first(); inside(b); b = next(b))
+        {
+            if (b->used)
+                continue;
+            uint32_t n = b->size - sizeof(Block);
+            freeBytes += n;
+            if (n > largest)
+                largest = n;
+        }
+    }
+};
+
+static ModelHeap heap;
+
+void *operator new(size_t n)
+{
+    void *p = heap.alloc(n);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void *operator new(size_t n, const std::nothrow_t &) noexcept { return heap.alloc(n); }
+void *operator new[](size_t n, const std::nothrow_t &) noexcept { return heap.alloc(n); }
+void operator delete(void *p) noexcept { heap.release(p); }
+void operator delete[](void *p) noexcept { heap.release(p); }
+void operator delete(void *p, size_t) noexcept { heap.release(p); }
+void operator delete[](void *p, size_t) noexcept { heap.release(p); }
+
+// updateHeapStats() in src/main.cpp
+struct HeapWatch
+{
+    uint32_t minFree = UINT32_MAX;
+    uint32_t minLargest = UINT32_MAX;
+    int maxFrag = 0;
+
+    void sample()
+    {
+        uint32_t freeBytes, largest;
+        heap.stats(freeBytes, largest);
+        int frag = freeBytes ? 100 - (int)((uint64_t)largest * 100 / freeBytes) : 0;
+        if (freeBytes < minFree)
+            minFree = freeBytes;
+        if (largest < minLargest)
+            minLargest = largest;
+        if (frag > maxFrag)
+            maxFrag = frag;
+    }
+};
+
+// --- Device model (all static, like the firmware) ---
+
+struct FlashFile
+{
+    uint8_t *data;
+    uint32_t size;
+    uint32_t at = 0;
+
+    bool seek(uint32_t pos)
+    {
+        at = pos;
+        return pos <= size;
+    }
+    size_t read(uint8_t *buf, size_t n)
+    {
+        if (at >= size)
+            return 0;
+        if (n > size - at)
+            n = size - at;
+        memcpy(buf, data + at, n);
+        at += n;
+        return n;
+    }
+};
+
+static uint8_t flash[LOG_FLASH_BYTES];
+static uint32_t flashLen;
+static LogCursor logCursor;
+static uint8_t ramBuffer[RAM_BUFFER_BYTES];
+static size_t ramBufferLen;
+static int ramBufferCount;
+static SpscRing<TelemetrySample, TELEMETRY_QUEUE_LEN> telemetryQueue;
+
+struct SoakCounters
+{
+    unsigned long live, logged, uploaded, dropped, cursorWrites;
+    size_t publishedBytes;
+};
+static SoakCounters n;
+
+static void flushRamBuffer()
+{
+    if (!ramBufferCount)
+        return;
+    if (!flashLen)
+    {
+        logHeader(logCursor.gen, flash);
+        flashLen = LOG_HEADER_SIZE;
+    }
+    if (flashLen + ramBufferLen <= sizeof(flash))
+    {
+        memcpy(flash + flashLen, ramBuffer, ramBufferLen);
+        flashLen += ramBufferLen;
+    }
+    else
+        n.dropped += ramBufferCount; // LittleFS full: the append fails
+    ramBufferLen = 0;
+    ramBufferCount = 0;
+}
+
+static void logDataOffline(const TelemetrySample &t)
+{
+    static uint8_t rec[LOG_LINE_MAX];
+    size_t len = writeTelemetryBinary(t, rec, sizeof(rec));
+    size_t frameLen = len + LOG_FRAME_OVERHEAD;
+    TEST_ASSERT_TRUE(len > 0);
+    if (ramBufferLen + frameLen > sizeof(ramBuffer))
+        flushRamBuffer();
+    ramBufferLen += logEncodeFrame(rec, len, ramBuffer + ramBufferLen);
+    if (++ramBufferCount >= RAM_BUFFER_SIZE)
+        flushRamBuffer();
+    n.logged++;
+}
+
+// One connectivity loop's worth; returns true once the backlog is gone
+static bool processOfflineData()
+{
+    static uint8_t frame[LOG_LINE_MAX + LOG_FRAME_OVERHEAD];
+    FlashFile file{flash, flashLen};
+    uint32_t skipped = 0;
+    uint32_t startOffset = logCursor.offset;
+    LogUploadResult result = logUpload(
+        file, file.size, logCursor, frame, LOG_LINE_MAX, skipped, OFFLINE_BATCH_RECORDS, [] { return false; },
+        [](uint8_t *rec, uint16_t len)
+        {
+            TelemetryTimeOffsets at;
+            TEST_ASSERT_TRUE(telemetryTimeOffsets(rec, len, at)); // rebaseRecord()
+            n.uploaded++;
+            n.publishedBytes += len;
+            return true;
+        });
+    TEST_ASSERT_EQUAL_UINT32(0, skipped);
+    if (logCursor.offset != startOffset)
+        n.cursorWrites++;
+    if (result != LOG_UPLOAD_DONE || ramBufferCount)
+        return false;
+    logCursor = {logCursor.gen + 1, LOG_HEADER_SIZE};
+    flashLen = 0;
+    return true;
+}
+
+// Offline for (day % 4) hours from 02:00 each day, and 8 hours on day 15:
+// longer than the log can hold, so the full-flash path runs too
+static bool online(unsigned long record)
+{
+    unsigned long day = record / RECORDS_PER_DAY;
+    unsigned long hour = record % RECORDS_PER_DAY * 24 / RECORDS_PER_DAY;
+    unsigned long outage = day == 15 ? 8 : day % 4;
+    return hour < 2 || hour >= 2 + outage;
+}
+
+void setUp(void)
+{
+    memset(&n, 0, sizeof(n));
+    flashLen = 0;
+    logCursor = {0, LOG_HEADER_SIZE};
+    ramBufferLen = 0;
+    ramBufferCount = 0;
+}
+
+void tearDown(void) {}
+
+void test_thirty_days_without_heap_churn(void)
+{
+    static char json[TELEMETRY_JSON_MAX];
+    HeapWatch watch;
+    watch.sample();
+    unsigned long allocsBefore = heap.allocs;
+    uint32_t startFree = watch.minFree;
+    bool hasOfflineData = false;
+
+    for (unsigned long r = 0; r < SOAK_DAYS * RECORDS_PER_DAY; r++)
+    {
+        // Sampler task
+        TelemetrySample t;
+        telemetrySample(t, r % TELEMETRY_SAMPLE_VARIANTS);
+        t.seq = r + 1;
+        t.mono_ms = r * TELEMETRY_PERIOD_MS;
+        t.timestamp = 1760000000u + r * (TELEMETRY_PERIOD_MS / 1000);
+        TEST_ASSERT_TRUE(telemetryQueue.push(t));
+
+        // Connectivity task
+        bool up = online(r);
+        TelemetrySample s;
+        while (telemetryQueue.pop(s))
+        {
+            if (up)
+            {
+                size_t len = writeTelemetryJson(s, json, sizeof(json));
+                TEST_ASSERT_TRUE(len > 0);
+                n.publishedBytes += len;
+                n.live++;
+            }
+            else
+            {
+                logDataOffline(s);
+                hasOfflineData = true;
+            }
+        }
+        if (up && ramBufferCount)
+            flushRamBuffer();
+        for (int loop = 0; up && hasOfflineData && loop < LOOPS_PER_RECORD; loop++)
+            hasOfflineData = !processOfflineData();
+
+        if (r % (RECORDS_PER_DAY / 24) == 0)
+            watch.sample(); // Hourly
+    }
+    watch.sample();
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%d days: %lu live, %lu logged, %lu uploaded, %lu dropped (flash full), %lu cursor writes",
+             SOAK_DAYS, n.live, n.logged, n.uploaded, n.dropped, n.cursorWrites);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "heap: %lu allocations, min free %u of %u B, min largest block %u B, max frag %d%%",
+             heap.allocs - allocsBefore, (unsigned)watch.minFree, (unsigned)startFree, (unsigned)watch.minLargest,
+             watch.maxFrag);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(SOAK_DAYS * RECORDS_PER_DAY, n.live + n.logged);
+    TEST_ASSERT_EQUAL(n.logged, n.uploaded + n.dropped);
+    TEST_ASSERT_TRUE(n.dropped > 0);      // Day 15 overflowed the log...
+    TEST_ASSERT_FALSE(hasOfflineData);    // ...and everything that fit went up
+    TEST_ASSERT_EQUAL(0, heap.allocs - allocsBefore);
+    TEST_ASSERT_EQUAL_UINT32(startFree, watch.minFree);
+    TEST_ASSERT_EQUAL(0, watch.maxFrag);
+}
+
+// The model heap does see the pattern this firmware used to have: a growing
+// String of 50 JSON lines, a temporary String per line, and long-lived
+// allocations (TLS record buffers) taken between flushes. An allocation that
+// fails is counted and skipped, as String concatenation does on the device.
+void test_string_buffering_fragments_the_model_heap(void)
+{
+    static char json[TELEMETRY_JSON_MAX];
+    HeapWatch watch;
+    watch.sample();
+    unsigned long allocsBefore = heap.allocs;
+    uint32_t startFree = watch.minFree;
+    int failed = 0;
+    std::string *tls[4] = {};
+
+    std::string *ramString = new std::string();
+    for (int r = 0; r < 24 * RAM_BUFFER_SIZE; r++)
+    {
+        TelemetrySample t;
+        telemetrySample(t, r % TELEMETRY_SAMPLE_VARIANTS);
+        writeTelemetryJson(t, json, sizeof(json));
+        try
+        {
+            *ramString += std::string(json) + "\n";
+            if (r % RAM_BUFFER_SIZE == RAM_BUFFER_SIZE - 1)
+            {
+                int slot = r / RAM_BUFFER_SIZE % 4;
+                delete tls[slot];
+                tls[slot] = nullptr;
+                tls[slot] = new std::string(4096 + 1024 * slot, 'x');
+            }
+        }
+        catch (const std::bad_alloc &)
+        {
+            failed++;
+        }
+        if (r % RAM_BUFFER_SIZE == RAM_BUFFER_SIZE - 1)
+            ramString->clear(); // ramBuffer = "" after the flash write keeps the capacity
+        watch.sample();
+    }
+    delete ramString;
+    for (std::string *s : tls)
+        delete s;
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "String buffering: %lu allocations, %d failed, min largest block %u B, max frag %d%%",
+             heap.allocs - allocsBefore, failed, (unsigned)watch.minLargest, watch.maxFrag);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_THAN(1000, heap.allocs - allocsBefore);
+    TEST_ASSERT_GREATER_THAN(0, watch.maxFrag);
+    TEST_ASSERT_LESS_THAN(startFree / 2, watch.minLargest);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_thirty_days_without_heap_churn);
+    RUN_TEST(test_string_buffering_fragments_the_model_heap);
+    return UNITY_END();
+}
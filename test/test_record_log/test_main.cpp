@@ -0,0 +1,383 @@
+// Fault-injection test for the offline log (src/record_log.h): power cuts in
+// the middle of appends, uploads and cursor updates, plus torn and corrupted
+// frames. The device model below follows flushRamBuffer(), openOfflineLog()
+// and processOfflineData() in src/main.cpp step by step, including the
+// batched upload with one cursor write per batch.
+//
+//   pio test -e native -f test_record_log
+
+#include <unity.h>
+#include <stdio.h>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "record_log.h"
+
+#define MAX_PAYLOAD 64
+
+struct PowerCut
+{
+};
+
+// The log file as LittleFS presents it (seek/read like Arduino File)
+struct RamFile
+{
+    const std::vector<uint8_t> &data;
+    uint32_t at = 0;
+
+    explicit RamFile(const std::vector<uint8_t> &d) : data(d) {}
+    bool seek(uint32_t pos)
+    {
+        at = pos;
+        return pos <= data.size();
+    }
+    size_t read(uint8_t *buf, size_t n)
+    {
+        if (at >= data.size())
+            return 0;
+        if (n > data.size() - at)
+            n = data.size() - at;
+        memcpy(buf, data.data() + at, n);
+        at += n;
+        return n;
+    }
+};
+
+// Payload: seq (u32) followed by a seq-derived pattern, 4-40 bytes
+static size_t makeRecord(uint32_t seq, uint8_t *out)
+{
+    size_t len = 4 + seq % 37;
+    memcpy(out, &seq, 4);
+    for (size_t i = 4; i < len; i++)
+        out[i] = (uint8_t)(seq * 31 + i);
+    return len;
+}
+
+static bool recordIntact(const uint8_t *p, uint16_t len, uint32_t &seq)
+{
+    uint8_t expect[MAX_PAYLOAD];
+    if (len < 4)
+        return false;
+    memcpy(&seq, p, 4);
+    return makeRecord(seq, expect) == len && memcmp(expect, p, len) == 0;
+}
+
+struct Device
+{
+    // Survives power loss
+    std::vector<uint8_t> file;
+    bool fileExists = false;
+    LogCursor nvs = {0, LOG_HEADER_SIZE};
+    uint32_t nvsWrites = 0;
+
+    // RAM
+    LogCursor cur = {0, LOG_HEADER_SIZE};
+    std::vector<uint32_t> ramBuffer;
+
+    // Fault injection: the step at which power is cut (-1 = never)
+    std::mt19937 &rng;
+    long stepsLeft = -1;
+
+    explicit Device(std::mt19937 &r) : rng(r) {}
+
+    void step()
+    {
+        if (stepsLeft >= 0 && stepsLeft-- == 0)
+            throw PowerCut();
+    }
+
+    // A flash write that loses a random tail when the power goes
+    void flashWrite(const uint8_t *data, size_t n)
+    {
+        if (stepsLeft >= 0 && stepsLeft-- == 0)
+        {
+            file.insert(file.end(), data, data + rng() % (n + 1));
+            throw PowerCut();
+        }
+        file.insert(file.end(), data, data + n);
+    }
+
+    void nvsSave() // NVS entries are replaced atomically
+    {
+        step();
+        nvs = cur;
+        nvsWrites++;
+    }
+
+    void boot()
+    {
+        ramBuffer.clear();
+        cur = nvs;
+        if (!fileExists)
+            return;
+        uint32_t gen = 0;
+        bool valid = file.size() >= LOG_HEADER_SIZE && logParseHeader(file.data(), gen);
+        if (!logResumeCursor(valid, gen, cur))
+        {
+            file.clear();
+            fileExists = false;
+        }
+    }
+
+    // flushRamBuffer(): header for a fresh file, then all buffered frames in one write
+    void flush()
+    {
+        if (ramBuffer.empty())
+            return;
+        std::vector<uint8_t> out;
+        uint8_t frame[MAX_PAYLOAD + LOG_FRAME_OVERHEAD];
+        uint8_t rec[MAX_PAYLOAD];
+        if (!fileExists)
+        {
+            fileExists = true;
+            out.resize(LOG_HEADER_SIZE);
+            logHeader(cur.gen, out.data());
+        }
+        for (uint32_t seq : ramBuffer)
+        {
+            size_t n = logEncodeFrame(rec, makeRecord(seq, rec), frame);
+            out.insert(out.end(), frame, frame + n);
+        }
+        flashWrite(out.data(), out.size());
+        ramBuffer.clear();
+    }
+
+    // processOfflineData(), called until it stops: returns true if the log
+    // was fully sent and retired
+    template <typename Send>
+    bool upload(Send send, int batch = 20)
+    {
+        if (!fileExists)
+            return true;
+        uint8_t frame[MAX_PAYLOAD + LOG_FRAME_OVERHEAD];
+        uint32_t skipped = 0;
+        LogUploadResult r;
+        do
+        {
+            RamFile f(file);
+            uint32_t startOffset = cur.offset;
+            r = logUpload(
+                f, file.size(), cur, frame, MAX_PAYLOAD, skipped, batch, [] { return false; },
+                [&](uint8_t *p, uint16_t len)
+                {
+                    step();
+                    if (!send(p, len))
+                        return false;
+                    step(); // Power cut after the broker accepted, before the batch commit
+                    return true;
+                });
+            if (cur.offset != startOffset)
+                nvsSave();
+        } while (r == LOG_UPLOAD_MORE);
+        if (r != LOG_UPLOAD_DONE || !ramBuffer.empty())
+            return false;
+        cur = {cur.gen + 1, LOG_HEADER_SIZE};
+        nvsSave();
+        step();
+        file.clear();
+        fileExists = false;
+        return true;
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_torn_tail_keeps_complete_frames(void)
+{
+    std::mt19937 rng(1);
+    Device base(rng);
+    for (uint32_t s = 0; s < 5; s++)
+        base.ramBuffer.push_back(s);
+    base.flush();
+    uint8_t rec[MAX_PAYLOAD], frame[MAX_PAYLOAD + LOG_FRAME_OVERHEAD];
+    size_t lastLen = logEncodeFrame(rec, makeRecord(5, rec), frame);
+
+    // Cut the sixth frame at every length; records appended afterwards must still arrive
+    for (size_t cut = 0; cut < lastLen; cut++)
+    {
+        Device d(rng);
+        d.file = base.file;
+        d.fileExists = true;
+        d.file.insert(d.file.end(), frame, frame + cut);
+        d.boot();
+        d.ramBuffer = {6, 7};
+        d.flush();
+
+        std::vector<uint32_t> got;
+        d.upload([&](uint8_t *p, uint16_t len) {
+            uint32_t seq;
+            TEST_ASSERT_TRUE(recordIntact(p, len, seq));
+            got.push_back(seq);
+            return true;
+        });
+        std::vector<uint32_t> want = {0, 1, 2, 3, 4, 6, 7};
+        TEST_ASSERT_TRUE_MESSAGE(got == want, "torn frame must cost only itself");
+    }
+}
+
+void test_corrupt_frame_costs_only_that_record(void)
+{
+    std::mt19937 rng(2);
+    Device base(rng);
+    for (uint32_t s = 0; s < 8; s++)
+        base.ramBuffer.push_back(s);
+    base.flush();
+
+    // Flip one bit anywhere in the frames (marker, length, payload, CRC or commit byte)
+    for (size_t at = LOG_HEADER_SIZE; at < base.file.size(); at++)
+    {
+        Device d(rng);
+        d.file = base.file;
+        d.fileExists = true;
+        d.file[at] ^= 1 << (at % 8);
+        d.boot();
+
+        std::map<uint32_t, int> got;
+        d.upload([&](uint8_t *p, uint16_t len) {
+            uint32_t seq;
+            TEST_ASSERT_TRUE_MESSAGE(recordIntact(p, len, seq), "corrupt payload delivered");
+            got[seq]++;
+            return true;
+        });
+        TEST_ASSERT_EQUAL(7, got.size());
+        for (auto &g : got)
+            TEST_ASSERT_EQUAL(1, g.second);
+    }
+}
+
+void test_bad_header_or_old_generation_discards_file(void)
+{
+    std::mt19937 rng(3);
+    Device d(rng);
+    d.ramBuffer = {1, 2};
+    d.flush();
+    d.file[0] = 'X';
+    d.boot();
+    TEST_ASSERT_FALSE(d.fileExists);
+
+    Device e(rng);
+    e.ramBuffer = {1, 2};
+    e.flush();
+    e.nvs = {1, LOG_HEADER_SIZE}; // Retired, but the reset came before remove()
+    e.boot();
+    TEST_ASSERT_FALSE(e.fileExists);
+
+    Device f(rng);
+    f.nvs = {4, 100};
+    f.cur = {7, LOG_HEADER_SIZE};
+    f.ramBuffer = {1, 2};
+    f.flush(); // Written under gen 7, cursor lost (NVS still says gen 4)
+    f.boot();
+    TEST_ASSERT_TRUE(f.fileExists);
+    TEST_ASSERT_EQUAL(7, f.cur.gen);
+    TEST_ASSERT_EQUAL(LOG_HEADER_SIZE, f.cur.offset);
+}
+
+// Random power cuts during appends, uploads, cursor commits and cleanup, with
+// a flaky broker. Every record that reached flash in a completed write must be
+// delivered; none may be delivered again once a cursor commit covering it has
+// persisted.
+void test_random_power_cuts(void)
+{
+    std::mt19937 rng(20240601);
+    Device d(rng);
+    uint32_t nextSeq = 0;
+    std::vector<bool> flushed;            // Write completed before any cut
+    std::map<uint32_t, int> delivered;    // Broker side, by seq
+    std::map<uint32_t, int> uncommitted;  // Accepted, then power cut before the commit
+    std::vector<uint32_t> sinceCommit;    // Accepted in the current batch
+    uint32_t writesAtAccept = 0;
+    int cuts = 0;
+
+    auto send = [&](uint8_t *p, uint16_t len) {
+        uint32_t seq;
+        TEST_ASSERT_TRUE_MESSAGE(recordIntact(p, len, seq), "damaged record delivered");
+        if (rng() % 4 == 0)
+            return false; // Broker or link failure
+        delivered[seq]++;
+        if (d.nvsWrites != writesAtAccept)
+            sinceCommit.clear();
+        sinceCommit.push_back(seq);
+        writesAtAccept = d.nvsWrites;
+        return true;
+    };
+
+    for (int round = 0; round < 4000; round++)
+    {
+        d.stepsLeft = rng() % 3 == 0 ? (long)(rng() % 40) : -1;
+        sinceCommit.clear();
+        writesAtAccept = d.nvsWrites;
+        try
+        {
+            int n = 1 + rng() % 12;
+            for (int i = 0; i < n; i++)
+            {
+                d.ramBuffer.push_back(nextSeq++);
+                flushed.push_back(false);
+            }
+            std::vector<uint32_t> pending = d.ramBuffer;
+            d.flush();
+            for (uint32_t s : pending)
+                flushed[s] = true;
+            if (rng() % 2)
+                d.upload(send, 1 + rng() % 30);
+        }
+        catch (PowerCut &)
+        {
+            cuts++;
+            // Cut between the broker accepting records and the batch's cursor commit
+            if (d.nvsWrites == writesAtAccept)
+                for (uint32_t s : sinceCommit)
+                    uncommitted[s]++;
+            d.boot();
+        }
+    }
+
+    // Power stays on: drain what is left
+    d.stepsLeft = -1;
+    for (int i = 0; i < 100 && !d.upload([&](uint8_t *p, uint16_t len) {
+             uint32_t seq;
+             TEST_ASSERT_TRUE(recordIntact(p, len, seq));
+             delivered[seq]++;
+             return true;
+         });
+         i++)
+    {
+    }
+    TEST_ASSERT_FALSE(d.fileExists);
+
+    int flushedCount = 0;
+    for (uint32_t s = 0; s < nextSeq; s++)
+    {
+        if (!flushed[s])
+            continue;
+        flushedCount++;
+        char msg[64];
+        snprintf(msg, sizeof(msg), "record %lu lost", (unsigned long)s);
+        TEST_ASSERT_TRUE_MESSAGE(delivered.count(s) == 1, msg);
+    }
+    for (auto &g : delivered)
+    {
+        int allowed = 1 + (uncommitted.count(g.first) ? uncommitted[g.first] : 0);
+        char msg[64];
+        snprintf(msg, sizeof(msg), "record %lu sent %d times", (unsigned long)g.first, g.second);
+        TEST_ASSERT_TRUE_MESSAGE(g.second <= allowed, msg);
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%d records flushed, %d power cuts, %d repeats before commit", flushedCount, cuts,
+             (int)uncommitted.size());
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_THAN(100, cuts);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_torn_tail_keeps_complete_frames);
+    RUN_TEST(test_corrupt_frame_costs_only_that_record);
+    RUN_TEST(test_bad_header_or_old_generation_discards_file);
+    RUN_TEST(test_random_power_cuts);
+    return UNITY_END();
+}
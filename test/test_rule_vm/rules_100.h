@@ -0,0 +1,160 @@
+// Generated by webapp/backend/scripts/genRuleBench.js - do not edit.
+#pragma once
+
+#include <stdint.h>
+
+// 100 rules, 2106 bytes, e.g.
+//   if heater > 25 then fan = 0 for 457s
+//   if hour <= 16 then pump = 0
+//   if heater > 59 and hum < 46 then fan = 0
+static const uint8_t RULES_100[] = {
+    0x47, 0x52, 0x01, 0x64, 0x03, 0x08, 0x01, 0x19, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00,
+    0xc9, 0x01, 0x60, 0x03, 0x09, 0x01, 0x10, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00,
+    0x00, 0x60, 0x03, 0x08, 0x01, 0x3b, 0x00, 0x20, 0x03, 0x01, 0x01, 0x2e, 0x00, 0x21, 0x30, 0x40,
+    0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x0d, 0x00, 0x21, 0x03, 0x08,
+    0x01, 0x40, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x06,
+    0x03, 0x04, 0x11, 0x01, 0x21, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0xcd, 0x01, 0x60,
+    0x03, 0x07, 0x01, 0x34, 0x00, 0x24, 0x32, 0x03, 0x05, 0x01, 0x02, 0x00, 0x12, 0x01, 0x1f, 0x00,
+    0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x00, 0x03, 0x02, 0x10,
+    0x01, 0x02, 0x00, 0x13, 0x01, 0x57, 0x00, 0x20, 0x03, 0x00, 0x01, 0x14, 0x00, 0x25, 0x31, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x2c, 0x00, 0x20, 0x40, 0x05,
+    0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x00, 0x01, 0x1a, 0x00, 0x23, 0x40, 0x05, 0x00,
+    0x50, 0x01, 0x01, 0x08, 0x02, 0x60, 0x03, 0x06, 0x01, 0x2e, 0x00, 0x20, 0x03, 0x07, 0x01, 0x35,
+    0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x00, 0x01, 0x5d,
+    0x00, 0x21, 0x03, 0x00, 0x01, 0x5a, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00,
+    0x00, 0x60, 0x03, 0x08, 0x03, 0x07, 0x11, 0x01, 0x58, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x28, 0x00, 0x24, 0x32, 0x03, 0x02, 0x01, 0x02, 0x00,
+    0x12, 0x01, 0x2e, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x89, 0x01, 0x60, 0x03,
+    0x04, 0x03, 0x02, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x60, 0x00, 0x20, 0x03, 0x04, 0x01, 0x49,
+    0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x43,
+    0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x23, 0x00,
+    0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x01, 0x01, 0x19, 0x00, 0x20,
+    0x03, 0x09, 0x01, 0x0b, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0xab, 0x00, 0x60,
+    0x03, 0x06, 0x01, 0x08, 0x00, 0x21, 0x03, 0x00, 0x01, 0x5b, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00,
+    0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x07, 0x03, 0x03, 0x11, 0x01, 0x43, 0x00, 0x20, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x4b, 0x00, 0x24, 0x32, 0x03,
+    0x03, 0x01, 0x02, 0x00, 0x12, 0x01, 0x45, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01,
+    0x00, 0x00, 0x60, 0x03, 0x06, 0x03, 0x00, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x43, 0x00, 0x20,
+    0x03, 0x06, 0x01, 0x13, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0xe7, 0x01, 0x60,
+    0x03, 0x03, 0x01, 0x44, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03,
+    0x00, 0x01, 0x32, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x00,
+    0x01, 0x46, 0x00, 0x20, 0x03, 0x08, 0x01, 0x39, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x04, 0x01, 0x34, 0x00, 0x21, 0x03, 0x09, 0x01, 0x55, 0x00, 0x22,
+    0x31, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x10, 0x01, 0x60, 0x03, 0x00, 0x03, 0x06, 0x11, 0x01,
+    0x52, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x4e,
+    0x00, 0x24, 0x32, 0x03, 0x09, 0x01, 0x02, 0x00, 0x12, 0x01, 0x16, 0x00, 0x20, 0x30, 0x40, 0x05,
+    0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x04, 0x03, 0x06, 0x10, 0x01, 0x02, 0x00, 0x13,
+    0x01, 0x49, 0x00, 0x20, 0x03, 0x04, 0x01, 0x17, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x00,
+    0x00, 0x00, 0x00, 0x60, 0x03, 0x04, 0x01, 0x4c, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01,
+    0xfc, 0x01, 0x60, 0x03, 0x05, 0x01, 0x11, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00,
+    0x00, 0x60, 0x03, 0x04, 0x01, 0x02, 0x00, 0x20, 0x03, 0x08, 0x01, 0x42, 0x00, 0x21, 0x30, 0x40,
+    0x05, 0x00, 0x50, 0x00, 0x01, 0x00, 0x00, 0x60, 0x03, 0x01, 0x01, 0x48, 0x00, 0x21, 0x03, 0x08,
+    0x01, 0x49, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x07,
+    0x03, 0x07, 0x11, 0x01, 0x0f, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x35, 0x00, 0x60,
+    0x03, 0x00, 0x01, 0x41, 0x00, 0x24, 0x32, 0x03, 0x07, 0x01, 0x02, 0x00, 0x12, 0x01, 0x0c, 0x00,
+    0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x08, 0x03, 0x05, 0x10,
+    0x01, 0x02, 0x00, 0x13, 0x01, 0x10, 0x00, 0x20, 0x03, 0x08, 0x01, 0x48, 0x00, 0x25, 0x31, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x00, 0x01, 0x1c, 0x00, 0x20, 0x40, 0x05,
+    0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x04, 0x00, 0x23, 0x40, 0x05, 0x00,
+    0x50, 0x02, 0x01, 0xd6, 0x01, 0x60, 0x03, 0x09, 0x01, 0x29, 0x00, 0x20, 0x03, 0x02, 0x01, 0x00,
+    0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x29,
+    0x00, 0x21, 0x03, 0x02, 0x01, 0x2f, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00,
+    0x00, 0x60, 0x03, 0x02, 0x03, 0x02, 0x11, 0x01, 0x10, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x06, 0x01, 0x5a, 0x00, 0x24, 0x32, 0x03, 0x05, 0x01, 0x02, 0x00,
+    0x12, 0x01, 0x17, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x2f, 0x00, 0x60, 0x03,
+    0x05, 0x03, 0x09, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x4a, 0x00, 0x20, 0x03, 0x05, 0x01, 0x46,
+    0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x00,
+    0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x4a, 0x00,
+    0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x40, 0x00, 0x20,
+    0x03, 0x08, 0x01, 0x52, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x78, 0x00, 0x60,
+    0x03, 0x04, 0x01, 0x3d, 0x00, 0x21, 0x03, 0x02, 0x01, 0x2c, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00,
+    0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x03, 0x03, 0x11, 0x01, 0x1e, 0x00, 0x20, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x35, 0x00, 0x24, 0x32, 0x03,
+    0x08, 0x01, 0x02, 0x00, 0x12, 0x01, 0x23, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01,
+    0x00, 0x00, 0x60, 0x03, 0x06, 0x03, 0x05, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x18, 0x00, 0x20,
+    0x03, 0x06, 0x01, 0x4d, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x34, 0x01, 0x60,
+    0x03, 0x03, 0x01, 0x33, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03,
+    0x06, 0x01, 0x2a, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x00, 0x00, 0x60, 0x03, 0x06,
+    0x01, 0x4d, 0x00, 0x20, 0x03, 0x06, 0x01, 0x22, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x4d, 0x00, 0x21, 0x03, 0x06, 0x01, 0x15, 0x00, 0x22,
+    0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x09, 0x01, 0x60, 0x03, 0x09, 0x03, 0x02, 0x11, 0x01,
+    0x40, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x40,
+    0x00, 0x24, 0x32, 0x03, 0x02, 0x01, 0x02, 0x00, 0x12, 0x01, 0x5b, 0x00, 0x20, 0x30, 0x40, 0x05,
+    0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x06, 0x03, 0x03, 0x10, 0x01, 0x02, 0x00, 0x13,
+    0x01, 0x10, 0x00, 0x20, 0x03, 0x06, 0x01, 0x37, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x2f, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01,
+    0x1c, 0x00, 0x60, 0x03, 0x01, 0x01, 0x56, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00,
+    0x00, 0x60, 0x03, 0x05, 0x01, 0x39, 0x00, 0x20, 0x03, 0x05, 0x01, 0x0b, 0x00, 0x21, 0x30, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x21, 0x00, 0x21, 0x03, 0x00,
+    0x01, 0x3b, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x00,
+    0x03, 0x03, 0x11, 0x01, 0x52, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x0f, 0x02, 0x60,
+    0x03, 0x09, 0x01, 0x63, 0x00, 0x24, 0x32, 0x03, 0x06, 0x01, 0x02, 0x00, 0x12, 0x01, 0x4e, 0x00,
+    0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x07, 0x03, 0x05, 0x10,
+    0x01, 0x02, 0x00, 0x13, 0x01, 0x26, 0x00, 0x20, 0x03, 0x07, 0x01, 0x21, 0x00, 0x25, 0x31, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x00, 0x01, 0x56, 0x00, 0x20, 0x40, 0x05,
+    0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x02, 0x01, 0x3b, 0x00, 0x23, 0x40, 0x05, 0x00,
+    0x50, 0x01, 0x01, 0xcb, 0x01, 0x60, 0x03, 0x04, 0x01, 0x5d, 0x00, 0x20, 0x03, 0x08, 0x01, 0x38,
+    0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x00, 0x00, 0x60, 0x03, 0x06, 0x01, 0x62,
+    0x00, 0x21, 0x03, 0x08, 0x01, 0x2a, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x01, 0x00,
+    0x00, 0x60, 0x03, 0x00, 0x03, 0x01, 0x11, 0x01, 0x11, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x02,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x2f, 0x00, 0x24, 0x32, 0x03, 0x02, 0x01, 0x02, 0x00,
+    0x12, 0x01, 0x62, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x1a, 0x00, 0x60, 0x03,
+    0x00, 0x03, 0x00, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x20, 0x00, 0x20, 0x03, 0x00, 0x01, 0x08,
+    0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x1b,
+    0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x02, 0x01, 0x5e, 0x00,
+    0x23, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x00, 0x00, 0x20,
+    0x03, 0x08, 0x01, 0x1f, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0xb6, 0x00, 0x60,
+    0x03, 0x01, 0x01, 0x07, 0x00, 0x21, 0x03, 0x07, 0x01, 0x5d, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00,
+    0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x04, 0x03, 0x07, 0x11, 0x01, 0x02, 0x00, 0x20, 0x40,
+    0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x60, 0x00, 0x24, 0x32, 0x03,
+    0x08, 0x01, 0x02, 0x00, 0x12, 0x01, 0x41, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01,
+    0x00, 0x00, 0x60, 0x03, 0x01, 0x03, 0x07, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x1b, 0x00, 0x20,
+    0x03, 0x01, 0x01, 0x28, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x95, 0x01, 0x60,
+    0x03, 0x06, 0x01, 0x20, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03,
+    0x01, 0x01, 0x03, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x09,
+    0x01, 0x5e, 0x00, 0x20, 0x03, 0x07, 0x01, 0x4d, 0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x02,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x07, 0x01, 0x40, 0x00, 0x21, 0x03, 0x04, 0x01, 0x55, 0x00, 0x22,
+    0x31, 0x40, 0x05, 0x00, 0x50, 0x00, 0x01, 0x0a, 0x01, 0x60, 0x03, 0x02, 0x03, 0x03, 0x11, 0x01,
+    0x0f, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x60, 0x03, 0x06, 0x01, 0x0a,
+    0x00, 0x24, 0x32, 0x03, 0x06, 0x01, 0x02, 0x00, 0x12, 0x01, 0x29, 0x00, 0x20, 0x30, 0x40, 0x05,
+    0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x05, 0x03, 0x08, 0x10, 0x01, 0x02, 0x00, 0x13,
+    0x01, 0x48, 0x00, 0x20, 0x03, 0x05, 0x01, 0x56, 0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x00,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x32, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00,
+    0x1d, 0x02, 0x60, 0x03, 0x02, 0x01, 0x29, 0x00, 0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00,
+    0x00, 0x60, 0x03, 0x02, 0x01, 0x46, 0x00, 0x20, 0x03, 0x08, 0x01, 0x38, 0x00, 0x21, 0x30, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x08, 0x01, 0x39, 0x00, 0x21, 0x03, 0x05,
+    0x01, 0x11, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60, 0x03, 0x03,
+    0x03, 0x03, 0x11, 0x01, 0x20, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x2c, 0x01, 0x60,
+    0x03, 0x03, 0x01, 0x3c, 0x00, 0x24, 0x32, 0x03, 0x07, 0x01, 0x02, 0x00, 0x12, 0x01, 0x23, 0x00,
+    0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x03, 0x07, 0x10,
+    0x01, 0x02, 0x00, 0x13, 0x01, 0x0b, 0x00, 0x20, 0x03, 0x05, 0x01, 0x39, 0x00, 0x25, 0x31, 0x40,
+    0x05, 0x00, 0x50, 0x02, 0x01, 0x00, 0x00, 0x60, 0x03, 0x04, 0x01, 0x12, 0x00, 0x20, 0x40, 0x05,
+    0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x02, 0x01, 0x4d, 0x00, 0x23, 0x40, 0x05, 0x00,
+    0x50, 0x01, 0x00, 0xae, 0x00, 0x60, 0x03, 0x09, 0x01, 0x0a, 0x00, 0x20, 0x03, 0x07, 0x01, 0x33,
+    0x00, 0x21, 0x30, 0x40, 0x05, 0x00, 0x50, 0x01, 0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x04,
+    0x00, 0x21, 0x03, 0x00, 0x01, 0x3e, 0x00, 0x22, 0x31, 0x40, 0x05, 0x00, 0x50, 0x01, 0x00, 0x00,
+    0x00, 0x60, 0x03, 0x03, 0x03, 0x03, 0x11, 0x01, 0x27, 0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x01,
+    0x01, 0x00, 0x00, 0x60, 0x03, 0x05, 0x01, 0x20, 0x00, 0x24, 0x32, 0x03, 0x08, 0x01, 0x02, 0x00,
+    0x12, 0x01, 0x29, 0x00, 0x20, 0x30, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x9f, 0x01, 0x60, 0x03,
+    0x00, 0x03, 0x05, 0x10, 0x01, 0x02, 0x00, 0x13, 0x01, 0x07, 0x00, 0x20, 0x03, 0x00, 0x01, 0x2f,
+    0x00, 0x25, 0x31, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x03, 0x01, 0x55,
+    0x00, 0x20, 0x40, 0x05, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x60, 0x03, 0x09, 0x01, 0x43, 0x00,
+    0x23, 0x40, 0x05, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x60,
+};
+
+#define RULE_BENCH_INPUTS 8
+
+// Variable order as RuleVar in src/rule_vm.h
+static const float RULE_BENCH_VARS[RULE_BENCH_INPUTS][10] = {
+    {6, 41, 35, 51, 83, 47, 0, 1, 0, 1},
+    {19, 5, 1, 70, 35, 79, 1, 1, 0, 99},
+    {2, 13, 90, 99, 89, 90, 1, 1, 0, 34},
+    {86, 30, 64, 53, 99, 57, 0, 0, 0, 62},
+    {72, 71, 81, 28, 60, 52, 1, 1, 0, 34},
+    {49, 22, 72, 2, 62, 40, 1, 1, 0, 34},
+    {63, 72, 11, 73, 26, 34, 0, 1, 1, 87},
+    {43, 88, 45, 11, 71, 65, 0, 0, 1, 91},
+};
+
+// Rules whose condition holds for each input (evaluated by the generator)
+static const int RULE_BENCH_FIRED[RULE_BENCH_INPUTS] = {48, 53, 52, 54, 48, 47, 50, 44};
@@ -0,0 +1,272 @@
+// Host tests and benchmark for the telemetry encoders (src/telemetry_schema.h):
+// binary round trip, record walking for the offline log, and the size and
+// encode time of both formats. The backend decoder is checked against the
+// same samples (test/fixtures/telemetry_sample.h) by `npm run check:telemetry`
+// in webapp/backend.
+//
+//   pio test -e native -f test_telemetry_schema
+
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+#include "../fixtures/telemetry_sample.h"
+
+// Host budget for encoding one record. The ESP32 is roughly 20-30x slower than
+// a desktop core, so 10 us here keeps a JSON record well under 0.5 ms on the
+// device, next to the multi-millisecond MQTT publish it feeds.
+#define TELEMETRY_ENCODE_BUDGET_US 10.0
+
+static TelemetrySample sample;
+static uint8_t bin[1024];
+static char json[4096];
+static uint16_t offsets[TELEMETRY_FIELD_COUNT];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+template <typename T>
+static T readAt(uint16_t offset)
+{
+    T v;
+    memcpy(&v, bin + offset, sizeof(T));
+    return v;
+}
+
+static void assertString(const char *expected, uint16_t offset)
+{
+    TEST_ASSERT_EQUAL(strlen(expected), bin[offset]);
+    TEST_ASSERT_EQUAL_MEMORY(expected, bin + offset + 1, bin[offset]);
+}
+
+void test_binary_round_trip(void)
+{
+    for (int v = 0; v < TELEMETRY_SAMPLE_VARIANTS; v++)
+    {
+        telemetrySample(sample, v);
+        size_t len = writeTelemetryBinary(sample, bin, sizeof(bin));
+        TEST_ASSERT_TRUE(len > 0);
+        TEST_ASSERT_TRUE(telemetryBinaryOffsets(bin, len, offsets));
+
+        // Every field, read back from where the walker says it is
+        const uint8_t *base = (const uint8_t *)&sample;
+        for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+        {
+            const TelemetryField &f = TELEMETRY_SCHEMA[i];
+            if (f.kind == TK_STR)
+            {
+                const char *s;
+                memcpy(&s, base + f.offset, sizeof(s));
+                assertString(s, offsets[i]);
+                continue;
+            }
+            size_t n = !f.count ? 1 : telemetry_detail::elementCount(sample, f);
+            TEST_ASSERT_EQUAL_MEMORY(base + f.offset, bin + offsets[i], n * telemetryKindSize(f.kind));
+        }
+        TEST_ASSERT_EQUAL_UINT32(sample.seq, readAt<uint32_t>(offsets[TFI_seq]));
+        TEST_ASSERT_EQUAL(sample.zone_count, bin[offsets[TFI_zone_count]]);
+    }
+}
+
+void test_nan_survives_binary_and_is_null_in_json(void)
+{
+    telemetrySample(sample, 3);
+    TEST_ASSERT_TRUE(isnan(sample.temp));
+    size_t len = writeTelemetryBinary(sample, bin, sizeof(bin));
+    TEST_ASSERT_TRUE(telemetryBinaryOffsets(bin, len, offsets));
+    TEST_ASSERT_TRUE(isnan(readAt<float>(offsets[TFI_temp])));
+
+    TEST_ASSERT_TRUE(writeTelemetryJson(sample, json, sizeof(json)) > 0);
+    TEST_ASSERT_TRUE(strstr(json, "\"temp\": null,") != NULL);
+}
+
+void test_json_fixed_point_rounds_half_away_from_zero(void)
+{
+    telemetrySample(sample, 1);
+    TEST_ASSERT_TRUE(writeTelemetryJson(sample, json, sizeof(json)) > 0);
+    TEST_ASSERT_TRUE(strstr(json, "\"dew_point\": -1.3,") != NULL); // -1.25 exactly
+    TEST_ASSERT_TRUE(strstr(json, "\"vpd\": 1.13,") != NULL);       // 1.125 exactly
+    TEST_ASSERT_TRUE(strstr(json, "\"ts_err\": -1,") != NULL);
+    TEST_ASSERT_TRUE(strstr(json, "\"zones\": {\"soil\": [], ") != NULL); // No zones
+}
+
+void test_json_escapes_strings(void)
+{
+    telemetrySample(sample, 2);
+    TEST_ASSERT_TRUE(writeTelemetryJson(sample, json, sizeof(json)) > 0);
+    TEST_ASSERT_TRUE(strstr(json, "\"version\": \"v3.0 \\\"test\\\" \\\\ build\",") != NULL);
+}
+
+void test_time_offsets_match_full_walk(void)
+{
+    for (int v = 0; v < TELEMETRY_SAMPLE_VARIANTS; v++)
+    {
+        telemetrySample(sample, v);
+        size_t len = writeTelemetryBinary(sample, bin, sizeof(bin));
+        TelemetryTimeOffsets at;
+        TEST_ASSERT_TRUE(telemetryBinaryOffsets(bin, len, offsets));
+        TEST_ASSERT_TRUE(telemetryTimeOffsets(bin, len, at));
+        TEST_ASSERT_EQUAL(offsets[TFI_timestamp], at.timestamp);
+        TEST_ASSERT_EQUAL(offsets[TFI_ts_src], at.tsSrc);
+        TEST_ASSERT_EQUAL(offsets[TFI_ts_err], at.tsErr);
+        TEST_ASSERT_EQUAL(offsets[TFI_boot_id], at.bootId);
+        TEST_ASSERT_EQUAL(offsets[TFI_mono_ms], at.monoMs);
+    }
+}
+
+void test_time_offsets_of_v3_record_without_seq(void)
+{
+    telemetrySample(sample, 0);
+    size_t len = writeTelemetryBinary(sample, bin, sizeof(bin));
+    TEST_ASSERT_TRUE(telemetryBinaryOffsets(bin, len, offsets));
+
+    // Version 3 had no seq: cut it out and relabel the record
+    uint16_t seqAt = offsets[TFI_seq];
+    memmove(bin + seqAt, bin + seqAt + 4, len - seqAt - 4);
+    len -= 4;
+    bin[2] = 3;
+
+    TelemetryTimeOffsets at;
+    TEST_ASSERT_TRUE(telemetryTimeOffsets(bin, len, at));
+    TEST_ASSERT_EQUAL(offsets[TFI_timestamp], at.timestamp);
+    TEST_ASSERT_EQUAL(seqAt, at.monoMs);
+    TEST_ASSERT_EQUAL_UINT32(sample.mono_ms, readAt<uint32_t>(at.monoMs));
+    TEST_ASSERT_FALSE(telemetryBinaryOffsets(bin, len, offsets)); // Not the current version
+
+    bin[2] = 2; // Older than the shared time header
+    TEST_ASSERT_FALSE(telemetryTimeOffsets(bin, len, at));
+    bin[2] = TELEMETRY_SCHEMA_VERSION + 1; // Newer than this firmware
+    TEST_ASSERT_FALSE(telemetryTimeOffsets(bin, len, at));
+}
+
+void test_bad_records_rejected(void)
+{
+    telemetrySample(sample, 2);
+    size_t len = writeTelemetryBinary(sample, bin, sizeof(bin));
+    TelemetryTimeOffsets at;
+    for (size_t cut = 0; cut < len; cut++)
+        TEST_ASSERT_FALSE(telemetryBinaryOffsets(bin, cut, offsets));
+    TEST_ASSERT_FALSE(telemetryTimeOffsets(bin, 2, at));
+    TEST_ASSERT_FALSE(telemetryTimeOffsets(bin, offsets[TFI_mono_ms] + 3, at));
+
+    bin[0] = '{'; // A JSON record, not a binary one
+    TEST_ASSERT_FALSE(telemetryBinaryOffsets(bin, len, offsets));
+    TEST_ASSERT_FALSE(telemetryTimeOffsets(bin, len, at));
+}
+
+void test_writers_report_overflow(void)
+{
+    telemetrySample(sample, 2);
+    size_t binLen = writeTelemetryBinary(sample, bin, sizeof(bin));
+    size_t jsonLen = writeTelemetryJson(sample, json, sizeof(json));
+    TEST_ASSERT_EQUAL(0, writeTelemetryBinary(sample, bin, binLen - 1));
+    TEST_ASSERT_EQUAL(binLen, writeTelemetryBinary(sample, bin, binLen));
+    TEST_ASSERT_EQUAL(0, writeTelemetryJson(sample, json, jsonLen)); // No room for the terminator
+    TEST_ASSERT_EQUAL_STRING("", json); // Not a cut record
+    memset(json, 'x', sizeof(json));
+    TEST_ASSERT_EQUAL(0, writeTelemetryJson(sample, json, 100));
+    TEST_ASSERT_EQUAL_STRING("", json);
+    TEST_ASSERT_EQUAL(jsonLen, writeTelemetryJson(sample, json, jsonLen + 1));
+}
+
+// Every number at its widest, all zones, and strings that double in length
+// when escaped: the bound the firmware sizes its buffers from must be exact
+void test_worst_case_fills_the_size_bounds_exactly(void)
+{
+    static char quotes[TELEMETRY_STR_MAX + 1];
+    memset(quotes, '"', TELEMETRY_STR_MAX);
+    memset(&sample, 0, sizeof(sample));
+    uint8_t *base = (uint8_t *)&sample;
+    for (size_t i = 0; i < TELEMETRY_FIELD_COUNT; i++)
+    {
+        const TelemetryField &f = TELEMETRY_SCHEMA[i];
+        for (size_t e = 0; e < (f.count ? f.count : 1); e++)
+        {
+            uint8_t *at = base + f.offset + e * telemetryKindSize(f.kind);
+            switch (f.kind)
+            {
+            case TK_U8: *at = 255; break;
+            case TK_I8: *(int8_t *)at = INT8_MIN; break;
+            case TK_U16: memcpy(at, "\xff\xff", 2); break;
+            case TK_I16: { int16_t v = INT16_MIN; memcpy(at, &v, 2); break; }
+            case TK_U32: memset(at, 0xff, 4); break;
+            case TK_I32: { int32_t v = INT32_MIN; memcpy(at, &v, 4); break; }
+            case TK_F32: { float v = -1e10f; memcpy(at, &v, 4); break; } // Clamped to 10 digits
+            case TK_STR: { const char *q = quotes; memcpy(at, &q, sizeof(q)); break; }
+            }
+        }
+    }
+    // zone_count stays 255: the zone arrays stop at TELEMETRY_MAX_ZONES, the count is 3 digits
+
+    static char big[TELEMETRY_JSON_MAX + 64];
+    TEST_ASSERT_EQUAL(TELEMETRY_JSON_MAX - 1, writeTelemetryJson(sample, big, sizeof(big)));
+    TEST_ASSERT_EQUAL(TELEMETRY_JSON_MAX - 1, writeTelemetryJson(sample, big, TELEMETRY_JSON_MAX));
+    TEST_ASSERT_EQUAL(TELEMETRY_BINARY_MAX, writeTelemetryBinary(sample, bin, sizeof(bin)));
+    TEST_ASSERT_EQUAL(TELEMETRY_BINARY_MAX, writeTelemetryBinary(sample, bin, TELEMETRY_BINARY_MAX));
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "worst case: %u B JSON, %u B binary", (unsigned)(TELEMETRY_JSON_MAX - 1),
+             (unsigned)TELEMETRY_BINARY_MAX);
+    TEST_MESSAGE(msg);
+}
+
+void test_binary_much_smaller_than_json(void)
+{
+    char msg[128];
+    for (int v = 0; v < TELEMETRY_SAMPLE_VARIANTS; v++)
+    {
+        telemetrySample(sample, v);
+        size_t binLen = writeTelemetryBinary(sample, bin, sizeof(bin));
+        size_t jsonLen = writeTelemetryJson(sample, json, sizeof(json));
+        snprintf(msg, sizeof(msg), "sample %d (%u zones): %u B binary, %u B JSON (%.0f%%)", v, sample.zone_count,
+                 (unsigned)binLen, (unsigned)jsonLen, 100.0 * binLen / jsonLen);
+        TEST_MESSAGE(msg);
+        TEST_ASSERT_LESS_THAN(jsonLen / 3, binLen); // What makes the binary offline log worth having
+        TEST_ASSERT_LESS_THAN(TELEMETRY_JSON_MAX, jsonLen); // Fits the firmware's buffers
+        TEST_ASSERT_TRUE(binLen <= TELEMETRY_BINARY_MAX);
+    }
+}
+
+template <typename Encode>
+static double encodeUs(Encode encode)
+{
+    const int rounds = 20000;
+    volatile size_t sink = 0;
+    for (int i = 0; i < 1000; i++) // Warm-up
+        sink += encode();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        sink += encode();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / rounds;
+}
+
+void test_encode_within_budget(void)
+{
+    telemetrySample(sample, 2);
+    double jsonUs = encodeUs([] { return writeTelemetryJson(sample, json, sizeof(json)); });
+    double binUs = encodeUs([] { return writeTelemetryBinary(sample, bin, sizeof(bin)); });
+    char msg[96];
+    snprintf(msg, sizeof(msg), "encode: %.2f us JSON, %.2f us binary per record", jsonUs, binUs);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN(TELEMETRY_ENCODE_BUDGET_US, jsonUs);
+    TEST_ASSERT_LESS_THAN(TELEMETRY_ENCODE_BUDGET_US, binUs);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_binary_round_trip);
+    RUN_TEST(test_nan_survives_binary_and_is_null_in_json);
+    RUN_TEST(test_json_fixed_point_rounds_half_away_from_zero);
+    RUN_TEST(test_json_escapes_strings);
+    RUN_TEST(test_time_offsets_match_full_walk);
+    RUN_TEST(test_time_offsets_of_v3_record_without_seq);
+    RUN_TEST(test_bad_records_rejected);
+    RUN_TEST(test_writers_report_overflow);
+    RUN_TEST(test_worst_case_fills_the_size_bounds_exactly);
+    RUN_TEST(test_binary_much_smaller_than_json);
+    RUN_TEST(test_encode_within_budget);
+    return UNITY_END();
+}
@@ -25,5 +25,7 @@ module.exports = {
     docClient,
     TABLE_NAME: "GreenhouseUserDevices",
     HISTORY_TABLE: "GreenhouseSensorData",
-    ALERTS_TABLE: "GreenhouseAlerts"
+    ALERTS_TABLE: "GreenhouseAlerts",
+    SHADOW_TABLE: "GreenhouseShadows",
+    EVENTS_TABLE: "GreenhouseActuatorEvents"
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-const { docClient, TABLE_NAME, HISTORY_TABLE, ALERTS_TABLE } = require('../config/aws');
+const { docClient, TABLE_NAME, HISTORY_TABLE, ALERTS_TABLE, EVENTS_TABLE } = require('../config/aws');
 
 // 1. Get User's Devices
 exports.getDevices = async (req, res) => {
@@ -166,4 +166,117 @@ exports.getDeviceHistory = async (req, res) => {
     console.error("DynamoDB History Error:", err);
     res.status(500).json({ error: "Failed to fetch history" });
   }
-};
\ No newline at end of file
+};
+
+// 8. Get Sequence Gaps (data loss per boot)
+// Every record carries (boot_id, seq) with seq counting up from 1 each boot,
+// so missing seq values within a boot are records that never arrived.
+// Losses after the last received record of a boot cannot be detected.
+exports.getDeviceGaps = async (req, res) => {
+  const { deviceId } = req.params;
+  const { start, end } = req.query;
+
+  let startTime = Math.floor(Date.now() / 1000) - (24 * 60 * 60);
+  let endTime = Math.floor(Date.now() / 1000);
+
+  if (start) startTime = parseInt(start);
+  if (end) endTime = parseInt(end);
+
+  const params = {
+    TableName: HISTORY_TABLE,
+    KeyConditionExpression: "deviceId = :did AND #ts BETWEEN :start AND :end",
+    ProjectionExpression: "boot_id, seq",
+    ExpressionAttributeNames: { "#ts": "timestamp" },
+    ExpressionAttributeValues: {
+      ":did": deviceId,
+      ":start": startTime,
+      ":end": endTime + 1 // Keys carry a sub-second fraction
+    }
+  };
+
+  try {
+    const boots = new Map();
+    do {
+      const data = await docClient.query(params).promise();
+      for (const item of data.Items) {
+        if (item.boot_id === undefined || item.seq === undefined) continue; // Older firmware
+        if (!boots.has(item.boot_id)) boots.set(item.boot_id, new Set());
+        boots.get(item.boot_id).add(item.seq);
+      }
+      params.ExclusiveStartKey = data.LastEvaluatedKey;
+    } while (params.ExclusiveStartKey);
+
+    let received = 0;
+    let expected = 0;
+    const gaps = [];
+    for (const [bootId, seqSet] of [...boots.entries()].sort((a, b) => a[0] - b[0])) {
+      const seqs = [...seqSet].sort((a, b) => a - b);
+      received += seqs.length;
+      expected += seqs[seqs.length - 1] - seqs[0] + 1;
+      for (let i = 1; i < seqs.length; i++) {
+        if (seqs[i] > seqs[i - 1] + 1) {
+          gaps.push({ boot_id: bootId, from: seqs[i - 1] + 1, to: seqs[i] - 1, missing: seqs[i] - seqs[i - 1] - 1 });
+        }
+      }
+    }
+
+    res.json({
+      deviceId,
+      start: startTime,
+      end: endTime,
+      boots: boots.size,
+      received,
+      expected,
+      missing: expected - received,
+      lossPct: expected ? Math.round((expected - received) * 10000 / expected) / 100 : 0,
+      gaps
+    });
+  } catch (err) {
+    console.error("DynamoDB Gaps Error:", err);
+    res.status(500).json({ error: "Failed to compute gaps" });
+  }
+};
+
+// 9. Get Actuator Events (transitions with reason; on-time per actuator)
+// Each "off" event carries held_ms, the length of the run it ends, so the
+// on-time in the range is exact even for pulses shorter than a telemetry period.
+exports.getDeviceEvents = async (req, res) => {
+  const { deviceId } = req.params;
+  const { start, end } = req.query;
+
+  let startTime = Math.floor(Date.now() / 1000) - (24 * 60 * 60);
+  let endTime = Math.floor(Date.now() / 1000);
+
+  if (start) startTime = parseInt(start);
+  if (end) endTime = parseInt(end);
+
+  const params = {
+    TableName: EVENTS_TABLE,
+    KeyConditionExpression: "deviceId = :did AND #ts BETWEEN :start AND :end",
+    ExpressionAttributeNames: { "#ts": "timestamp" },
+    ExpressionAttributeValues: {
+      ":did": deviceId,
+      ":start": startTime,
+      ":end": endTime + 1 // Keys carry a sub-second fraction
+    },
+    ScanIndexForward: true
+  };
+
+  try {
+    const events = [];
+    do {
+      const data = await docClient.query(params).promise();
+      events.push(...data.Items);
+      params.ExclusiveStartKey = data.LastEvaluatedKey;
+    } while (params.ExclusiveStartKey);
+
+    const onMs = {};
+    for (const e of events) {
+      if (!e.on) onMs[e.act] = (onMs[e.act] || 0) + e.held_ms;
+    }
+    res.json({ deviceId, start: startTime, end: endTime, onMs, events });
+  } catch (err) {
+    console.error("DynamoDB Events Error:", err);
+    res.status(500).json({ error: "Failed to fetch events" });
+  }
+};
@@ -13,5 +13,7 @@ router.delete('/devices/:deviceId', verifyAuth, deviceController.removeDevice);
 router.get('/devices/:deviceId/status', verifyAuth, deviceController.getDeviceStatus);
 router.get('/alerts/:deviceId', verifyAuth, deviceController.getDeviceAlerts);
 router.get('/history/:deviceId', verifyAuth, deviceController.getDeviceHistory);
+router.get('/devices/:deviceId/gaps', verifyAuth, deviceController.getDeviceGaps);
+router.get('/devices/:deviceId/events', verifyAuth, deviceController.getDeviceEvents);
 
 module.exports = router;
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Checks the generated binary decoder (services/telemetrySchema.js) against
+// the firmware encoder: builds test/fixtures/telemetry_dump.cpp with the host
+// compiler, encodes each sample from telemetry_sample.h both ways and expects
+// decodeTelemetry(binary) to equal JSON.parse(json) exactly.
+//
+//   npm run check:telemetry        (needs g++, or set CXX)
+
+const { execFileSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { SCHEMA_VERSION, decodeTelemetry } = require('../services/telemetrySchema');
+
+const ROOT = path.join(__dirname, '..', '..', '..');
+const SOURCE = path.join(ROOT, 'test', 'fixtures', 'telemetry_dump.cpp');
+
+// Lists the paths where `a` and `b` differ ("" for the root)
+const diff = (a, b, at = '') => {
+    if (typeof a !== typeof b || Array.isArray(a) !== Array.isArray(b) || (a === null) !== (b === null)) {
+        return [`${at || '/'}: decoded ${JSON.stringify(a)}, firmware JSON ${JSON.stringify(b)}`];
+    }
+    if (a === null || typeof a !== 'object') {
+        return Object.is(a, b) ? [] : [`${at || '/'}: decoded ${JSON.stringify(a)}, firmware JSON ${JSON.stringify(b)}`];
+    }
+    const out = [];
+    for (const key of new Set([...Object.keys(a), ...Object.keys(b)])) out.push(...diff(a[key], b[key], `${at}/${key}`));
+    return out;
+};
+
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'telemetry-check-'));
+const exe = path.join(dir, 'telemetry_dump');
+try {
+    execFileSync(process.env.CXX || 'g++', [
+        '-std=gnu++17', '-O2', `-I${path.join(ROOT, 'src')}`, `-I${path.join(ROOT, 'test', 'fixtures')}`, SOURCE, '-o', exe
+    ], { stdio: 'inherit' });
+    const lines = execFileSync(exe, { encoding: 'utf8' }).trim().split('\n');
+
+    let failed = 0;
+    lines.forEach((line, i) => {
+        const sep = line.indexOf(' ');
+        const bin = Buffer.from(line.slice(0, sep), 'hex');
+        const json = line.slice(sep + 1);
+        const problems = diff(decodeTelemetry(bin), JSON.parse(json));
+        console.log(`sample ${i}: ${bin.length} B binary, ${Buffer.byteLength(json)} B JSON - ${problems.length ? 'MISMATCH' : 'ok'}`);
+        problems.forEach((p) => console.log(`    ${p}`));
+        if (problems.length) failed++;
+    });
+    if (failed) {
+        console.error(`${failed} of ${lines.length} samples decode differently from the firmware JSON (schema v${SCHEMA_VERSION})`);
+        process.exitCode = 1;
+    } else {
+        console.log(`Decoder matches the firmware encoder (schema v${SCHEMA_VERSION}, ${lines.length} samples)`);
+    }
+} finally {
+    fs.rmSync(dir, { recursive: true, force: true });
+}
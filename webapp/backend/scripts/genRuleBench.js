@@ -0,0 +1,84 @@
+// Generates test/test_rule_vm/rules_100.h for the firmware rule VM benchmark:
+// 100 rules compiled with services/ruleCompiler.js, plus input vectors and the
+// number of rules whose condition holds for each (evaluated here in JS), so
+// the host test checks the compiler and the VM against each other.
+//
+//   npm run gen:rule-bench
+
+const fs = require('fs');
+const path = require('path');
+const { compileRules } = require('../services/ruleCompiler');
+
+const OUTPUT = path.join(__dirname, '..', '..', '..', 'test', 'test_rule_vm', 'rules_100.h');
+const VARS = ['temp', 'hum', 'soil', 'co2', 'tvoc', 'tank', 'pump', 'fan', 'heater', 'hour'];
+const OUTPUTS = ['pump', 'fan', 'heater'];
+
+// Small deterministic PRNG, so regenerating gives the same file
+let seed = 12345;
+const rand = (n) => {
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+    return (seed >> 16) % n;
+};
+
+// Each template returns [rule text, condition as a JS function of the inputs]
+const TEMPLATES = [
+    (a, n) => [`${a} > ${n}`, (v) => v[a] > n],
+    (a, n) => [`${a} <= ${n}`, (v) => v[a] <= n],
+    (a, n, b, m) => [`${a} > ${n} and ${b} < ${m}`, (v) => v[a] > n && v[b] < m],
+    (a, n, b, m) => [`${a} < ${n} or ${b} >= ${m}`, (v) => v[a] < n || v[b] >= m],
+    (a, n, b) => [`${a} - ${b} > ${n}`, (v) => v[a] - v[b] > n],
+    (a, n, b, m) => [`not (${a} == ${n}) and ${b} * 2 > ${m}`, (v) => !(v[a] === n) && v[b] * 2 > m],
+    (a, n, b, m) => [`(${a} + ${b}) / 2 > ${n} or ${a} != ${m}`, (v) => (v[a] + v[b]) / 2 > n || v[a] !== m]
+];
+
+const rules = [];
+for (let i = 0; i < 100; i++) {
+    const a = VARS[rand(VARS.length)];
+    const b = VARS[rand(VARS.length)];
+    const [text, cond] = TEMPLATES[i % TEMPLATES.length](a, rand(100), b, rand(100));
+    const out = OUTPUTS[rand(OUTPUTS.length)];
+    const hold = i % 4 === 0 ? ` for ${1 + rand(600)}s` : '';
+    rules.push({ text: `if ${text} then ${out} = ${rand(2)}${hold}`, cond });
+}
+
+const { program } = compileRules(rules.map((r) => r.text).join('\n'));
+
+const inputs = [];
+for (let k = 0; k < 8; k++) {
+    const v = {};
+    VARS.forEach((name) => {
+        v[name] = name === 'pump' || name === 'fan' || name === 'heater' ? rand(2) : rand(100);
+    });
+    inputs.push(v);
+}
+const fired = inputs.map((v) => rules.filter((r) => r.cond(v)).length);
+
+const bytes = [...program].map((x) => `0x${x.toString(16).padStart(2, '0')}`);
+const rows = [];
+for (let i = 0; i < bytes.length; i += 16) rows.push(`    ${bytes.slice(i, i + 16).join(', ')},`);
+
+const out = `// Generated by webapp/backend/scripts/genRuleBench.js - do not edit.
+#pragma once
+
+#include <stdint.h>
+
+// ${rules.length} rules, ${program.length} bytes, e.g.
+${rules.slice(0, 3).map((r) => `//   ${r.text}`).join('\n')}
+static const uint8_t RULES_100[] = {
+${rows.join('\n')}
+};
+
+#define RULE_BENCH_INPUTS ${inputs.length}
+
+// Variable order as RuleVar in src/rule_vm.h
+static const float RULE_BENCH_VARS[RULE_BENCH_INPUTS][${VARS.length}] = {
+${inputs.map((v) => `    {${VARS.map((n) => v[n]).join(', ')}},`).join('\n')}
+};
+
+// Rules whose condition holds for each input (evaluated by the generator)
+static const int RULE_BENCH_FIRED[RULE_BENCH_INPUTS] = {${fired.join(', ')}};
+`;
+
+fs.mkdirSync(path.dirname(OUTPUT), { recursive: true });
+fs.writeFileSync(OUTPUT, out);
+console.log(`Wrote ${path.relative(process.cwd(), OUTPUT)} (${rules.length} rules, ${program.length} bytes)`);
@@ -0,0 +1,160 @@
+// Generates services/telemetrySchema.js from the firmware's telemetry table
+// (src/telemetry_schema.h), so the backend decoder and the DynamoDB history
+// fields can never drift from what the device sends. Older layouts are kept in
+// scripts/telemetryLayouts.json so records logged before a firmware update
+// still decode.
+//
+//   npm run gen:telemetry
+
+const fs = require('fs');
+const path = require('path');
+
+const HEADER = path.join(__dirname, '..', '..', '..', 'src', 'telemetry_schema.h');
+const OUTPUT = path.join(__dirname, '..', 'services', 'telemetrySchema.js');
+const LAYOUTS = path.join(__dirname, 'telemetryLayouts.json');
+
+const READERS = {
+    TK_U8: ['readUInt8', 1],
+    TK_I8: ['readInt8', 1],
+    TK_U16: ['readUInt16LE', 2],
+    TK_I16: ['readInt16LE', 2],
+    TK_U32: ['readUInt32LE', 4],
+    TK_I32: ['readInt32LE', 4],
+    TK_F32: ['readFloatLE', 4]
+};
+
+const parseHeader = (src) => {
+    const define = (name) => {
+        const m = src.match(new RegExp(`#define ${name} (\\S+)`));
+        if (!m) throw new Error(`${name} not found in ${HEADER}`);
+        return m[1];
+    };
+    // Every numeric TELEMETRY_* constant, for TA element counts
+    const constants = {};
+    for (const [, name, value] of src.matchAll(/^#define (TELEMETRY_\w+) (\d+)\b/gm)) constants[name] = parseInt(value, 10);
+    const fields = [];
+    const re = /^\s*(TF|TA)\((.*)\)\s*\\?\s*$/gm;
+    let m;
+    while ((m = re.exec(src))) {
+        const a = m[2].split(',').map((s) => s.trim());
+        if (m[1] === 'TF') {
+            const [member, , kind, decimals, history] = a;
+            fields.push({ key: member, kind, decimals: +decimals, count: 0, group: 'TG_ROOT', history: history === '1' });
+        } else {
+            const [, key, , kind, decimals, count, group, history] = a;
+            const n = constants[count] !== undefined ? constants[count] : parseInt(count, 10);
+            if (!(n > 0)) throw new Error(`Unknown element count ${count} for ${key}`);
+            fields.push({ key: JSON.parse(key), kind, decimals: +decimals, count: n, group, history: history === '1' });
+        }
+    }
+    if (!fields.length) throw new Error('No telemetry fields found');
+    return { version: parseInt(define('TELEMETRY_SCHEMA_VERSION'), 10), fields };
+};
+
+// Field layout of every schema version a device may still send: the current
+// one, plus older ones still sitting in offline logs written before a firmware
+// update. Each run records the current layout; a layout that changes without
+// a TELEMETRY_SCHEMA_VERSION bump is refused, since devices in the field could
+// hold records of either shape under the same number.
+const updateLayouts = ({ version, fields }) => {
+    const layouts = fs.existsSync(LAYOUTS) ? JSON.parse(fs.readFileSync(LAYOUTS, 'utf8')) : {};
+    const layout = fields.map((f) => [f.key, f.kind.slice(3), f.decimals, f.count, f.group === 'TG_ZONES' ? 1 : 0]);
+    const known = layouts[version];
+    if (known && JSON.stringify(known) !== JSON.stringify(layout)) {
+        throw new Error(`The telemetry table changed but TELEMETRY_SCHEMA_VERSION is still ${version}: bump it (or drop ` +
+            `version ${version} from ${path.relative(process.cwd(), LAYOUTS)} if it never shipped)`);
+    }
+    layouts[version] = layout;
+    const versions = Object.keys(layouts).map(Number).sort((a, b) => a - b);
+    const body = versions.map((v) => `  "${v}": [\n${layouts[v].map((f) => `    ${JSON.stringify(f)}`).join(',\n')}\n  ]`);
+    fs.writeFileSync(LAYOUTS, `{\n${body.join(',\n')}\n}\n`);
+    return versions.map((v) => [v, layouts[v]]);
+};
+
+const generate = ({ version, fields }, layouts) => {
+    const history = [];
+    for (const f of fields.filter((x) => x.history)) {
+        const key = f.group === 'TG_ZONES' ? 'zones' : f.key;
+        if (!history.includes(key)) history.push(key);
+    }
+    const entry = (f) => `[${f.map((x) => (typeof x === 'string' ? `'${x}'` : x)).join(', ')}]`;
+    const table = layouts.map(([v, layout]) => `    ${v}: [\n${layout.map((f) => `        ${entry(f)}`).join(',\n')}\n    ]`);
+    const readers = Object.entries(READERS).map(([k, [fn, size]]) => `    ${k.slice(3)}: ['${fn}', ${size}]`);
+
+    return `// GENERATED by scripts/genTelemetrySchema.js from src/telemetry_schema.h.
+// Do not edit: change the firmware table and run \`npm run gen:telemetry\`.
+
+const SCHEMA_VERSION = ${version};
+
+// Top-level keys stored in the history table
+const HISTORY_FIELDS = ${JSON.stringify(history)};
+
+// [key, kind, decimals, count (0 = scalar), in "zones"] per field, for the
+// current schema and every older one an offline log may still hold
+const LAYOUTS = {
+${table.join(',\n')}
+};
+
+const READERS = {
+${readers.join(',\n')}
+};
+
+// Same digits as TelemetryOut::fixed(): NaN becomes null, halves round away
+// from zero, and the scaling is done in single precision like the firmware.
+const round = (v, decimals) => {
+    if (Number.isNaN(v)) return null;
+    const p = 10 ** decimals;
+    const scaled = Math.min(Math.floor(Math.fround(Math.fround(Math.abs(v) * p) + 0.5)), 4294967040);
+    return (v < 0 && scaled ? -scaled : scaled) / p;
+};
+
+// Decodes a binary record ('G' 'T' <version> <fields...>) into the same shape
+// as the JSON telemetry of that version. Returns null if the buffer is not a
+// binary record.
+const decodeTelemetry = (buf) => {
+    if (buf.length < 3 || buf[0] !== 0x47 || buf[1] !== 0x54) return null;
+    const layout = LAYOUTS[buf[2]];
+    if (!layout) throw new Error(\`Unsupported telemetry schema \${buf[2]} (known: \${Object.keys(LAYOUTS).join(', ')})\`);
+    let o = 3;
+    const value = (kind, decimals) => {
+        if (kind === 'STR') {
+            const n = buf.readUInt8(o);
+            if (o + 1 + n > buf.length) throw new RangeError('Truncated telemetry record');
+            const s = buf.toString('utf8', o + 1, o + 1 + n);
+            o += 1 + n;
+            return s;
+        }
+        const [fn, size] = READERS[kind];
+        const v = buf[fn](o);
+        o += size;
+        return kind === 'F32' ? round(v, decimals) : v;
+    };
+    const d = { zones: {} };
+    for (const [key, kind, decimals, count, zones] of layout) {
+        const target = zones ? d.zones : d;
+        if (!count) {
+            target[key] = value(kind, decimals);
+            continue;
+        }
+        const n = zones ? Math.min(d.zone_count, count) : count;
+        target[key] = [];
+        for (let i = 0; i < n; i++) target[key].push(value(kind, decimals));
+    }
+    return d;
+};
+
+const historyItem = (data) => {
+    const item = {};
+    for (const key of HISTORY_FIELDS) item[key] = data[key];
+    return item;
+};
+
+module.exports = { SCHEMA_VERSION, HISTORY_FIELDS, decodeTelemetry, historyItem };
+`;
+};
+
+const schema = parseHeader(fs.readFileSync(HEADER, 'utf8'));
+const layouts = updateLayouts(schema);
+fs.writeFileSync(OUTPUT, generate(schema, layouts));
+console.log(`Wrote ${path.relative(process.cwd(), OUTPUT)} (${schema.fields.length} fields, schema v${schema.version}, ` +
+    `decodes v${layouts.map(([v]) => v).join(', v')})`);
@@ -11,7 +11,8 @@ require('dotenv').config({ path: path.join(__dirname, '.env') });
 
 // Import Modules
 const apiRoutes = require('./routes/api');
-const { initIoT, publishCommand } = require('./services/iotService');
+const { initIoT, publishCommand, getShadow, updateDesired, shadowView } = require('./services/iotService');
+const { compileRules } = require('./services/ruleCompiler');
 
 // Fix for Node.js 17+ IPv6 issues
 if (dns.setDefaultResultOrder) {
@@ -69,6 +70,11 @@ io.on('connection', (socket) => {
       console.log(`Socket ${socket.id} joining device room: ${deviceId}`);
       socket.join(deviceId);
       socket.deviceId = deviceId;
+
+      // Desired vs reported config, so the dashboard shows what is really applied
+      getShadow(deviceId)
+          .then(shadow => socket.emit('shadow', shadowView(shadow)))
+          .catch(err => console.error("Failed to load shadow:", err));
   });
 
   // Handle Control Commands
@@ -94,7 +100,35 @@ io.on('connection', (socket) => {
         return;
     }
 
-    publishCommand(socket.deviceId, config);
+    // Stored as desired state; the device gets it now or on its next connect
+    updateDesired(socket.deviceId, config)
+        .then(version => socket.emit('config-queued', { version }))
+        .catch(err => {
+            console.error("Failed to update shadow:", err);
+            socket.emit('config-error', { message: 'Failed to save configuration' });
+        });
+  });
+
+  // Handle Automation Rules (compiled here, shipped to the device as bytecode)
+  socket.on('rules-update', (text) => {
+    if (!socket.deviceId) return;
+    const queueRules = (rules) => updateDesired(socket.deviceId, { rules }).catch(err => {
+        console.error("Failed to update shadow:", err);
+        socket.emit('rules-error', { message: 'Failed to save rules' });
+    });
+    if (!text || !text.trim()) {
+        queueRules(null);
+        socket.emit('rules-compiled', { rules: 0, bytes: 0 });
+        return;
+    }
+    try {
+        const { program, rules } = compileRules(text);
+        console.log(`Rules for ${socket.deviceId}: ${rules} rules, ${program.length} bytes`);
+        queueRules(program.toString('base64'));
+        socket.emit('rules-compiled', { rules, bytes: program.length });
+    } catch (e) {
+        socket.emit('rules-error', { message: e.message });
+    }
   });
 
   socket.on('disconnect', () => {
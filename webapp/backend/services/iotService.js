@@ -1,13 +1,198 @@
 const awsIot = require('aws-iot-device-sdk');
 const path = require('path');
 const fs = require('fs');
-const { docClient, HISTORY_TABLE, ALERTS_TABLE } = require('../config/aws');
+const crypto = require('crypto');
+const { docClient, HISTORY_TABLE, ALERTS_TABLE, SHADOW_TABLE, EVENTS_TABLE } = require('../config/aws');
+const { decodeTelemetry, historyItem } = require('./telemetrySchema');
 
 const DEVICE_NAME = 'GreenHouse_Hub';
 const AWS_IOT_ENDPOINT = process.env.AWS_IOT_ENDPOINT;
 
 let device;
 
+// Devices send wall-clock times (repaired after NTP sync, see ts_src/ts_err).
+// A record captured without any clock and never rebased falls back to arrival time.
+const EPOCH_VALID = 1600000000;
+const recordTimestamp = (data) => (data.timestamp > EPOCH_VALID ? data.timestamp : Math.floor(Date.now() / 1000));
+
+// Idempotent record writes. Repeats are recognised by the device-assigned
+// (boot_id, seq), never by the timestamp: a record sent live with a
+// provisional time and re-sent from the offline log after the device rebased
+// it arrives with a different timestamp. Each record is written in one
+// transaction with a marker item keyed by (boot_id, seq) in the partition
+// "<deviceId>#<kind>"; a repeat fails the marker's condition and nothing is
+// stored. The record's own condition only catches two different records on
+// the same sort key, which then moves on to the next millisecond.
+const hasSeq = (data) => Number.isInteger(data.boot_id) && Number.isInteger(data.seq);
+
+// The v2 SDK only reports which transaction items failed in the message,
+// e.g. "Transaction cancelled, ... [ConditionalCheckFailed, None]"
+const cancelledItems = (err) => {
+    const m = /\[([^\]]*)\]\s*$/.exec(err.message || '');
+    return m ? m[1].split(',').map((r) => r.trim() === 'ConditionalCheckFailed') : [];
+};
+
+const putOnce = async (table, kind, deviceId, data, item) => {
+    let { timestamp } = item;
+    for (let attempt = 0; attempt < 3; attempt++) {
+        const put = { TableName: table, Item: { ...item, timestamp }, ConditionExpression: 'attribute_not_exists(deviceId)' };
+        try {
+            if (hasSeq(data)) {
+                const marker = { deviceId: `${deviceId}#${kind}`, timestamp: data.boot_id * 2 ** 32 + data.seq, at: timestamp };
+                await docClient.transactWrite({
+                    TransactItems: [{ Put: { TableName: table, Item: marker, ConditionExpression: 'attribute_not_exists(deviceId)' } }, { Put: put }]
+                }).promise();
+            } else {
+                await docClient.put(put).promise(); // Older firmware: no sequence to go by
+            }
+            return true;
+        } catch (err) {
+            if (err.code === 'TransactionCanceledException') {
+                const [repeat, taken] = cancelledItems(err);
+                if (repeat) return false;
+                if (!taken) throw err;
+            } else if (err.code !== 'ConditionalCheckFailedException') {
+                throw err;
+            }
+            timestamp = Math.round(timestamp * 1000 + 1) / 1000;
+        }
+    }
+    throw new Error(`No free ${kind} key near ${timestamp}`);
+};
+
+// The sort key carries the capture's sub-second phase (mono_ms) so two
+// samples in one second do not overwrite each other
+const saveHistory = async (deviceId, data) => {
+    let timestamp = recordTimestamp(data);
+    if (Number.isInteger(data.mono_ms)) timestamp += (data.mono_ms % 1000) / 1000;
+    return putOnce(HISTORY_TABLE, 'data', deviceId, data, { deviceId, timestamp, ...historyItem(data) });
+};
+
+// --- Device Shadow ---
+// `desired` is the config the dashboard asked for. Every change bumps
+// `version`, and `keyVersions` records the version that last touched each key,
+// so a device that has applied version N is sent only the keys changed after
+// N. `reported` is what the device says it is running (after its own
+// validation), stamped with the desired version it had applied. A version
+// the device refused is reported with the keys it rejected (or the parse
+// error), and the device keeps the version it had.
+const emptyShadow = (deviceId) => ({ deviceId, version: 0, desired: {}, keyVersions: {}, reported: null, reportedVersion: 0 });
+
+const getShadow = async (deviceId) => {
+    const data = await docClient.get({ TableName: SHADOW_TABLE, Key: { deviceId } }).promise();
+    return data.Item || emptyShadow(deviceId);
+};
+
+// The device parses a desired message in its MQTT buffer (MQTT_BUFFER_SIZE,
+// 6144 B, less the packet header and topic)
+const SHADOW_MSG_MAX = 6000;
+
+// Sends one desired version, split into parts that each fit the device's
+// buffer: compiled rules alone can take most of it. Every part but the last
+// is marked `more`; the device acknowledges the version after the last one.
+const publishShadow = (deviceId, doc) => {
+    if (!device) return;
+    const { state, ...head } = doc;
+    const envelope = JSON.stringify({ ...head, more: true, state: {} }).length;
+    const parts = [];
+    let part = {};
+    let size = envelope;
+    for (const [key, value] of Object.entries(state)) {
+        const entry = JSON.stringify({ [key]: value }).length - 1; // Braces out, comma in
+        if (envelope + entry > SHADOW_MSG_MAX) console.error(`Shadow key ${key} for ${deviceId} is too large for the device`);
+        if (Object.keys(part).length > 0 && size + entry > SHADOW_MSG_MAX) {
+            parts.push(part);
+            part = {};
+            size = envelope;
+        }
+        part[key] = value;
+        size += entry;
+    }
+    parts.push(part);
+    parts.forEach((p, i) => {
+        const msg = i < parts.length - 1 ? { ...head, more: true, state: p } : { ...head, state: p };
+        device.publish(`greenhouse/${deviceId}/shadow/desired`, JSON.stringify(msg));
+    });
+};
+
+// Merges `changes` into the desired state and sends them to the device as one
+// versioned delta. The conditional put keeps versions strictly increasing when
+// two dashboards save at once.
+const updateDesired = async (deviceId, changes) => {
+    for (let attempt = 0; attempt < 3; attempt++) {
+        const shadow = await getShadow(deviceId);
+        const version = shadow.version + 1;
+        const keyVersions = { ...shadow.keyVersions };
+        for (const key of Object.keys(changes)) keyVersions[key] = version;
+        try {
+            await docClient.put({
+                TableName: SHADOW_TABLE,
+                Item: { ...shadow, version, desired: { ...shadow.desired, ...changes }, keyVersions, updatedAt: Date.now() },
+                ConditionExpression: 'attribute_not_exists(deviceId) OR version = :v',
+                ExpressionAttributeValues: { ':v': shadow.version }
+            }).promise();
+        } catch (err) {
+            if (err.code === 'ConditionalCheckFailedException') continue;
+            throw err;
+        }
+        publishShadow(deviceId, { version, state: changes });
+        return version;
+    }
+    throw new Error(`Shadow update for ${deviceId} kept conflicting`);
+};
+
+// Device (re)connected having applied `since`: send what it missed. A device
+// ahead of the backend (shadow table reset) gets the whole desired state.
+const sendShadowDelta = async (deviceId, since) => {
+    const shadow = await getShadow(deviceId);
+    if (!shadow.version) return;
+    const reset = since > shadow.version;
+    const state = {};
+    for (const [key, version] of Object.entries(shadow.keyVersions)) {
+        if (reset || version > since) state[key] = shadow.desired[key];
+    }
+    if (!reset && Object.keys(state).length === 0) return;
+    publishShadow(deviceId, reset ? { version: shadow.version, reset: true, state } : { version: shadow.version, state });
+};
+
+const saveReported = async (deviceId, report) => {
+    const data = await docClient.update({
+        TableName: SHADOW_TABLE,
+        Key: { deviceId },
+        UpdateExpression: 'set reported = :r, reportedVersion = :v, rejected = :k, rejectedVersion = :kv, reportError = :e, reportedAt = :t',
+        ExpressionAttributeValues: {
+            ':r': report.state,
+            ':v': report.version || 0,
+            ':k': report.rejected || [],
+            ':kv': report.rejected_version || 0,
+            ':e': report.error || null,
+            ':t': Date.now()
+        },
+        ReturnValues: 'ALL_NEW'
+    }).promise();
+    return { ...emptyShadow(deviceId), ...data.Attributes };
+};
+
+// What the dashboard needs: desired vs reported and whether they agree
+const shadowView = (shadow) => ({
+    version: shadow.version,
+    desired: shadow.desired,
+    reported: shadow.reported,
+    reportedVersion: shadow.reportedVersion,
+    rejected: shadow.rejected || [],
+    rejectedVersion: shadow.rejectedVersion || 0,
+    error: shadow.reportError || null,
+    inSync: shadow.reportedVersion >= shadow.version
+});
+
+// Actuator transitions (greenhouse/<id>/events). The sort key carries the
+// microsecond phase from t_us; repeats are dropped on (boot_id, seq) as for
+// telemetry (events count their own seq).
+const saveEvent = async (deviceId, event) => {
+    const timestamp = recordTimestamp(event) + (Number(event.t_us) % 1000000) / 1000000;
+    return putOnce(EVENTS_TABLE, 'event', deviceId, event, { deviceId, timestamp, ...event });
+};
+
 const initIoT = (io) => {
     // Check if certs exist
     const certsDir = path.join(__dirname, '..', 'certs');
@@ -29,7 +214,11 @@ const initIoT = (io) => {
             console.log('✅ Connected to AWS IoT Core');
             device.subscribe('greenhouse/+/data');
             device.subscribe('greenhouse/+/alerts');
-            console.log('✅ Subscribed to greenhouse/+/data & alerts');
+            device.subscribe('greenhouse/+/shadow/get');
+            device.subscribe('greenhouse/+/shadow/reported');
+            device.subscribe('greenhouse/+/ack');
+            device.subscribe('greenhouse/+/events');
+            console.log('✅ Subscribed to greenhouse/+/data, alerts & shadow');
         });
 
         device.on('message', (topic, payload) => {
@@ -40,37 +229,23 @@ const initIoT = (io) => {
             if (topicParts.length === 3 && topicParts[2] === 'data') {
                 const deviceId = topicParts[1];
                 try {
-                    const data = JSON.parse(message);
+                    // JSON or binary ('G' 'T' ...) records, see src/telemetry_schema.h
+                    const data = payload[0] === 0x7b ? JSON.parse(message) : decodeTelemetry(payload);
+                    if (!data) throw new Error('Unknown telemetry format');
                     
                     // Broadcast to clients
                     io.to(deviceId).emit('sensor-data', data);
                     io.to(deviceId).emit('device-status', { online: true });
                     
-                    // Save to DynamoDB
-                    const dbParams = {
-                        TableName: HISTORY_TABLE,
-                        Item: {
-                            deviceId: deviceId,
-                            timestamp: data.timestamp || Math.floor(Date.now() / 1000),
-                            temp: data.temp,
-                            hum: data.hum,
-                            soil: data.soil,
-                            co2: data.co2,
-                            tank_level: data.tank_level,
-                            pump: data.pump,
-                            fan: data.fan,
-                            heater: data.heater,
-                            mode: data.mode,
-                            version: data.version
-                        }
-                    };
-                    
-                    docClient.put(dbParams).promise().catch(err => {
+                    // Save to DynamoDB (fields generated from the firmware schema)
+                    saveHistory(deviceId, data).then(saved => {
+                        if (!saved) console.log(`Duplicate record ${deviceId} ${data.boot_id}/${data.seq} ignored`);
+                    }).catch(err => {
                         console.error("Failed to save history:", err);
                     });
 
                 } catch (e) {
-                    console.error('Error parsing JSON:', e);
+                    console.error('Error parsing telemetry:', e);
                 }
             }
             
@@ -100,6 +275,60 @@ const initIoT = (io) => {
                     console.error('Error parsing Alert JSON:', e);
                 }
             }
+
+            // 3. Handle Command Acks
+            if (topicParts.length === 3 && topicParts[2] === 'ack') {
+                const deviceId = topicParts[1];
+                try {
+                    const ack = JSON.parse(message);
+                    const sentAt = pendingCommands.get(ack.id);
+                    if (sentAt !== undefined) {
+                        pendingCommands.delete(ack.id);
+                        ack.rtt_ms = Date.now() - sentAt;
+                    }
+                    console.log(`Ack ${deviceId} ${ack.id}: device ${(ack.latency_us / 1000).toFixed(1)} ms, round trip ${ack.rtt_ms ?? '?'} ms`);
+                    io.to(deviceId).emit('command-ack', ack);
+                } catch (e) {
+                    console.error('Error parsing Ack JSON:', e);
+                }
+            }
+
+            // 4. Handle Actuator Events
+            if (topicParts.length === 3 && topicParts[2] === 'events') {
+                const deviceId = topicParts[1];
+                try {
+                    const event = JSON.parse(message);
+                    io.to(deviceId).emit('actuator-event', event);
+                    saveEvent(deviceId, event).then(saved => {
+                        if (!saved) console.log(`Duplicate event ${deviceId} ${event.boot_id}/${event.seq} ignored`);
+                    }).catch(err => {
+                        console.error("Failed to save event:", err);
+                    });
+                } catch (e) {
+                    console.error('Error parsing Event JSON:', e);
+                }
+            }
+
+            // 5. Handle Shadow (device asks for missed changes / reports applied state)
+            if (topicParts.length === 4 && topicParts[2] === 'shadow') {
+                const deviceId = topicParts[1];
+                try {
+                    const body = JSON.parse(message);
+                    if (topicParts[3] === 'get') {
+                        sendShadowDelta(deviceId, body.version || 0).catch(err => {
+                            console.error("Failed to send shadow delta:", err);
+                        });
+                    } else if (topicParts[3] === 'reported') {
+                        saveReported(deviceId, body).then(shadow => {
+                            io.to(deviceId).emit('shadow', shadowView(shadow));
+                        }).catch(err => {
+                            console.error("Failed to save reported state:", err);
+                        });
+                    }
+                } catch (e) {
+                    console.error('Error parsing Shadow JSON:', e);
+                }
+            }
         });
 
         device.on('error', (error) => {
@@ -110,11 +339,23 @@ const initIoT = (io) => {
     }
 };
 
+// Commands get an id the device echoes in its ack (greenhouse/<id>/ack, sent
+// as soon as the relays switch). Round-trip time is measured from here, i.e.
+// from the dashboard click reaching the backend.
+const COMMAND_TIMEOUT_MS = 60000;
+const pendingCommands = new Map(); // id -> sent time (ms)
+
 const publishCommand = (deviceId, command) => {
     if (device) {
+        const id = command.id || crypto.randomBytes(6).toString('hex');
+        const now = Date.now();
+        for (const [key, sentAt] of pendingCommands) {
+            if (now - sentAt > COMMAND_TIMEOUT_MS) pendingCommands.delete(key); // Never acked
+        }
+        pendingCommands.set(id, now);
         const topic = `greenhouse/${deviceId}/commands`;
-        device.publish(topic, JSON.stringify(command));
+        device.publish(topic, JSON.stringify({ ...command, id }));
     }
 };
 
-module.exports = { initIoT, publishCommand };
\ No newline at end of file
+module.exports = { initIoT, publishCommand, getShadow, updateDesired, shadowView };
\ No newline at end of file
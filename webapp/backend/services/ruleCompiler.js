@@ -0,0 +1,211 @@
+// Compiles user automation rules into bytecode for the device rule VM.
+//
+//   if co2 > 1200 and fan == 0 then fan = 1 for 300s
+//   if hour >= 22 or hour < 5 then heater = off
+//
+// Rules are separated by newlines or ';'. '#' starts a comment.
+// Keep the opcode and variable tables in sync with src/rule_vm.h.
+
+const VERSION = 1;
+const MAX_CODE = 4096;
+const MAX_HOLD_SECONDS = 65535;
+
+const OP = {
+    PUSH_I16: 0x01, PUSH_F32: 0x02, LOAD: 0x03,
+    ADD: 0x10, SUB: 0x11, MUL: 0x12, DIV: 0x13, NEG: 0x14,
+    GT: 0x20, LT: 0x21, GE: 0x22, LE: 0x23, EQ: 0x24, NE: 0x25,
+    AND: 0x30, OR: 0x31, NOT: 0x32,
+    JZ: 0x40, SET: 0x50, END_RULE: 0x60
+};
+
+const VARS = { temp: 0, hum: 1, soil: 2, co2: 3, tvoc: 4, tank: 5, pump: 6, fan: 7, heater: 8, hour: 9 };
+const OUTPUTS = { pump: 0, fan: 1, heater: 2 };
+const COMPARE = { '>': OP.GT, '<': OP.LT, '>=': OP.GE, '<=': OP.LE, '==': OP.EQ, '!=': OP.NE };
+const DURATION_UNITS = { s: 1, m: 60, h: 3600 };
+
+const tokenize = (src) => {
+    const tokens = [];
+    const re = /\s*(?:(\d+(?:\.\d+)?)([smh])?|([A-Za-z_]\w*)|(>=|<=|==|!=|[<>=+\-*/(),]))/y;
+    let pos = 0;
+    while (pos < src.length) {
+        if (/^\s*$/.test(src.slice(pos))) break;
+        re.lastIndex = pos;
+        const m = re.exec(src);
+        if (!m) throw new Error(`Unexpected character '${src.slice(pos).trim()[0]}'`);
+        if (m[1] !== undefined) tokens.push({ type: 'num', value: parseFloat(m[1]), unit: m[2] });
+        else if (m[3] !== undefined) tokens.push({ type: 'id', value: m[3].toLowerCase() });
+        else tokens.push({ type: 'op', value: m[4] });
+        pos = re.lastIndex;
+    }
+    return tokens;
+};
+
+const compileRule = (src, code) => {
+    const tokens = tokenize(src);
+    let i = 0;
+    const peek = () => tokens[i];
+    const isWord = (w) => peek() && peek().type === 'id' && peek().value === w;
+    const isOp = (o) => peek() && peek().type === 'op' && peek().value === o;
+    const expectWord = (w) => {
+        if (!isWord(w)) throw new Error(`Expected '${w}'`);
+        i++;
+    };
+
+    const emitNumber = (n) => {
+        if (Number.isInteger(n) && n >= -32768 && n <= 32767) {
+            code.push(OP.PUSH_I16, n & 0xff, (n >> 8) & 0xff);
+        } else {
+            const b = Buffer.alloc(4);
+            b.writeFloatLE(n);
+            code.push(OP.PUSH_F32, ...b);
+        }
+    };
+
+    // Precedence (low → high): or, and, not, comparison, + -, * /, unary -
+    const atom = () => {
+        const t = tokens[i++];
+        if (!t) throw new Error('Unexpected end of rule');
+        if (t.type === 'num') {
+            if (t.unit) throw new Error('Durations are only allowed after "for"');
+            return emitNumber(t.value);
+        }
+        if (t.type === 'id') {
+            if (t.value === 'on' || t.value === 'true') return emitNumber(1);
+            if (t.value === 'off' || t.value === 'false') return emitNumber(0);
+            if (!(t.value in VARS)) throw new Error(`Unknown variable '${t.value}'`);
+            return code.push(OP.LOAD, VARS[t.value]);
+        }
+        if (t.value === '(') {
+            orExpr();
+            if (!isOp(')')) throw new Error("Expected ')'");
+            i++;
+            return;
+        }
+        throw new Error(`Unexpected '${t.value}'`);
+    };
+    const unary = () => {
+        if (isOp('-')) {
+            i++;
+            unary();
+            return code.push(OP.NEG);
+        }
+        atom();
+    };
+    const product = () => {
+        unary();
+        while (isOp('*') || isOp('/')) {
+            const op = tokens[i++].value;
+            unary();
+            code.push(op === '*' ? OP.MUL : OP.DIV);
+        }
+    };
+    const sum = () => {
+        product();
+        while (isOp('+') || isOp('-')) {
+            const op = tokens[i++].value;
+            product();
+            code.push(op === '+' ? OP.ADD : OP.SUB);
+        }
+    };
+    const comparison = () => {
+        sum();
+        if (peek() && peek().type === 'op' && COMPARE[peek().value]) {
+            const op = COMPARE[tokens[i++].value];
+            sum();
+            code.push(op);
+        }
+    };
+    const notExpr = () => {
+        if (isWord('not')) {
+            i++;
+            notExpr();
+            return code.push(OP.NOT);
+        }
+        comparison();
+    };
+    const andExpr = () => {
+        notExpr();
+        while (isWord('and')) {
+            i++;
+            notExpr();
+            code.push(OP.AND);
+        }
+    };
+    const orExpr = () => {
+        andExpr();
+        while (isWord('or')) {
+            i++;
+            andExpr();
+            code.push(OP.OR);
+        }
+    };
+
+    // if <expr> then <out> = <0|1|on|off> [, ...] [for <n>[s|m|h]]
+    expectWord('if');
+    orExpr();
+    expectWord('then');
+
+    const actions = [];
+    do {
+        if (actions.length) i++; // skip ','
+        const t = tokens[i++];
+        if (!t || t.type !== 'id' || !(t.value in OUTPUTS)) throw new Error('Expected pump, fan or heater after "then"');
+        if (!isOp('=')) throw new Error(`Expected '=' after '${t.value}'`);
+        i++;
+        const v = tokens[i++];
+        let value;
+        if (v && v.type === 'num' && (v.value === 0 || v.value === 1) && !v.unit) value = v.value;
+        else if (v && v.type === 'id' && (v.value === 'on' || v.value === 'off')) value = v.value === 'on' ? 1 : 0;
+        else throw new Error(`${t.value} must be set to 0/1 or on/off`);
+        actions.push({ out: OUTPUTS[t.value], value });
+    } while (isOp(','));
+
+    let hold = 0;
+    if (isWord('for')) {
+        i++;
+        const d = tokens[i++];
+        if (!d || d.type !== 'num') throw new Error("Expected duration after 'for'");
+        hold = Math.round(d.value * DURATION_UNITS[d.unit || 's']);
+        if (hold < 1 || hold > MAX_HOLD_SECONDS) throw new Error(`Duration must be 1-${MAX_HOLD_SECONDS} s`);
+    }
+    if (i < tokens.length) throw new Error(`Unexpected '${tokens[i].value}'`);
+
+    const skip = actions.length * 5;
+    code.push(OP.JZ, skip & 0xff, skip >> 8);
+    for (const a of actions) code.push(OP.SET, a.out, a.value, hold & 0xff, hold >> 8);
+    code.push(OP.END_RULE);
+};
+
+// Returns { program: Buffer, rules: n } or throws with the offending line number
+const compileRules = (text) => {
+    const code = [0x47, 0x52, VERSION, 0]; // 'G' 'R' version ruleCount
+    let rules = 0;
+    text.split(/[\n;]/).forEach((raw, idx) => {
+        const line = raw.replace(/#.*/, '').trim();
+        if (!line) return;
+        try {
+            compileRule(line, code);
+        } catch (e) {
+            throw new Error(`Rule ${idx + 1}: ${e.message}`);
+        }
+        rules++;
+    });
+    if (rules > 255) throw new Error('Too many rules (max 255)');
+    if (code.length > MAX_CODE) throw new Error(`Program too large (${code.length} > ${MAX_CODE} bytes)`);
+    code[3] = rules;
+    return { program: Buffer.from(code), rules };
+};
+
+module.exports = { compileRules };
+
+// Host usage: node services/ruleCompiler.js "if co2 > 1200 then fan = 1 for 300s"
+if (require.main === module) {
+    try {
+        const { program, rules } = compileRules(process.argv.slice(2).join('\n'));
+        console.log(JSON.stringify({ rules: program.toString('base64') }));
+        console.error(`${rules} rule(s), ${program.length} bytes`);
+    } catch (e) {
+        console.error(e.message);
+        process.exit(1);
+    }
+}
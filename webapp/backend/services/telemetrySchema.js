@@ -0,0 +1,723 @@
+// GENERATED by scripts/genTelemetrySchema.js from src/telemetry_schema.h.
+// Do not edit: change the firmware table and run `npm run gen:telemetry`.
+
+const SCHEMA_VERSION = 14;
+
+// Top-level keys stored in the history table
+const HISTORY_FIELDS = ["version","ts_src","ts_err","boot_id","seq","mono_ms","temp","hum","vpd","dew_point","soil","co2","tank_level","pump","fan","heater","mode","climate","water_total_ml","current_ma","zones"];
+
+// [key, kind, decimals, count (0 = scalar), in "zones"] per field, for the
+// current schema and every older one an offline log may still hold
+const LAYOUTS = {
+    3: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 5, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    4: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 5, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    5: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 5, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    6: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 5, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    7: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    8: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    9: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    10: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['lan', 'U8', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    11: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['lan', 'U8', 0, 0, 0],
+        ['ws_clients', 'U8', 0, 0, 0],
+        ['ws_client_bytes', 'U16', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    12: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['lan', 'U8', 0, 0, 0],
+        ['ws_clients', 'U8', 0, 0, 0],
+        ['ws_client_bytes', 'U16', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['switches', 'U32', 0, 3, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    13: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['vpd', 'F32', 2, 0, 0],
+        ['dew_point', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['climate', 'STR', 0, 0, 0],
+        ['energy_wh', 'F32', 1, 6, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['lan', 'U8', 0, 0, 0],
+        ['ws_clients', 'U8', 0, 0, 0],
+        ['ws_client_bytes', 'U16', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['switches', 'U32', 0, 3, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ],
+    14: [
+        ['device_id', 'STR', 0, 0, 0],
+        ['version', 'STR', 0, 0, 0],
+        ['timestamp', 'U32', 0, 0, 0],
+        ['ts_src', 'U8', 0, 0, 0],
+        ['ts_err', 'I32', 0, 0, 0],
+        ['boot_id', 'U32', 0, 0, 0],
+        ['seq', 'U32', 0, 0, 0],
+        ['mono_ms', 'U32', 0, 0, 0],
+        ['temp', 'F32', 1, 0, 0],
+        ['hum', 'F32', 1, 0, 0],
+        ['vpd', 'F32', 2, 0, 0],
+        ['dew_point', 'F32', 1, 0, 0],
+        ['soil', 'I16', 0, 0, 0],
+        ['co2', 'U16', 0, 0, 0],
+        ['tvoc', 'U16', 0, 0, 0],
+        ['tank_level', 'U8', 0, 0, 0],
+        ['pump', 'U8', 0, 0, 0],
+        ['fan', 'U8', 0, 0, 0],
+        ['heater', 'U8', 0, 0, 0],
+        ['mode', 'STR', 0, 0, 0],
+        ['climate', 'STR', 0, 0, 0],
+        ['energy_wh', 'F32', 1, 6, 0],
+        ['water_total_ml', 'F32', 0, 0, 0],
+        ['sp_tmin', 'F32', 1, 0, 0],
+        ['sp_tmax', 'F32', 1, 0, 0],
+        ['sp_hmax', 'F32', 1, 0, 0],
+        ['seg', 'I8', 0, 0, 0],
+        ['stage', 'I8', 0, 0, 0],
+        ['clock', 'U8', 0, 0, 0],
+        ['rules', 'U8', 0, 0, 0],
+        ['rules_us', 'U32', 0, 0, 0],
+        ['aht_us', 'U32', 0, 0, 0],
+        ['ens_us', 'U32', 0, 0, 0],
+        ['heap_free', 'U32', 0, 0, 0],
+        ['heap_largest', 'U32', 0, 0, 0],
+        ['heap_largest_min', 'U32', 0, 0, 0],
+        ['heap_frag', 'U8', 0, 0, 0],
+        ['stack_free', 'U32', 0, 6, 0],
+        ['stack_ok', 'U8', 0, 0, 0],
+        ['recoveries', 'U16', 0, 0, 0],
+        ['boot_ms', 'U32', 0, 8, 0],
+        ['wifi_assoc_ms', 'U16', 0, 0, 0],
+        ['wifi_dhcp_ms', 'U16', 0, 0, 0],
+        ['wifi_fast', 'U8', 0, 0, 0],
+        ['lan', 'U8', 0, 0, 0],
+        ['ws_clients', 'U8', 0, 0, 0],
+        ['ws_client_bytes', 'U16', 0, 0, 0],
+        ['queue_depth', 'U8', 0, 0, 0],
+        ['queue_max', 'U8', 0, 0, 0],
+        ['queue_drops', 'U32', 0, 0, 0],
+        ['event_drops', 'U32', 0, 0, 0],
+        ['event_corrupt', 'U32', 0, 0, 0],
+        ['pm', 'U8', 0, 0, 0],
+        ['wakes', 'U16', 0, 0, 0],
+        ['current_ma', 'F32', 1, 0, 0],
+        ['sample_ms', 'U32', 0, 4, 0],
+        ['switches', 'U32', 0, 3, 0],
+        ['zone_count', 'U8', 0, 0, 0],
+        ['soil', 'U8', 0, 4, 1],
+        ['valve', 'U8', 0, 4, 1],
+        ['phase', 'U8', 0, 4, 1],
+        ['water_ml', 'F32', 0, 4, 1],
+        ['pulses', 'U8', 0, 4, 1]
+    ]
+};
+
+const READERS = {
+    U8: ['readUInt8', 1],
+    I8: ['readInt8', 1],
+    U16: ['readUInt16LE', 2],
+    I16: ['readInt16LE', 2],
+    U32: ['readUInt32LE', 4],
+    I32: ['readInt32LE', 4],
+    F32: ['readFloatLE', 4]
+};
+
+// Same digits as TelemetryOut::fixed(): NaN becomes null, halves round away
+// from zero, and the scaling is done in single precision like the firmware.
+const round = (v, decimals) => {
+    if (Number.isNaN(v)) return null;
+    const p = 10 ** decimals;
+    const scaled = Math.min(Math.floor(Math.fround(Math.fround(Math.abs(v) * p) + 0.5)), 4294967040);
+    return (v < 0 && scaled ? -scaled : scaled) / p;
+};
+
+// Decodes a binary record ('G' 'T' <version> <fields...>) into the same shape
+// as the JSON telemetry of that version. Returns null if the buffer is not a
+// binary record.
+const decodeTelemetry = (buf) => {
+    if (buf.length < 3 || buf[0] !== 0x47 || buf[1] !== 0x54) return null;
+    const layout = LAYOUTS[buf[2]];
+    if (!layout) throw new Error(`Unsupported telemetry schema ${buf[2]} (known: ${Object.keys(LAYOUTS).join(', ')})`);
+    let o = 3;
+    const value = (kind, decimals) => {
+        if (kind === 'STR') {
+            const n = buf.readUInt8(o);
+            if (o + 1 + n > buf.length) throw new RangeError('Truncated telemetry record');
+            const s = buf.toString('utf8', o + 1, o + 1 + n);
+            o += 1 + n;
+            return s;
+        }
+        const [fn, size] = READERS[kind];
+        const v = buf[fn](o);
+        o += size;
+        return kind === 'F32' ? round(v, decimals) : v;
+    };
+    const d = { zones: {} };
+    for (const [key, kind, decimals, count, zones] of layout) {
+        const target = zones ? d.zones : d;
+        if (!count) {
+            target[key] = value(kind, decimals);
+            continue;
+        }
+        const n = zones ? Math.min(d.zone_count, count) : count;
+        target[key] = [];
+        for (let i = 0; i < n; i++) target[key].push(value(kind, decimals));
+    }
+    return d;
+};
+
+const historyItem = (data) => {
+    const item = {};
+    for (const key of HISTORY_FIELDS) item[key] = data[key];
+    return item;
+};
+
+module.exports = { SCHEMA_VERSION, HISTORY_FIELDS, decodeTelemetry, historyItem };
@@ -45,6 +45,7 @@ function Dashboard({ user, signOut }) {
     temp_min: 20.0, temp_max: 30.0, hum_max: 75.0, soil_dry: 40, soil_wet: 70,
     tank_empty_dist: 25, tank_full_dist: 5
   });
+  const [shadow, setShadow] = useState(null);
   const [history, setHistory] = useState([]);
   const [loading, setLoading] = useState({ pump: false, fan: false, heater: false, mode: false });
   const [showAlerts, setShowAlerts] = useState(false);
@@ -317,6 +318,20 @@ function Dashboard({ user, signOut }) {
 
     socket.on('device-status', (status) => setDeviceOnline(status.online));
     socket.on('config-error', (err) => alert(err.message));
+
+    // Desired config (what was saved) vs reported (what the device applied)
+    socket.on('shadow', (state) => {
+      setShadow(state);
+      setConfig(prev => {
+        const next = { ...prev };
+        for (const key of Object.keys(prev)) {
+          const value = state.desired?.[key] ?? state.reported?.[key];
+          if (value !== undefined) next[key] = value;
+        }
+        return next;
+      });
+    });
+    socket.on('config-queued', ({ version }) => setShadow(prev => prev && { ...prev, version, inSync: false }));
     
     // Handle Critical Alerts (e.g., Rollback)
     socket.on('device-alert', (alertData) => {
@@ -327,6 +342,13 @@ function Dashboard({ user, signOut }) {
         fetchAlerts(deviceId);
     });
 
+    // Relays switched: update at once instead of waiting for the next telemetry
+    socket.on('command-ack', (ack) => {
+      setDevices({ pump: ack.pump === 1, fan: ack.fan === 1, heater: ack.heater === 1 });
+      if (ack.mode) setMode(ack.mode);
+      setLoading({ pump: false, fan: false, heater: false, mode: false });
+    });
+
     socket.on('sensor-data', (data) => {
       setSensorData(data);
       setDevices({ pump: data.pump === 1, fan: data.fan === 1, heater: data.heater === 1 });
@@ -348,7 +370,10 @@ function Dashboard({ user, signOut }) {
       socket.off('disconnect');
       socket.off('device-status');
       socket.off('config-error');
+      socket.off('shadow');
+      socket.off('config-queued');
       socket.off('device-alert');
+      socket.off('command-ack');
       socket.off('sensor-data');
     };
   }, [deviceId]);
@@ -368,7 +393,7 @@ function Dashboard({ user, signOut }) {
   const handleConfigSave = (newConfig) => {
     setConfig(newConfig);
     socket.emit('config-update', newConfig);
-    alert("Configuration Sent to Device");
+    alert(deviceOnline ? "Configuration Sent to Device" : "Configuration Saved. It will be applied when the device reconnects.");
   };
 
   const handleFirmwareUpdate = (url) => {
@@ -453,6 +478,7 @@ function Dashboard({ user, signOut }) {
           <ControlPanel mode={mode} setMode={handleModeToggle} devices={devices} toggleDevice={handleDeviceToggle} loading={loading} />
           <ConfigPanel 
             config={config} 
+            shadow={shadow}
             onSave={handleConfigSave} 
             onUpdateFirmware={handleFirmwareUpdate} 
             currentVersion={sensorData.version}
@@ -1,12 +1,15 @@
-import React, { useState } from 'react';
+import React, { useState, useEffect } from 'react';
 import { Save, UploadCloud, AlertTriangle, FileText } from 'lucide-react';
 
-const ConfigPanel = ({ config, onSave, onUpdateFirmware, currentVersion, onViewLogs }) => {
+const ConfigPanel = ({ config, shadow, onSave, onUpdateFirmware, currentVersion, onViewLogs }) => {
   const [localConfig, setLocalConfig] = useState(config);
   const [errors, setErrors] = useState({});
   const [updateUrl, setUpdateUrl] = useState('');
   const [showUpdate, setShowUpdate] = useState(false);
 
+  // Follow the stored config once it arrives from the backend
+  useEffect(() => setLocalConfig(config), [config]);
+
   const validate = (values) => {
     const newErrors = {};
 
@@ -74,6 +77,18 @@ const ConfigPanel = ({ config, onSave, onUpdateFirmware, currentVersion, onViewL
         </div>
       </div>
 
+      {shadow && shadow.version > 0 && (
+        <div style={{ fontSize: '0.8em', marginBottom: '10px', color: shadow.inSync ? '#00C49F' : '#ffaa00' }}>
+          {shadow.inSync
+            ? `Applied on device (v${shadow.version})`
+            : shadow.rejected && shadow.rejected.length > 0
+              ? `Device rejected v${shadow.rejectedVersion}: ${shadow.rejected.join(', ')} (still on v${shadow.reportedVersion || 0})`
+              : shadow.error
+                ? `Device could not read the update (${shadow.error})`
+                : `Waiting for device (applied v${shadow.reportedVersion || 0} of v${shadow.version})`}
+        </div>
+      )}
+
       <form onSubmit={handleSubmit}>
         <div className="form-group">
           <label>Min Temp (Night) °C</label>